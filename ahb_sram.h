@@ -0,0 +1,46 @@
+/**
+ * Placement of large buffers in the AHB SRAM banks of the LPC1768.
+ *
+ * Besides the 32 KB of local SRAM holding .data, .bss, the heap and the
+ * stack, the LPC1768 has two 16 KB banks on the AHB bus. The linker script
+ * places the input sections AHBSRAM0 and AHBSRAM1 there, so that debugging
+ * buffers (trace ring, log staging, frames) do not compete with the stack:
+ * @code
+ * static struct trace_entry entries[TRACE_DEPTH] AHB_SRAM0;
+ * @endcode
+ *
+ * The banks are NOLOAD: their content is not zeroed at start-up, each module
+ * must initialize its buffers before reading them.
+ *
+ * The mbed Ethernet driver keeps its DMA descriptors and buffers in AHBSRAM1.
+ *
+ * On the host, the macros expand to nothing.
+ */
+
+#ifndef AHB_SRAM_H
+#define AHB_SRAM_H
+
+#define AHB_SRAM0_SIZE              (16 * 1024)
+#define AHB_SRAM1_SIZE              (16 * 1024)
+
+/** Part of AHBSRAM1 used by the Ethernet driver of libmbed (ethernet_api.o) */
+#define AHB_SRAM1_ETHERNET_SIZE     (0x1568)
+
+#ifdef TARGET_LPC176X
+#define AHB_SRAM0                   __attribute__((section("AHBSRAM0"), aligned(4)))
+#define AHB_SRAM1                   __attribute__((section("AHBSRAM1"), aligned(4)))
+#else
+#define AHB_SRAM0
+#define AHB_SRAM1
+#endif
+
+/**
+ * Compile-time check that the buffers planned in a bank fit, for instance:
+ * @code
+ * AHB_SRAM_CHECK(bank0, sizeof(a) + sizeof(b), AHB_SRAM0_SIZE);
+ * @endcode
+ */
+#define AHB_SRAM_CHECK(name, size, limit) \
+    typedef char ahb_sram_check_##name[(size) <= (limit) ? 1 : -1]
+
+#endif
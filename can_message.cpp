@@ -0,0 +1,65 @@
+#include "can_message.h"
+#include "record.h"
+#include <string.h>
+
+#define TYPE_SHIFT      (8)
+
+int can_message_encode(const struct can_message *m, uint16_t *id, uint8_t *data)
+{
+    *id = (m->type << TYPE_SHIFT) | m->fixture;
+    memset(data, 0, 8);
+    data[0] = m->sequence;
+
+    switch (m->type) {
+    case CAN_MESSAGE_DONE:
+        data[1] = m->done.failed_test;
+        data[2] = m->done.test_count;
+        return 3;
+    case CAN_MESSAGE_RESULT:
+        data[1] = m->result.test;
+        data[2] = m->result.passed;
+        record_put_u32(&data[3], m->result.elapsed_ms);
+        return 7;
+    case CAN_MESSAGE_COUNTERS:
+        data[1] = m->counters.test;
+        record_put_u32(&data[2], m->counters.transactions);
+        record_put_u16(&data[6], m->counters.nacks);
+        return 8;
+    default:
+        return 1;
+    }
+}
+
+bool can_message_decode(uint16_t id, const uint8_t *data, int length, struct can_message *m)
+{
+    m->type = id >> TYPE_SHIFT;
+    m->fixture = id & 0xFF;
+    if (length < 1)
+        return false;
+    m->sequence = data[0];
+
+    switch (m->type) {
+    case CAN_MESSAGE_DONE:
+        if (length < 3)
+            return false;
+        m->done.failed_test = data[1];
+        m->done.test_count = data[2];
+        return true;
+    case CAN_MESSAGE_RESULT:
+        if (length < 7)
+            return false;
+        m->result.test = data[1];
+        m->result.passed = data[2];
+        m->result.elapsed_ms = record_get_u32(&data[3]);
+        return true;
+    case CAN_MESSAGE_COUNTERS:
+        if (length < 8)
+            return false;
+        m->counters.test = data[1];
+        m->counters.transactions = record_get_u32(&data[2]);
+        m->counters.nacks = record_get_u16(&data[6]);
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,74 @@
+/**
+ * Compact result messages carried by CAN frames.
+ *
+ * Every message fits in one classic CAN frame with a standard 11-bit
+ * identifier made of the message type and the fixture identifier:
+ *
+ *   | type (3 bits) | fixture (8 bits) |
+ *
+ * Lower identifiers win the arbitration, so message types are ordered by
+ * priority. The first byte of every payload is a sequence number incremented
+ * for each message sent by the fixture, so that the gateway can detect lost
+ * messages. Multi-byte fields are little-endian.
+ */
+
+#ifndef CAN_MESSAGE_H
+#define CAN_MESSAGE_H
+
+#include <stdint.h>
+
+enum can_message_type {
+    /* sequence (1), failed test or 0 (1), tests run (1) */
+    CAN_MESSAGE_DONE = 1,
+
+    /* sequence (1), test (1), passed (1), elapsed_ms (4) */
+    CAN_MESSAGE_RESULT = 2,
+
+    /* sequence (1), test (1), transactions (4), nacks (2) */
+    CAN_MESSAGE_COUNTERS = 3,
+};
+
+struct can_message {
+    uint8_t type;
+    uint8_t fixture;
+    uint8_t sequence;
+    union {
+        struct {
+            uint8_t failed_test;
+            uint8_t test_count;
+        } done;
+        struct {
+            uint8_t test;
+            uint8_t passed;
+            uint32_t elapsed_ms;
+        } result;
+        struct {
+            uint8_t test;
+            uint32_t transactions;
+            uint16_t nacks;
+        } counters;
+    };
+};
+
+/**
+ * @brief Encode a message.
+ *
+ * @param[in] m message to encode
+ * @param[out] id 11-bit CAN identifier
+ * @param[out] data payload, 8 bytes
+ * @return Length of the payload
+ */
+int can_message_encode(const struct can_message *m, uint16_t *id, uint8_t *data);
+
+/**
+ * @brief Decode a message.
+ *
+ * @param[in] id 11-bit CAN identifier
+ * @param[in] data payload
+ * @param[in] length length of the payload
+ * @param[out] m decoded message
+ * @return True if the frame is a valid message, false otherwise
+ */
+bool can_message_decode(uint16_t id, const uint8_t *data, int length, struct can_message *m);
+
+#endif
@@ -0,0 +1,73 @@
+#include "mbed.h"
+#include "can_report.h"
+#include "can_message.h"
+
+/* Number of attempts to find a free transmit buffer */
+#define SEND_RETRIES        (100)
+#define SEND_RETRY_US       (100)
+
+/* Created on demand: CAN2 on pins 30 (rd) and 29 (td) */
+static CAN *can;
+static uint8_t fixture_id;
+static uint8_t sequence;
+static uint32_t dropped;
+
+static void send(struct can_message *m)
+{
+    uint16_t id;
+    uint8_t data[8];
+
+    m->fixture = fixture_id;
+    m->sequence = sequence++;
+    int length = can_message_encode(m, &id, data);
+
+    CANMessage msg(id, (const char *)data, length);
+    for (int i = 0; i < SEND_RETRIES; ++i) {
+        if (can->write(msg))
+            return;
+        wait_us(SEND_RETRY_US);
+    }
+    ++dropped;
+}
+
+void can_report_init(uint8_t fixture, int hz)
+{
+    can = new CAN(p30, p29);
+    can->frequency(hz);
+    fixture_id = fixture;
+    sequence = 0;
+    dropped = 0;
+}
+
+void can_report_result(int test, bool passed, uint32_t elapsed_us,
+                       uint32_t transactions, uint32_t nacks)
+{
+    struct can_message m;
+
+    m.type = CAN_MESSAGE_RESULT;
+    m.result.test = test;
+    m.result.passed = passed;
+    m.result.elapsed_ms = elapsed_us / 1000;
+    send(&m);
+
+    m.type = CAN_MESSAGE_COUNTERS;
+    m.counters.test = test;
+    m.counters.transactions = transactions;
+    m.counters.nacks = nacks > 0xFFFF ? 0xFFFF : nacks;
+    send(&m);
+}
+
+void can_report_done(int failed_test, int test_count)
+{
+    struct can_message m;
+
+    m.type = CAN_MESSAGE_DONE;
+    m.done.failed_test = failed_test;
+    m.done.test_count = test_count;
+    send(&m);
+}
+
+uint32_t can_report_dropped(void)
+{
+    return dropped;
+}
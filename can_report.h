@@ -0,0 +1,47 @@
+/**
+ * Publication of the test results on a CAN bus.
+ *
+ * Results and counters of each test are sent as compact messages (see
+ * can_message.h) so that a gateway can collect the results of many fixtures
+ * sharing one CAN bus.
+ */
+
+#ifndef CAN_REPORT_H
+#define CAN_REPORT_H
+
+#include <stdint.h>
+
+/**
+ * @brief Bring up the CAN interface.
+ *
+ * @param[in] fixture identifier of the fixture
+ * @param[in] hz bit rate of the bus
+ */
+void can_report_init(uint8_t fixture, int hz);
+
+/**
+ * @brief Publish the result of a test.
+ *
+ * @param[in] test test number (starting from 1)
+ * @param[in] passed true if the test passed
+ * @param[in] elapsed_us duration of the test
+ * @param[in] transactions number of transactions performed by the test
+ * @param[in] nacks number of transactions not acknowledged
+ */
+void can_report_result(int test, bool passed, uint32_t elapsed_us,
+                       uint32_t transactions, uint32_t nacks);
+
+/**
+ * @brief Publish the end of the test run.
+ *
+ * @param[in] failed_test number of the test that failed, 0 if all passed
+ * @param[in] test_count number of tests run
+ */
+void can_report_done(int failed_test, int test_count);
+
+/**
+ * @return Number of messages dropped because no transmit buffer was free
+ */
+uint32_t can_report_dropped(void);
+
+#endif
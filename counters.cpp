@@ -0,0 +1,58 @@
+#include "counters.h"
+#include <stddef.h>
+
+volatile uint32_t counter_values[COUNTER_COUNT];
+struct histogram counter_durations;
+
+static const struct {
+    const char *name;
+    bool gauge;
+} descriptions[COUNTER_COUNT] = {
+    {"transactions", false},
+    {"bytes", false},
+    {"nacks", false},
+    {"retries", false},
+    {"iterations", false},
+    {"test", true},
+    {"test_iteration", true},
+    {"bus_frequency", true},
+    {"duration_p50_us", true},
+    {"duration_p99_us", true},
+    {"duration_max_us", true},
+};
+
+void counters_init(void)
+{
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+        counter_values[i] = 0;
+    histogram_init(&counter_durations, COUNTERS_DURATION_BUCKET_US);
+}
+
+void counters_add_duration(uint32_t us)
+{
+    histogram_add(&counter_durations, us);
+}
+
+void counters_snapshot(struct counters_snapshot *s, uint32_t now_us)
+{
+    s->timestamp_us = now_us;
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+        s->values[i] = counter_values[i];
+}
+
+void counters_summarize(struct counters_snapshot *s)
+{
+    s->values[COUNTER_DURATION_P50_US] = histogram_percentile(&counter_durations, 50);
+    s->values[COUNTER_DURATION_P99_US] = histogram_percentile(&counter_durations, 99);
+    s->values[COUNTER_DURATION_MAX_US] = counter_durations.count ? counter_durations.max : 0;
+}
+
+const char *counters_name(int id)
+{
+    return id >= 0 && id < COUNTER_COUNT ? descriptions[id].name : NULL;
+}
+
+bool counters_is_gauge(int id)
+{
+    return id >= 0 && id < COUNTER_COUNT && descriptions[id].gauge;
+}
@@ -0,0 +1,103 @@
+/**
+ * Live counters and gauges of a fixture.
+ *
+ * The registry is a fixed table of named values updated by the main loop:
+ * counters only grow (transactions, bytes), gauges hold the current value of
+ * something (test being run, bus frequency). Updates are a plain add or
+ * store, without locks and without formatting, since the main loop is the
+ * only writer. The durations of the transactions go to a histogram whose
+ * summary (p50, p99, max) is added to a snapshot by counters_summarize().
+ *
+ * A snapshot copies the registry at one point in time, typically from a
+ * Ticker interrupt, to be encoded as a RECORD_COUNTERS record (see record.h)
+ * outside of the interrupt. Values are 32-bit so that each one is read
+ * atomically by the interrupt. The histogram is not: the interrupt could see
+ * it in the middle of an update, so its summary is computed outside of the
+ * interrupt, from the main loop.
+ */
+
+#ifndef COUNTERS_H
+#define COUNTERS_H
+
+#include <stdint.h>
+#include "histogram.h"
+
+/** Width of the buckets of the duration histogram */
+#define COUNTERS_DURATION_BUCKET_US (20)
+
+/** Identifiers of the values, in the order of the snapshot records */
+enum counter_id {
+    COUNTER_TRANSACTIONS,
+    COUNTER_BYTES,
+    COUNTER_NACKS,
+    COUNTER_RETRIES,                /* group replays of tests 3 and 4 */
+    COUNTER_ITERATIONS,             /* iterations started, all tests */
+    COUNTER_TEST,                   /* gauge: test being run, 0 if none */
+    COUNTER_TEST_ITERATION,         /* gauge: iteration of the test being run */
+    COUNTER_BUS_FREQUENCY,          /* gauge: Hz */
+    COUNTER_DURATION_P50_US,        /* gauge: from the duration histogram */
+    COUNTER_DURATION_P99_US,
+    COUNTER_DURATION_MAX_US,
+    COUNTER_COUNT
+};
+
+struct counters_snapshot {
+    uint32_t timestamp_us;
+    uint32_t values[COUNTER_COUNT];
+};
+
+extern volatile uint32_t counter_values[COUNTER_COUNT];
+extern struct histogram counter_durations;
+
+static inline void counter_add(enum counter_id id, uint32_t n)
+{
+    counter_values[id] += n;
+}
+
+static inline void counter_set(enum counter_id id, uint32_t value)
+{
+    counter_values[id] = value;
+}
+
+/**
+ * @brief Reset all values and the duration histogram.
+ */
+void counters_init(void);
+
+/**
+ * @brief Record the duration of a transaction.
+ *
+ * @param[in] us duration in microseconds
+ */
+void counters_add_duration(uint32_t us);
+
+/**
+ * @brief Copy the registry, without the summary of the durations.
+ *
+ * @param[out] s snapshot
+ * @param[in] now_us time of the snapshot
+ */
+void counters_snapshot(struct counters_snapshot *s, uint32_t now_us);
+
+/**
+ * @brief Add the summary of the duration histogram to a snapshot.
+ *
+ * Must be called from the main loop, the only writer of the histogram.
+ *
+ * @param[in,out] s snapshot
+ */
+void counters_summarize(struct counters_snapshot *s);
+
+/**
+ * @param[in] id identifier of a value
+ * @return Name of the value, NULL if the identifier is unknown
+ */
+const char *counters_name(int id);
+
+/**
+ * @param[in] id identifier of a value
+ * @return True for a gauge, false for a counter
+ */
+bool counters_is_gauge(int id);
+
+#endif
@@ -0,0 +1,139 @@
+#include "covering.h"
+#include "ahb_sram.h"
+#include <string.h>
+
+/* Combinations of factors (t-subsets) and their offset in the coverage bitmap */
+struct subset {
+    uint8_t factors[3];
+    int offset;
+};
+
+static uint8_t covered[COVERING_MAX_COMBINATIONS / 8] AHB_SRAM0;
+
+static int subsets(const uint8_t *levels, int factor_count, int strength, struct subset *s)
+{
+    int count = 0;
+    int offset = 0;
+
+    for (int a = 0; a < factor_count; ++a) {
+        for (int b = a + 1; b < factor_count; ++b) {
+            if (strength == 2) {
+                s[count].factors[0] = a;
+                s[count].factors[1] = b;
+                s[count++].offset = offset;
+                offset += levels[a] * levels[b];
+                continue;
+            }
+
+            for (int c = b + 1; c < factor_count; ++c) {
+                s[count].factors[0] = a;
+                s[count].factors[1] = b;
+                s[count].factors[2] = c;
+                s[count++].offset = offset;
+                offset += levels[a] * levels[b] * levels[c];
+            }
+        }
+    }
+
+    return offset <= COVERING_MAX_COMBINATIONS ? count : -1;
+}
+
+/**
+ * @brief Position in the coverage bitmap of the combination of a row.
+ */
+static int combination(const struct subset *s, const uint8_t *levels, int strength,
+                       const uint8_t *row)
+{
+    int index = 0;
+
+    for (int i = 0; i < strength; ++i)
+        index = index * levels[s->factors[i]] + row[s->factors[i]];
+
+    return s->offset + index;
+}
+
+static bool is_covered(int bit)
+{
+    return covered[bit / 8] & (1 << (bit % 8));
+}
+
+/**
+ * @brief Decode the n-th possible row.
+ */
+static void candidate(const uint8_t *levels, int factor_count, int n, uint8_t *row)
+{
+    for (int i = factor_count - 1; i >= 0; --i) {
+        row[i] = n % levels[i];
+        n /= levels[i];
+    }
+}
+
+int covering_generate(const uint8_t *levels, int factor_count, int strength,
+                      uint8_t *rows, int max_rows)
+{
+    /* C(6, 3) subsets at most */
+    struct subset s[20];
+
+    if (factor_count > COVERING_MAX_FACTORS || factor_count < strength
+    ||  strength < 2 || strength > 3)
+        return 0;
+
+    int candidates = 1;
+    for (int i = 0; i < factor_count; ++i) {
+        if (levels[i] == 0 || levels[i] > COVERING_MAX_LEVELS)
+            return 0;
+        candidates *= levels[i];
+        if (candidates > COVERING_MAX_CANDIDATES)
+            return 0;
+    }
+
+    int subset_count = subsets(levels, factor_count, strength, s);
+    if (subset_count < 0)
+        return 0;
+
+    int uncovered = 0;
+    for (int i = 0; i < subset_count; ++i) {
+        int size = 1;
+        for (int j = 0; j < strength; ++j)
+            size *= levels[s[i].factors[j]];
+        uncovered += size;
+    }
+    memset(covered, 0, sizeof(covered));
+
+    int row_count = 0;
+    while (uncovered > 0) {
+        if (row_count == max_rows)
+            return 0;
+
+        /* Pick the candidate covering the most new combinations */
+        uint8_t row[COVERING_MAX_FACTORS];
+        int best = -1;
+        int best_gain = 0;
+        for (int n = 0; n < candidates; ++n) {
+            int gain = 0;
+
+            candidate(levels, factor_count, n, row);
+            for (int i = 0; i < subset_count; ++i)
+                if (!is_covered(combination(&s[i], levels, strength, row)))
+                    ++gain;
+
+            if (gain > best_gain) {
+                best_gain = gain;
+                best = n;
+            }
+        }
+
+        uint8_t *r = &rows[row_count * factor_count];
+        candidate(levels, factor_count, best, r);
+        for (int i = 0; i < subset_count; ++i) {
+            int bit = combination(&s[i], levels, strength, r);
+            if (!is_covered(bit)) {
+                covered[bit / 8] |= 1 << (bit % 8);
+                --uncovered;
+            }
+        }
+        ++row_count;
+    }
+
+    return row_count;
+}
@@ -0,0 +1,41 @@
+/**
+ * Generator of covering arrays for combinatorial tests.
+ *
+ * A test scenario is a row giving a level to each factor (e.g. start
+ * register, burst length). A covering array of strength t is a set of rows in
+ * which every combination of levels of any t factors appears at least once.
+ * Its size grows with the product of the t largest level counts instead of
+ * the product of all level counts.
+ *
+ * Rows are chosen greedily among all possible rows, the row covering the
+ * most combinations not covered yet being added first. This is only suited
+ * to small factor spaces (COVERING_MAX_CANDIDATES rows).
+ */
+
+#ifndef COVERING_H
+#define COVERING_H
+
+#include <stdint.h>
+
+#define COVERING_MAX_FACTORS        (6)
+#define COVERING_MAX_LEVELS         (16)
+#define COVERING_MAX_CANDIDATES     (4096)
+
+/** Number of t-way combinations that can be tracked */
+#define COVERING_MAX_COMBINATIONS   (4096)
+
+/**
+ * @brief Generate a covering array.
+ *
+ * @param[in] levels number of levels of each factor
+ * @param[in] factor_count number of factors
+ * @param[in] strength number of factors whose combinations are covered (2 or 3)
+ * @param[out] rows levels of each row, factor_count bytes per row
+ * @param[in] max_rows maximum number of rows
+ * @return Number of rows, 0 if the factor space is too large or max_rows too
+ * small
+ */
+int covering_generate(const uint8_t *levels, int factor_count, int strength,
+                      uint8_t *rows, int max_rows);
+
+#endif
@@ -0,0 +1,71 @@
+#include "mbed.h"
+#include "eth_stream.h"
+#include "record.h"
+#include "stream_frame.h"
+#include "ahb_sram.h"
+
+/* Created on demand: constructing it powers up the PHY */
+static Ethernet *eth;
+static struct stream_frame frame AHB_SRAM1;
+static uint32_t next_trace;
+static uint32_t lost;
+static uint32_t send_errors;
+
+void eth_stream_init(uint8_t fixture)
+{
+    char mac[STREAM_FRAME_MAC_SIZE];
+
+    eth = new Ethernet();
+    eth->set_link(Ethernet::FullDuplex100);
+    eth->address(mac);
+
+    stream_frame_init(&frame, (const uint8_t *)mac, fixture);
+    next_trace = trace_count();
+    lost = 0;
+    send_errors = 0;
+}
+
+void eth_stream_flush(void)
+{
+    if (stream_frame_empty(&frame))
+        return;
+
+    eth->write((const char *)frame.buf, frame.length);
+    if (eth->send() == 0)
+        ++send_errors;
+    stream_frame_next(&frame);
+}
+
+void eth_stream_write(const uint8_t *record, int length)
+{
+    if (!stream_frame_append(&frame, record, length)) {
+        eth_stream_flush();
+        stream_frame_append(&frame, record, length);
+    }
+}
+
+void eth_stream_trace(void)
+{
+    uint8_t record[RECORD_MAX_SIZE];
+    uint32_t count = trace_count();
+
+    for (; next_trace != count; ++next_trace) {
+        const struct trace_entry *e = trace_get(next_trace);
+        if (e == NULL) {
+            ++lost;
+            continue;
+        }
+
+        eth_stream_write(record, record_encode_trace(record, next_trace, e));
+    }
+}
+
+uint32_t eth_stream_lost(void)
+{
+    return lost;
+}
+
+uint32_t eth_stream_send_errors(void)
+{
+    return send_errors;
+}
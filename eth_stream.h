@@ -0,0 +1,52 @@
+/**
+ * Stream of records over raw Ethernet frames.
+ *
+ * Results and the transactions of the flight recorder are packed into frames
+ * (see stream_frame.h) sent at 100 Mbit. A frame is sent as soon as it is
+ * full, or when the stream is flushed.
+ */
+
+#ifndef ETH_STREAM_H
+#define ETH_STREAM_H
+
+#include <stdint.h>
+
+/**
+ * @brief Bring up the Ethernet interface.
+ *
+ * @param[in] fixture identifier of the fixture, sent in every frame
+ */
+void eth_stream_init(uint8_t fixture);
+
+/**
+ * @brief Append a record to the stream.
+ *
+ * @param[in] record encoded record
+ * @param[in] length size of the record
+ */
+void eth_stream_write(const uint8_t *record, int length);
+
+/**
+ * @brief Append the transactions of the flight recorder not streamed yet.
+ *
+ * Transactions overwritten in the flight recorder before being streamed are
+ * counted as lost.
+ */
+void eth_stream_trace(void);
+
+/**
+ * @brief Send the current frame if it holds any record.
+ */
+void eth_stream_flush(void);
+
+/**
+ * @return Number of transactions lost because the stream could not keep up
+ */
+uint32_t eth_stream_lost(void);
+
+/**
+ * @return Number of frames the Ethernet interface failed to send
+ */
+uint32_t eth_stream_send_errors(void);
+
+#endif
@@ -0,0 +1,475 @@
+/**
+ * I2C master driver accessing the LPC17xx I2C registers directly.
+ *
+ * mbed::I2C goes through aquire() and the generic i2c_api layer before each
+ * transaction. This driver is templated on the peripheral and its pins so
+ * that register addresses and pin configuration are compile-time constants,
+ * which reduces the time spent between two transactions.
+ *
+ * It exposes the same API as mbed::I2C (write, read, repeated start) so it can
+ * be used in place of mbed::I2C. Only one object per peripheral must exist.
+ *
+ * An idle function can be set with on_idle(): it is called while the driver
+ * waits for the end of each bus operation, e.g. to run background tasks. It
+ * is given the time left until the operation is expected to end (9 bit
+ * periods for a byte) and must return within it: once the operation ends,
+ * the peripheral holds SCL low until the driver handles it.
+ *
+ * start_transfer() and poll() run a transaction without waiting for the bus,
+ * so that one loop can drive several peripherals sharing the same bus as
+ * competing masters. Arbitration losses are reported, not retried.
+ *
+ * Example:
+ * @code
+ * FastI2C<1, p9, p10> i2c;
+ * i2c.frequency(400000);
+ * i2c.write(0x3A, data, 2);
+ * @endcode
+ */
+
+#ifndef FAST_I2C_H
+#define FAST_I2C_H
+
+#include "mbed.h"
+
+/* I2CONSET/I2CONCLR bits */
+#define FAST_I2C_AA                 (1 << 2)
+#define FAST_I2C_SI                 (1 << 3)
+#define FAST_I2C_STO                (1 << 4)
+#define FAST_I2C_STA                (1 << 5)
+#define FAST_I2C_I2EN               (1 << 6)
+
+/* I2STAT values in master mode */
+#define FAST_I2C_BUS_ERROR          (0x00)      /* illegal start or stop condition */
+#define FAST_I2C_START              (0x08)
+#define FAST_I2C_REPEATED_START     (0x10)
+#define FAST_I2C_SLA_W_ACK          (0x18)
+#define FAST_I2C_DATA_W_ACK         (0x28)
+#define FAST_I2C_ARBITRATION_LOST   (0x38)
+#define FAST_I2C_SLA_R_ACK          (0x40)
+#define FAST_I2C_DATA_R_ACK         (0x50)
+#define FAST_I2C_DATA_R_NACK        (0x58)
+
+/* Failures which are not I2STAT values */
+#define FAST_I2C_ERROR_BUS          (0x100)     /* I2STAT was FAST_I2C_BUS_ERROR */
+#define FAST_I2C_ERROR_TIMEOUT      (0x101)     /* bus stuck or clock stretched too long */
+
+/* poll() result while the transaction runs */
+#define FAST_I2C_PENDING            (-1)
+
+/* Longest bus operation before giving up, clock stretching included */
+#define FAST_I2C_TIMEOUT_US         (10000)
+
+/** Function called while waiting for the bus, see FastI2C::on_idle() */
+typedef void (*fast_i2c_idle)(uint32_t available_us);
+
+/**
+ * Peripheral constants: register block, power bit and peripheral clock
+ * selection. Only instances 0, 1 and 2 are defined.
+ */
+template <int N> struct fast_i2c_peripheral;
+
+template <> struct fast_i2c_peripheral<0> {
+    enum { base = LPC_I2C0_BASE, pconp = 1 << 7, pclksel = 0, pclk_shift = 14 };
+};
+
+template <> struct fast_i2c_peripheral<1> {
+    enum { base = LPC_I2C1_BASE, pconp = 1 << 19, pclksel = 1, pclk_shift = 6 };
+};
+
+template <> struct fast_i2c_peripheral<2> {
+    enum { base = LPC_I2C2_BASE, pconp = 1 << 26, pclksel = 1, pclk_shift = 20 };
+};
+
+/**
+ * Pin function selecting peripheral N on pin P. Pins that cannot be used by
+ * the peripheral have no function and are rejected at compile time.
+ */
+template <int N, PinName P> struct fast_i2c_pin { enum { function = 0 }; };
+template <> struct fast_i2c_pin<0, P0_27> { enum { function = 1 }; };
+template <> struct fast_i2c_pin<0, P0_28> { enum { function = 1 }; };
+template <> struct fast_i2c_pin<1, P0_0> { enum { function = 3 }; };
+template <> struct fast_i2c_pin<1, P0_1> { enum { function = 3 }; };
+template <> struct fast_i2c_pin<1, P0_19> { enum { function = 3 }; };
+template <> struct fast_i2c_pin<1, P0_20> { enum { function = 3 }; };
+template <> struct fast_i2c_pin<2, P0_10> { enum { function = 2 }; };
+template <> struct fast_i2c_pin<2, P0_11> { enum { function = 2 }; };
+
+template <int N, PinName SDA, PinName SCL>
+class FastI2C {
+    typedef fast_i2c_peripheral<N> peripheral;
+
+    /* Compile-time check of the pins */
+    typedef char sda_pin_check[fast_i2c_pin<N, SDA>::function != 0 ? 1 : -1];
+    typedef char scl_pin_check[fast_i2c_pin<N, SCL>::function != 0 ? 1 : -1];
+
+public:
+    FastI2C()
+        : _status(0)
+    {
+        LPC_SC->PCONP |= peripheral::pconp;
+
+        /* PCLK = CCLK / 4 */
+        (&LPC_SC->PCLKSEL0)[peripheral::pclksel] &= ~(3UL << peripheral::pclk_shift);
+
+        configure_pin<SDA>();
+        configure_pin<SCL>();
+
+        regs()->I2CONCLR = FAST_I2C_AA | FAST_I2C_SI | FAST_I2C_STA | FAST_I2C_I2EN;
+        regs()->I2CONSET = FAST_I2C_I2EN;
+        frequency(100000);
+    }
+
+    /**
+     * @brief Set the frequency of the bus.
+     *
+     * @param[in] hz bus frequency in hertz
+     */
+    void frequency(int hz)
+    {
+        uint32_t half_period = SystemCoreClock / 4 / (2 * hz);
+
+        regs()->I2SCLH = half_period;
+        regs()->I2SCLL = half_period;
+        bit_ns = 1000000000 / hz;
+    }
+
+    /**
+     * @brief Write to a slave.
+     *
+     * @param[in] address 8-bit I2C slave address
+     * @param[in] data bytes to send
+     * @param[in] length number of bytes to send
+     * @param[in] repeated do not send a stop condition at the end
+     * @return 0 on success (ack), non-0 on failure (nack, bus error, timeout)
+     */
+    int write(int address, const char *data, int length, bool repeated = false)
+    {
+        int status = start();
+        if (status == FAST_I2C_START || status == FAST_I2C_REPEATED_START)
+            status = send(address & 0xFE);
+
+        for (int i = 0; i < length && status == FAST_I2C_SLA_W_ACK; ++i) {
+            status = send(data[i]);
+            if (status == FAST_I2C_DATA_W_ACK)
+                status = FAST_I2C_SLA_W_ACK;
+        }
+
+        if (status == FAST_I2C_ARBITRATION_LOST)
+            return status;
+        if (status == FAST_I2C_ERROR_BUS || status == FAST_I2C_ERROR_TIMEOUT)
+            return recover(status);
+        if (!repeated || status != FAST_I2C_SLA_W_ACK)
+            stop();
+
+        return status == FAST_I2C_SLA_W_ACK ? 0 : status;
+    }
+
+    /**
+     * @brief Read from a slave.
+     *
+     * @param[in] address 8-bit I2C slave address
+     * @param[out] data buffer receiving the bytes
+     * @param[in] length number of bytes to read
+     * @param[in] repeated do not send a stop condition at the end
+     * @return 0 on success (ack), non-0 on failure (nack, bus error, timeout)
+     */
+    int read(int address, char *data, int length, bool repeated = false)
+    {
+        int status = start();
+        if (status == FAST_I2C_START || status == FAST_I2C_REPEATED_START)
+            status = send(address | 0x01);
+
+        if (status == FAST_I2C_SLA_R_ACK) {
+            for (int i = 0; i < length; ++i) {
+                int expected = i < length - 1 ? FAST_I2C_DATA_R_ACK : FAST_I2C_DATA_R_NACK;
+                int s = receive(i < length - 1);
+                if (s != expected) {
+                    status = s;
+                    break;
+                }
+                data[i] = regs()->I2DAT;
+            }
+        }
+
+        if (status == FAST_I2C_ARBITRATION_LOST)
+            return status;
+        if (status == FAST_I2C_ERROR_BUS || status == FAST_I2C_ERROR_TIMEOUT)
+            return recover(status);
+        if (!repeated || status != FAST_I2C_SLA_R_ACK)
+            stop();
+
+        return status == FAST_I2C_SLA_R_ACK ? 0 : status;
+    }
+
+    /**
+     * @brief Send a start or repeated start condition.
+     *
+     * @return Status of the peripheral
+     */
+    int start()
+    {
+        regs()->I2CONSET = FAST_I2C_STA;
+        regs()->I2CONCLR = FAST_I2C_SI;
+        int status = wait(1);
+        regs()->I2CONCLR = FAST_I2C_STA;
+
+        return status;
+    }
+
+    /**
+     * @brief Send a stop condition and wait until it is on the bus.
+     */
+    void stop()
+    {
+        uint32_t start = us_ticker_read();
+
+        regs()->I2CONSET = FAST_I2C_STO;
+        regs()->I2CONCLR = FAST_I2C_SI;
+        while ((regs()->I2CONSET & FAST_I2C_STO) && us_ticker_read() - start < FAST_I2C_TIMEOUT_US)
+            ;
+    }
+
+    /**
+     * @brief Release the bus after a bus error or a timeout.
+     *
+     * Setting STO without a transaction in progress only resets the state of
+     * the peripheral. If it still does not go back to idle, it is disabled and
+     * enabled again.
+     *
+     * @param[in] error FAST_I2C_ERROR_BUS or FAST_I2C_ERROR_TIMEOUT
+     * @return error
+     */
+    int recover(int error)
+    {
+        regs()->I2CONCLR = FAST_I2C_STA | FAST_I2C_AA;
+        stop();
+        if (regs()->I2CONSET & FAST_I2C_STO) {
+            regs()->I2CONCLR = FAST_I2C_I2EN | FAST_I2C_STO;
+            regs()->I2CONSET = FAST_I2C_I2EN;
+        }
+
+        return error;
+    }
+
+    /**
+     * @brief Send one byte.
+     *
+     * @param[in] value byte to send
+     * @return Status of the peripheral
+     */
+    int send(int value)
+    {
+        regs()->I2DAT = value;
+        regs()->I2CONCLR = FAST_I2C_SI;
+
+        return wait(9);
+    }
+
+    /**
+     * @brief Receive one byte, read it from I2DAT afterwards.
+     *
+     * @param[in] ack acknowledge the byte
+     * @return Status of the peripheral
+     */
+    int receive(bool ack)
+    {
+        if (ack)
+            regs()->I2CONSET = FAST_I2C_AA;
+        else
+            regs()->I2CONCLR = FAST_I2C_AA;
+        regs()->I2CONCLR = FAST_I2C_SI;
+
+        return wait(9);
+    }
+
+    /**
+     * @brief Start a transaction and return without waiting for it.
+     *
+     * poll() must then be called until the transaction ends. The start
+     * condition is sent as soon as the bus is free.
+     *
+     * @param[in] address 8-bit I2C slave address
+     * @param[in,out] data bytes to send, or buffer receiving the bytes read;
+     * it must stay valid until the end of the transaction
+     * @param[in] length number of bytes to send or read (at least 1)
+     * @param[in] read true to read from the slave, false to write
+     */
+    void start_transfer(int address, char *data, int length, bool read)
+    {
+        _address = read ? address | 0x01 : address & 0xFE;
+        _data = data;
+        _length = length;
+        _position = 0;
+        _status = FAST_I2C_PENDING;
+
+        regs()->I2CONSET = FAST_I2C_STA;
+        regs()->I2CONCLR = FAST_I2C_SI;
+    }
+
+    /**
+     * @brief Advance the transaction started by start_transfer().
+     *
+     * @return FAST_I2C_PENDING while the transaction runs, 0 at its end,
+     * FAST_I2C_ARBITRATION_LOST if another master won the bus (the
+     * transaction must be started again), FAST_I2C_ERROR_BUS after a bus
+     * error, otherwise the status of the failure (nack)
+     */
+    int poll()
+    {
+        if (_status != FAST_I2C_PENDING || !(regs()->I2CONSET & FAST_I2C_SI))
+            return _status;
+
+        int status = regs()->I2STAT;
+        switch (status) {
+        case FAST_I2C_START:
+        case FAST_I2C_REPEATED_START:
+            regs()->I2CONCLR = FAST_I2C_STA;
+            regs()->I2DAT = _address;
+            break;
+
+        case FAST_I2C_SLA_W_ACK:
+        case FAST_I2C_DATA_W_ACK:
+            if (_position == _length)
+                return finish(0);
+            regs()->I2DAT = _data[_position++];
+            break;
+
+        case FAST_I2C_SLA_R_ACK:
+            if (_length > 1)
+                regs()->I2CONSET = FAST_I2C_AA;
+            else
+                regs()->I2CONCLR = FAST_I2C_AA;
+            break;
+
+        case FAST_I2C_DATA_R_ACK:
+            _data[_position++] = regs()->I2DAT;
+            if (_position < _length - 1)
+                regs()->I2CONSET = FAST_I2C_AA;
+            else
+                regs()->I2CONCLR = FAST_I2C_AA;
+            break;
+
+        case FAST_I2C_DATA_R_NACK:
+            _data[_position++] = regs()->I2DAT;
+            return finish(0);
+
+        case FAST_I2C_ARBITRATION_LOST:
+            /* The peripheral is now a slave not addressed, the bus is left to the winner */
+            regs()->I2CONCLR = FAST_I2C_SI;
+            return _status = status;
+
+        case FAST_I2C_BUS_ERROR:
+            return _status = recover(FAST_I2C_ERROR_BUS);
+
+        default:
+            return finish(status);
+        }
+
+        regs()->I2CONCLR = FAST_I2C_SI;
+        return _status;
+    }
+
+    /**
+     * @brief Set the function called while waiting for the bus.
+     *
+     * @param[in] idle function to call, NULL to busy-wait
+     */
+    static void on_idle(fast_i2c_idle idle)
+    {
+        idle_function = idle;
+    }
+
+    /**
+     * @return Function called while waiting for the bus, NULL if none
+     */
+    static fast_i2c_idle idle()
+    {
+        return idle_function;
+    }
+
+    static LPC_I2C_TypeDef *regs()
+    {
+        return (LPC_I2C_TypeDef *)peripheral::base;
+    }
+
+private:
+    static fast_i2c_idle idle_function;
+    static uint32_t bit_ns;
+
+    /* Transaction run by poll() */
+    int _address;
+    char *_data;
+    int _length;
+    int _position;
+    int _status;
+
+    /**
+     * @brief End the transaction run by poll() with a stop condition.
+     */
+    int finish(int status)
+    {
+        regs()->I2CONSET = FAST_I2C_STO;
+        regs()->I2CONCLR = FAST_I2C_SI;
+
+        return _status = status;
+    }
+
+    template <PinName P>
+    static void configure_pin()
+    {
+        const int index = P - P0_0;
+        const int port = index >> PORT_SHIFT;
+        const int bit = index & 31;
+        const int shift = (bit & 15) * 2;
+
+        volatile uint32_t *pinsel = &LPC_PINCON->PINSEL0 + port * 2 + (bit >> 4);
+        *pinsel = (*pinsel & ~(3UL << shift)) | ((uint32_t)fast_i2c_pin<N, P>::function << shift);
+
+        /* P0.27 and P0.28 are true open-drain pins configured by I2CPADCFG */
+        if (port == 0 && (bit == 27 || bit == 28))
+            return;
+
+        /* No pull-up or pull-down, open drain */
+        volatile uint32_t *pinmode = &LPC_PINCON->PINMODE0 + port * 2 + (bit >> 4);
+        *pinmode = (*pinmode & ~(3UL << shift)) | (2UL << shift);
+        (&LPC_PINCON->PINMODE_OD0)[port] |= 1UL << bit;
+    }
+
+    /**
+     * @brief Wait for the end of the current bus operation.
+     *
+     * The idle function is only called while the operation is expected to
+     * last, with the time left.
+     *
+     * @param[in] bits bit periods taken by the operation on the bus
+     * @return Status of the peripheral, FAST_I2C_ERROR_BUS on a bus error,
+     * FAST_I2C_ERROR_TIMEOUT if the operation does not end
+     */
+    static int wait(int bits)
+    {
+        uint32_t start = us_ticker_read();
+        uint32_t expected_us = bits * bit_ns / 1000;
+
+        for (;;) {
+            if (regs()->I2CONSET & FAST_I2C_SI) {
+                int status = regs()->I2STAT;
+                return status == FAST_I2C_BUS_ERROR ? FAST_I2C_ERROR_BUS : status;
+            }
+
+            uint32_t elapsed = us_ticker_read() - start;
+            if (elapsed >= FAST_I2C_TIMEOUT_US)
+                return FAST_I2C_ERROR_TIMEOUT;
+            if (idle_function && elapsed < expected_us)
+                idle_function(expected_us - elapsed);
+        }
+    }
+};
+
+template <int N, PinName SDA, PinName SCL>
+fast_i2c_idle FastI2C<N, SDA, SCL>::idle_function = NULL;
+
+template <int N, PinName SDA, PinName SCL>
+uint32_t FastI2C<N, SDA, SCL>::bit_ns;
+
+#endif
@@ -0,0 +1,321 @@
+#include "flash_log.h"
+#include "ahb_sram.h"
+#include "record.h"
+#include "trace.h"
+#include <string.h>
+
+/* SPI NOR commands */
+#define CMD_WRITE_ENABLE        (0x06)
+#define CMD_READ_STATUS         (0x05)
+#define CMD_PAGE_PROGRAM        (0x02)
+#define CMD_BLOCK_ERASE         (0xD8)
+#define CMD_READ_ID             (0x9F)
+#define STATUS_BUSY             (0x01)
+
+#define INDEX_QUEUE_SIZE        (4)
+
+static const struct flash_log_ops *ops;
+static uint32_t page_count;
+static uint32_t next_page;
+
+/* Staging buffers: one is filled while the other one is programmed */
+static uint8_t staging[2][FLASH_LOG_STAGING_PAGES][FLASH_LOG_PAGE_SIZE] AHB_SRAM0;
+static uint32_t staged_page[2][FLASH_LOG_STAGING_PAGES];
+static int fill_buffer;
+static int fill_page;
+static int fill_offset;
+static bool page_open;
+static int pending_buffer;
+static int pending_pages;
+static int pending_done;
+
+/* Page or index entry partially programmed by flash_log_step() */
+static int program_offset;
+static bool programming_index;
+static bool step_ready;         /* the flash was found not busy by the last step */
+
+/* Index entries waiting to be programmed */
+static uint8_t index_queue[INDEX_QUEUE_SIZE][FLASH_LOG_INDEX_ENTRY_SIZE];
+static int index_head;
+static int index_count;
+static uint32_t index_written;
+
+static uint32_t next_trace;
+static uint8_t current_test;
+static uint32_t current_iteration;
+static uint32_t dropped;
+
+static void command(uint8_t cmd, uint32_t address, bool with_address,
+                    const uint8_t *tx, int tx_length, uint8_t *rx, int rx_length)
+{
+    uint8_t buf[4] = {cmd, (uint8_t)(address >> 16), (uint8_t)(address >> 8), (uint8_t)address};
+
+    ops->transfer(buf, with_address ? 4 : 1, tx, tx_length, rx, rx_length);
+}
+
+static bool busy(void)
+{
+    uint8_t status;
+
+    command(CMD_READ_STATUS, 0, false, NULL, 0, &status, 1);
+    return status & STATUS_BUSY;
+}
+
+static void wait_ready(void)
+{
+    while (busy())
+        ;
+}
+
+static void program(uint32_t address, const uint8_t *data, int length)
+{
+    command(CMD_WRITE_ENABLE, 0, false, NULL, 0, NULL, 0);
+    command(CMD_PAGE_PROGRAM, address, true, data, length, NULL, 0);
+}
+
+static bool pending(void)
+{
+    return index_count || pending_pages;
+}
+
+/**
+ * @brief Program the next bytes of the index entry or page waiting.
+ *
+ * @param[in] max_length largest number of bytes programmed
+ */
+static void program_next(int max_length)
+{
+    const uint8_t *data;
+    uint32_t address;
+    int length;
+
+    if (program_offset == 0)
+        programming_index = index_count > 0;
+
+    if (programming_index) {
+        data = index_queue[index_head];
+        address = FLASH_LOG_PAGE_SIZE + index_written * FLASH_LOG_INDEX_ENTRY_SIZE;
+        length = FLASH_LOG_INDEX_ENTRY_SIZE;
+    } else {
+        data = staging[pending_buffer][pending_done];
+        address = staged_page[pending_buffer][pending_done] * FLASH_LOG_PAGE_SIZE;
+        length = FLASH_LOG_PAGE_SIZE;
+    }
+
+    if (length - program_offset < max_length)
+        max_length = length - program_offset;
+    program(address + program_offset, data + program_offset, max_length);
+    step_ready = false;
+    program_offset += max_length;
+    if (program_offset < length)
+        return;
+
+    program_offset = 0;
+    if (programming_index) {
+        index_head = (index_head + 1) % INDEX_QUEUE_SIZE;
+        --index_count;
+        ++index_written;
+    } else if (++pending_done == pending_pages) {
+        pending_pages = 0;
+    }
+}
+
+static void queue_index(uint32_t page)
+{
+    if (index_count == INDEX_QUEUE_SIZE
+    ||  index_written + index_count >= FLASH_LOG_INDEX_PAGES * (FLASH_LOG_PAGE_SIZE / FLASH_LOG_INDEX_ENTRY_SIZE))
+        return;
+
+    uint8_t *e = index_queue[(index_head + index_count) % INDEX_QUEUE_SIZE];
+    record_put_u32(&e[0], page);
+    record_put_u32(&e[4], next_trace);
+    e[8] = current_test;
+    e[9] = e[10] = e[11] = 0;
+    record_put_u32(&e[12], current_iteration);
+    ++index_count;
+}
+
+static void submit(int buffer, int pages)
+{
+    pending_buffer = buffer;
+    pending_pages = pages;
+    pending_done = 0;
+}
+
+static bool start_page(void)
+{
+    if (fill_page == FLASH_LOG_STAGING_PAGES) {
+        if (pending_pages)
+            return false;
+
+        submit(fill_buffer, fill_page);
+        fill_buffer ^= 1;
+        fill_page = 0;
+    }
+
+    if (next_page >= page_count)
+        return false;
+
+    memset(staging[fill_buffer][fill_page], 0xFF, FLASH_LOG_PAGE_SIZE);
+    staged_page[fill_buffer][fill_page] = next_page;
+    if ((next_page - FLASH_LOG_FIRST_PAGE) % FLASH_LOG_INDEX_INTERVAL == 0)
+        queue_index(next_page);
+
+    ++next_page;
+    fill_offset = FLASH_LOG_PAGE_HEADER_SIZE;
+    page_open = true;
+
+    return true;
+}
+
+static void close_page(void)
+{
+    uint8_t *p = staging[fill_buffer][fill_page];
+
+    p[0] = 'L';
+    p[1] = 0;
+    record_put_u16(&p[2], fill_offset);
+    record_put_u32(&p[4], staged_page[fill_buffer][fill_page]);
+    ++fill_page;
+    page_open = false;
+}
+
+bool flash_log_init(const struct flash_log_ops *flash_ops, uint32_t size)
+{
+    uint8_t id[3];
+
+    ops = flash_ops;
+    command(CMD_READ_ID, 0, false, NULL, 0, id, sizeof(id));
+    if ((id[0] == 0x00 || id[0] == 0xFF) && id[1] == id[0] && id[2] == id[0])
+        return false;
+
+    size = (size + FLASH_LOG_BLOCK_SIZE - 1) / FLASH_LOG_BLOCK_SIZE * FLASH_LOG_BLOCK_SIZE;
+    if (size < 2 * FLASH_LOG_BLOCK_SIZE)
+        size = 2 * FLASH_LOG_BLOCK_SIZE;
+
+    for (uint32_t address = 0; address < size; address += FLASH_LOG_BLOCK_SIZE) {
+        command(CMD_WRITE_ENABLE, 0, false, NULL, 0, NULL, 0);
+        command(CMD_BLOCK_ERASE, address, true, NULL, 0, NULL, 0);
+        wait_ready();
+    }
+
+    page_count = size / FLASH_LOG_PAGE_SIZE;
+    uint8_t superblock[FLASH_LOG_SUPERBLOCK_SIZE] = {'R', 'A', 'T', 'L', FLASH_LOG_VERSION, 0, 0, 0};
+    record_put_u32(&superblock[8], page_count);
+    record_put_u32(&superblock[12], FLASH_LOG_FIRST_PAGE);
+    program(0, superblock, sizeof(superblock));
+    wait_ready();
+
+    next_page = FLASH_LOG_FIRST_PAGE;
+    fill_buffer = 0;
+    fill_page = 0;
+    page_open = false;
+    pending_pages = 0;
+    program_offset = 0;
+    step_ready = false;
+    index_head = 0;
+    index_count = 0;
+    index_written = 0;
+    next_trace = trace_count();
+    current_test = 0;
+    current_iteration = 0;
+    dropped = 0;
+
+    return true;
+}
+
+void flash_log_write(const uint8_t *record, int length)
+{
+    if (page_open && fill_offset + length > FLASH_LOG_PAGE_SIZE)
+        close_page();
+
+    if (!page_open && !start_page()) {
+        ++dropped;
+        return;
+    }
+
+    memcpy(&staging[fill_buffer][fill_page][fill_offset], record, length);
+    fill_offset += length;
+}
+
+void flash_log_trace(void)
+{
+    uint8_t record[RECORD_MAX_SIZE];
+    uint32_t count = trace_count();
+
+    for (; next_trace != count; ++next_trace) {
+        const struct trace_entry *e = trace_get(next_trace);
+        if (e == NULL) {
+            ++dropped;
+            continue;
+        }
+
+        flash_log_write(record, record_encode_trace(record, next_trace, e));
+    }
+
+    flash_log_poll();
+}
+
+void flash_log_mark(uint8_t test, uint32_t iteration)
+{
+    uint8_t record[RECORD_MAX_SIZE];
+
+    current_test = test;
+    current_iteration = iteration;
+    flash_log_write(record, record_encode_iteration(record, test, iteration));
+}
+
+void flash_log_poll(void)
+{
+    if (!pending() || busy())
+        return;
+
+    program_next(FLASH_LOG_PAGE_SIZE);
+}
+
+void flash_log_step(void)
+{
+    if (!pending())
+        return;
+
+    if (!step_ready) {
+        step_ready = !busy();
+        return;
+    }
+
+    program_next(FLASH_LOG_STEP_SIZE);
+}
+
+void flash_log_sync(void)
+{
+    if (page_open)
+        close_page();
+
+    while (pending())
+        flash_log_poll();
+
+    if (fill_page > 0) {
+        submit(fill_buffer, fill_page);
+        fill_buffer ^= 1;
+        fill_page = 0;
+    }
+
+    while (pending())
+        flash_log_poll();
+    wait_ready();
+}
+
+uint32_t flash_log_dropped(void)
+{
+    return dropped;
+}
+
+bool flash_log_decode_index(const uint8_t *buf, struct flash_log_index_entry *entry)
+{
+    entry->page = record_get_u32(&buf[0]);
+    entry->trace_index = record_get_u32(&buf[4]);
+    entry->test = buf[8];
+    entry->iteration = record_get_u32(&buf[12]);
+
+    return entry->page != 0xFFFFFFFF;
+}
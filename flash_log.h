@@ -0,0 +1,132 @@
+/**
+ * Log-structured trace store on an SPI NOR flash.
+ *
+ * Records (see record.h) are appended to a log written one page at a time.
+ * They are staged in two RAM buffers of FLASH_LOG_STAGING_PAGES pages: while
+ * one buffer is programmed page by page, the other one is filled. Programming
+ * never blocks: flash_log_poll() sends the next page only when the flash is
+ * not busy. flash_log_step() does the same in shorter steps, which fit in the
+ * time of one byte on the I2C bus. When both buffers are full, records are
+ * dropped and counted.
+ *
+ * The whole log is erased by flash_log_init(), before the tests start, so
+ * that no erase happens while the tests run.
+ *
+ * Flash layout (FLASH_LOG_PAGE_SIZE pages):
+ *  - page 0: superblock
+ *      magic "RATL" (4), version (1), reserved (3), page count (4),
+ *      first log page (4)
+ *  - pages 1 to first log page - 1: index, one entry written every
+ *    FLASH_LOG_INDEX_INTERVAL log pages
+ *      page (4), next trace index (4), test (1), reserved (3), iteration (4)
+ *  - log pages
+ *      magic 'L' (1), reserved (1), bytes used (2), page (4), records
+ *
+ * Records never span two pages. Erased bytes are 0xFF, which marks the end of
+ * the index and of the log.
+ */
+
+#ifndef FLASH_LOG_H
+#define FLASH_LOG_H
+
+#include <stdint.h>
+
+#define FLASH_LOG_PAGE_SIZE         (256)
+#define FLASH_LOG_BLOCK_SIZE        (65536)
+#define FLASH_LOG_STAGING_PAGES     (4)
+#define FLASH_LOG_INDEX_INTERVAL    (16)
+#define FLASH_LOG_INDEX_PAGES       (FLASH_LOG_BLOCK_SIZE / FLASH_LOG_PAGE_SIZE - 1)
+#define FLASH_LOG_FIRST_PAGE        (FLASH_LOG_BLOCK_SIZE / FLASH_LOG_PAGE_SIZE)
+
+#define FLASH_LOG_SUPERBLOCK_SIZE   (16)
+#define FLASH_LOG_INDEX_ENTRY_SIZE  (16)
+#define FLASH_LOG_PAGE_HEADER_SIZE  (8)
+#define FLASH_LOG_VERSION           (1)
+#define FLASH_LOG_STEP_SIZE         (8)     /* bytes programmed by one step */
+
+struct flash_log_ops {
+    /**
+     * Select the flash, send the command and tx_length bytes, then receive
+     * rx_length bytes and deselect the flash.
+     */
+    void (*transfer)(const uint8_t *cmd, int cmd_length, const uint8_t *tx, int tx_length,
+                     uint8_t *rx, int rx_length);
+};
+
+struct flash_log_index_entry {
+    uint32_t page;
+    uint32_t trace_index;
+    uint8_t test;
+    uint32_t iteration;
+};
+
+/**
+ * @brief Erase the log and write its superblock.
+ *
+ * This blocks until the erase is complete.
+ *
+ * @param[in] ops access to the flash
+ * @param[in] size size of the log in bytes, rounded up to blocks, including
+ * the superblock and index block
+ * @return True on success, false if the flash does not answer
+ */
+bool flash_log_init(const struct flash_log_ops *ops, uint32_t size);
+
+/**
+ * @brief Append a record to the log.
+ *
+ * @param[in] record encoded record
+ * @param[in] length size of the record
+ */
+void flash_log_write(const uint8_t *record, int length);
+
+/**
+ * @brief Append the transactions of the flight recorder not logged yet.
+ */
+void flash_log_trace(void);
+
+/**
+ * @brief Append an iteration marker.
+ *
+ * The test and iteration are also stored in the next index entry so that a
+ * reader can seek to an iteration.
+ *
+ * @param[in] test test number
+ * @param[in] iteration iteration of the test
+ */
+void flash_log_mark(uint8_t test, uint32_t iteration);
+
+/**
+ * @brief Program the next staged page if the flash is not busy.
+ */
+void flash_log_poll(void);
+
+/**
+ * @brief Advance the programming by one SPI command.
+ *
+ * Each call either reads the status of the flash or, if it was found not
+ * busy, programs the next FLASH_LOG_STEP_SIZE bytes of the staged page.
+ */
+void flash_log_step(void);
+
+/**
+ * @brief Program all staged records, blocking until done.
+ */
+void flash_log_sync(void);
+
+/**
+ * @return Number of records dropped because the staging buffers were full or
+ * the log was full
+ */
+uint32_t flash_log_dropped(void);
+
+/**
+ * @brief Decode an index entry.
+ *
+ * @param[in] buf encoded entry
+ * @param[out] entry decoded entry
+ * @return False if the entry is erased
+ */
+bool flash_log_decode_index(const uint8_t *buf, struct flash_log_index_entry *entry);
+
+#endif
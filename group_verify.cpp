@@ -0,0 +1,153 @@
+#include "group_verify.h"
+#include <string.h>
+
+static void apply(char *regs, const struct group_verify_write *w)
+{
+    if (w->reg < GROUP_VERIFY_REGISTER_COUNT)
+        regs[w->reg] = w->value;
+}
+
+static bool same(const char *expected, const char *actual)
+{
+    if ((expected[0] & 0x0F) != (actual[0] & 0x0F))
+        return false;
+
+    return memcmp(&expected[1], &actual[1], GROUP_VERIFY_REGISTER_COUNT - 1) == 0;
+}
+
+static void fail(struct group_verify *g, unsigned int index, bool reproduced)
+{
+    if (index == GROUP_VERIFY_NOT_FOUND) {
+        g->failed_write = GROUP_VERIFY_NOT_FOUND;
+        g->failed.reg = 0;
+        g->failed.value = 0;
+    } else {
+        g->failed_write = g->first_write + index;
+        g->failed = g->writes[index];
+    }
+    g->nacked = false;
+    g->reproduced = reproduced;
+}
+
+/**
+ * @brief Restore the registers as before the group, replay its first writes
+ * and check the result.
+ *
+ * @return 1 if the registers match, 0 if not, -1 if a transaction failed
+ */
+static int probe(struct group_verify *g, unsigned int prefix)
+{
+    char expected[GROUP_VERIFY_REGISTER_COUNT];
+    char actual[GROUP_VERIFY_REGISTER_COUNT];
+
+    ++g->probes;
+    memcpy(expected, g->start, sizeof(expected));
+    if (!g->ops->restore(g->start))
+        return -1;
+
+    for (unsigned int i = 0; i < prefix; ++i) {
+        if (!g->ops->write(g->writes[i].reg, g->writes[i].value))
+            return -1;
+        apply(expected, &g->writes[i]);
+    }
+
+    if (!g->ops->read_all(actual))
+        return -1;
+
+    return same(expected, actual);
+}
+
+/**
+ * @brief Find the first write of the group after which the registers do not
+ * match.
+ */
+static void bisect(struct group_verify *g)
+{
+    /* The registers matched before the group and not after its last write */
+    unsigned int good = 0;
+    unsigned int bad = g->count;
+
+    while (bad - good > 1) {
+        unsigned int mid = good + (bad - good) / 2;
+        int ret = probe(g, mid);
+        if (ret < 0) {
+            fail(g, GROUP_VERIFY_NOT_FOUND, true);
+            return;
+        }
+        if (ret)
+            good = mid;
+        else
+            bad = mid;
+    }
+
+    /* Check that the whole group still fails, the fault may be intermittent */
+    int ret = probe(g, bad);
+    fail(g, ret == 0 ? bad - 1 : GROUP_VERIFY_NOT_FOUND, ret == 0);
+}
+
+static bool verify(struct group_verify *g)
+{
+    char actual[GROUP_VERIFY_REGISTER_COUNT];
+
+    if (g->count == 0)
+        return true;
+
+    ++g->groups;
+    if (!g->ops->read_all(actual)) {
+        fail(g, GROUP_VERIFY_NOT_FOUND, true);
+        return false;
+    }
+
+    if (!same(g->expected, actual)) {
+        bisect(g);
+        return false;
+    }
+
+    memcpy(g->start, g->expected, sizeof(g->start));
+    g->first_write += g->count;
+    g->count = 0;
+
+    return true;
+}
+
+void group_verify_init(struct group_verify *g, const struct group_verify_ops *ops,
+                       unsigned int size, const char *regs)
+{
+    g->ops = ops;
+    g->size = size == 0 ? 1 : size > GROUP_VERIFY_MAX_SIZE ? GROUP_VERIFY_MAX_SIZE : size;
+    g->count = 0;
+    memcpy(g->start, regs, sizeof(g->start));
+    memcpy(g->expected, regs, sizeof(g->expected));
+    g->first_write = 0;
+    g->failed_write = GROUP_VERIFY_NOT_FOUND;
+    g->nacked = false;
+    g->reproduced = false;
+    g->groups = 0;
+    g->probes = 0;
+}
+
+bool group_verify_write(struct group_verify *g, uint8_t reg, uint8_t value)
+{
+    struct group_verify_write *w = &g->writes[g->count];
+
+    w->reg = reg;
+    w->value = value;
+    if (!g->ops->write(reg, value)) {
+        fail(g, g->count, true);
+        g->nacked = true;
+        return false;
+    }
+
+    apply(g->expected, w);
+    ++g->count;
+
+    if (g->count < g->size)
+        return true;
+
+    return verify(g);
+}
+
+bool group_verify_flush(struct group_verify *g)
+{
+    return verify(g);
+}
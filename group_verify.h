@@ -0,0 +1,96 @@
+/**
+ * Group testing of register writes.
+ *
+ * Instead of reading back the registers after each write, writes are done in
+ * groups of K and the register file is read back once at the end of the
+ * group with a burst read. A group costs K + 2 transactions instead of 11K
+ * when each write is followed by the read-back of register 0-4.
+ *
+ * Only when the read-back does not match, the group is replayed to find the
+ * write at fault: the registers are restored to their value before the group
+ * with one burst write, the first writes of the group are replayed and the
+ * register file read back, halving the range of suspect writes each time.
+ * The write found is the first one after which the registers do not match.
+ *
+ * The engine only talks to the board through group_verify_ops and keeps the
+ * expected value of the registers itself (only the lower half of register 0
+ * is compared, writes to registers 5-255 change nothing).
+ */
+
+#ifndef GROUP_VERIFY_H
+#define GROUP_VERIFY_H
+
+#include <stdint.h>
+
+#define GROUP_VERIFY_MAX_SIZE       (64)
+#define GROUP_VERIFY_REGISTER_COUNT (5)
+
+/* Index of the write at fault when it could not be found */
+#define GROUP_VERIFY_NOT_FOUND      (0xFFFFFFFF)
+
+struct group_verify_ops {
+    /** Write one register (true on ack) */
+    bool (*write)(uint8_t reg, uint8_t value);
+
+    /** Write register 0-4 with one burst write (true on ack) */
+    bool (*restore)(const char *regs);
+
+    /** Read register 0-4 with one burst read (true on ack) */
+    bool (*read_all)(char *regs);
+};
+
+struct group_verify_write {
+    uint8_t reg;
+    uint8_t value;
+};
+
+struct group_verify {
+    const struct group_verify_ops *ops;
+    unsigned int size;
+    struct group_verify_write writes[GROUP_VERIFY_MAX_SIZE];
+    unsigned int count;                         /* writes in the current group */
+    char start[GROUP_VERIFY_REGISTER_COUNT];    /* registers before the group */
+    char expected[GROUP_VERIFY_REGISTER_COUNT];
+    uint32_t first_write;                       /* index of the first write of the group */
+
+    /* Failure */
+    uint32_t failed_write;                      /* index among all the writes */
+    struct group_verify_write failed;
+    bool nacked;                                /* the failed write was not acknowledged */
+    bool reproduced;                            /* false if the replay did not fail again */
+
+    /* Statistics */
+    unsigned long groups;
+    unsigned long probes;                       /* read-backs during replays */
+};
+
+/**
+ * @brief Start verifying writes in groups.
+ *
+ * @param[out] g engine
+ * @param[in] ops access to the board
+ * @param[in] size writes per group (at most GROUP_VERIFY_MAX_SIZE)
+ * @param[in] regs current value of register 0-4
+ */
+void group_verify_init(struct group_verify *g, const struct group_verify_ops *ops,
+                       unsigned int size, const char *regs);
+
+/**
+ * @brief Write a register, and verify the group if it is complete.
+ *
+ * @param[in] g engine
+ * @param[in] reg register, 5-255 for a write which must not change anything
+ * @param[in] value value written
+ * @return False if a write was not acknowledged (nacked is set) or the group
+ * did not verify, see failed_write and failed
+ */
+bool group_verify_write(struct group_verify *g, uint8_t reg, uint8_t value);
+
+/**
+ * @brief Verify the writes of an incomplete group.
+ *
+ * @return False if the group did not verify
+ */
+bool group_verify_flush(struct group_verify *g);
+
+#endif
@@ -0,0 +1,79 @@
+#include "histogram.h"
+#include <stdio.h>
+#include <string.h>
+
+void histogram_init(struct histogram *h, uint32_t bucket_width)
+{
+    memset(h, 0, sizeof(*h));
+    h->bucket_width = bucket_width;
+    h->min = 0xFFFFFFFF;
+}
+
+void histogram_add(struct histogram *h, uint32_t value)
+{
+    uint32_t bucket = value / h->bucket_width;
+
+    if (bucket < HISTOGRAM_BUCKET_COUNT)
+        ++h->buckets[bucket];
+    else
+        ++h->overflow;
+
+    ++h->count;
+    h->sum += value;
+    if (value < h->min)
+        h->min = value;
+    if (value > h->max)
+        h->max = value;
+}
+
+uint32_t histogram_percentile(const struct histogram *h, unsigned int percent)
+{
+    if (h->count == 0)
+        return 0;
+
+    /* Rank of the sample, rounded up so that p100 is the last sample */
+    uint32_t rank = (uint32_t)(((uint64_t)h->count * percent + 99) / 100);
+    if (rank == 0)
+        rank = 1;
+
+    uint32_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            uint32_t upper = (i + 1) * h->bucket_width - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+
+    return h->max;
+}
+
+void histogram_print(const struct histogram *h, const char *name, const char *unit)
+{
+    if (h->count == 0) {
+        printf("%s: no samples\n", name);
+        return;
+    }
+
+    printf("%s: n=%lu min=%lu%s mean=%lu%s p50=%lu%s p99=%lu%s max=%lu%s\n",
+           name, (unsigned long)h->count,
+           (unsigned long)h->min, unit,
+           (unsigned long)(h->sum / h->count), unit,
+           (unsigned long)histogram_percentile(h, 50), unit,
+           (unsigned long)histogram_percentile(h, 99), unit,
+           (unsigned long)h->max, unit);
+
+    for (int i = 0; i < HISTOGRAM_BUCKET_COUNT; ++i) {
+        if (h->buckets[i] == 0)
+            continue;
+
+        printf("  [%6lu, %6lu)%s %lu\n",
+               (unsigned long)(i * h->bucket_width),
+               (unsigned long)((i + 1) * h->bucket_width), unit,
+               (unsigned long)h->buckets[i]);
+    }
+    if (h->overflow)
+        printf("  >= %lu%s %lu\n",
+               (unsigned long)(HISTOGRAM_BUCKET_COUNT * h->bucket_width), unit,
+               (unsigned long)h->overflow);
+}
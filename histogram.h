@@ -0,0 +1,63 @@
+/**
+ * Fixed-bucket histogram of durations.
+ *
+ * Samples are stored in buckets of identical width so that recording a sample
+ * is cheap and does not allocate memory. Samples larger than the last bucket
+ * are counted as overflow but still update the minimum, maximum and mean.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdint.h>
+
+#define HISTOGRAM_BUCKET_COUNT          (32)
+
+struct histogram {
+    uint32_t bucket_width;
+    uint32_t buckets[HISTOGRAM_BUCKET_COUNT];
+    uint32_t overflow;
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t sum;
+};
+
+/**
+ * @brief Reset a histogram.
+ *
+ * @param[out] h histogram to reset
+ * @param[in] bucket_width width of each bucket (must be greater than 0)
+ */
+void histogram_init(struct histogram *h, uint32_t bucket_width);
+
+/**
+ * @brief Record one sample.
+ *
+ * @param[in] h histogram
+ * @param[in] value sample to record
+ */
+void histogram_add(struct histogram *h, uint32_t value);
+
+/**
+ * @brief Estimate a percentile from the buckets.
+ *
+ * The result is the upper bound of the bucket containing the percentile,
+ * except for samples in the overflow, where the maximum is returned.
+ *
+ * @param[in] h histogram
+ * @param[in] percent percentile to compute (0-100)
+ * @return Upper bound of the percentile, 0 if the histogram is empty
+ */
+uint32_t histogram_percentile(const struct histogram *h, unsigned int percent);
+
+/**
+ * @brief Print a summary and the non-empty buckets on the standard output.
+ *
+ * @param[in] h histogram
+ * @param[in] name label printed before the summary
+ * @param[in] unit unit of the samples (e.g. "us")
+ */
+void histogram_print(const struct histogram *h, const char *name, const char *unit);
+
+#endif
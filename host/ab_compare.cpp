@@ -0,0 +1,406 @@
+/**
+ * Compare the transaction latencies of two runs, for instance a board with
+ * the current firmware and a board with a new build.
+ *
+ * The inputs are replay logs (see replay.h), from host/flash_dump -r or
+ * host/trace_unpack -r. The latency of a transaction is its delta_us: the
+ * time since the end of the previous transaction, which includes the clock
+ * stretching of the slave. Acknowledged transactions are grouped by
+ * operation type:
+ *  - write: register write (register 0-4 and data),
+ *  - write invalid: write to register 5-255,
+ *  - pointer: register pointer write only,
+ *  - read: 1-byte read,
+ *  - burst read: read of more than one byte.
+ *
+ * For each type, the latencies of each run are counted in a histogram of 1 us
+ * buckets (longer latencies are clipped to the last bucket), so that tens of
+ * millions of samples are compared in a fraction of a second:
+ *  - Mann-Whitney rank-sum test, with tie correction, computed on the
+ *    histograms; P(new > base) is the probability that a transaction of the
+ *    new run is slower than one of the base run,
+ *  - bootstrap confidence intervals of the difference of the medians and of
+ *    the p99 (new - base). Each resample of a run draws the counts of its
+ *    histogram from a multinomial distribution instead of drawing samples.
+ *
+ * A difference is significant when the p-value is below alpha; a confidence
+ * interval not containing 0 is marked with '*'.
+ *
+ * To try it without fixtures, -g writes two synthetic logs, the reads of the
+ * new one being slower by the given percentage.
+ *
+ * usage: ab_compare [-B resamples] [-a alpha] [-s seed] base_log new_log
+ *        ab_compare -g base_log new_log [-n transactions] [-d slowdown_percent]
+ */
+
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "replay.h"
+
+#define LATENCY_BUCKETS     (65536)     /* 1 us each, the last one counts longer latencies */
+
+enum operation {
+    OP_WRITE,
+    OP_WRITE_INVALID,
+    OP_POINTER,
+    OP_READ,
+    OP_BURST_READ,
+    OP_COUNT
+};
+
+static const char *const operation_names[OP_COUNT] = {
+    "write", "write invalid", "pointer", "read", "burst read",
+};
+
+/** Latencies of one operation type in one run */
+struct latencies {
+    std::vector<uint64_t> counts;       /* LATENCY_BUCKETS */
+    uint64_t n;
+    uint64_t clipped;
+};
+
+struct run {
+    struct latencies ops[OP_COUNT];
+    unsigned long transactions;
+    unsigned long nacks;
+};
+
+/** Non-empty buckets of a histogram, for the bootstrap */
+struct bins {
+    std::vector<uint32_t> values;
+    std::vector<double> p;              /* p[i] / (1 - p[0] - ... - p[i-1]) */
+    uint64_t n;
+};
+
+static int classify(const struct replay_transaction *t)
+{
+    if (t->flags & TRACE_READ)
+        return t->length > 1 ? OP_BURST_READ : OP_READ;
+    if (t->length == 1)
+        return OP_POINTER;
+    if (t->length >= 2)
+        return t->data[0] < 5 ? OP_WRITE : OP_WRITE_INVALID;
+    return -1;
+}
+
+static bool load(const char *path, struct run *r)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return false;
+    }
+
+    const uint8_t *log = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (log == MAP_FAILED) {
+        perror(path);
+        return false;
+    }
+    madvise((void *)log, st.st_size, MADV_SEQUENTIAL);
+
+    if (!replay_check_header(log, st.st_size)) {
+        fprintf(stderr, "%s: not a replay log\n", path);
+        munmap((void *)log, st.st_size);
+        return false;
+    }
+
+    for (int i = 0; i < OP_COUNT; ++i) {
+        r->ops[i].counts.assign(LATENCY_BUCKETS, 0);
+        r->ops[i].n = 0;
+        r->ops[i].clipped = 0;
+    }
+    r->transactions = 0;
+    r->nacks = 0;
+
+    /* The delta of the first transaction is not a latency */
+    bool first = true;
+    for (size_t offset = REPLAY_HEADER_SIZE; offset < (size_t)st.st_size; first = false) {
+        struct replay_transaction t;
+        int n = replay_decode(&log[offset], st.st_size - offset, &t);
+        if (n == 0) {
+            fprintf(stderr, "%s: invalid record at %lu\n", path, (unsigned long)offset);
+            break;
+        }
+        offset += n;
+        ++r->transactions;
+
+        int op = classify(&t);
+        if (t.flags & TRACE_NACK) {
+            ++r->nacks;
+            continue;
+        }
+        if (first || op < 0)
+            continue;
+
+        struct latencies *l = &r->ops[op];
+        uint32_t bucket = t.delta_us;
+        if (bucket >= LATENCY_BUCKETS - 1) {
+            bucket = LATENCY_BUCKETS - 1;
+            ++l->clipped;
+        }
+        ++l->counts[bucket];
+        ++l->n;
+    }
+
+    munmap((void *)log, st.st_size);
+    return true;
+}
+
+/**
+ * @brief Value of the sample of rank ceil(q * n) (nearest rank).
+ */
+static uint32_t quantile(const std::vector<uint64_t> &counts, uint64_t n, double q)
+{
+    uint64_t rank = std::max<uint64_t>(1, (uint64_t)ceil(q * n));
+    uint64_t seen = 0;
+
+    for (uint32_t v = 0; v < counts.size(); ++v) {
+        seen += counts[v];
+        if (seen >= rank)
+            return v;
+    }
+    return counts.size() - 1;
+}
+
+static void make_bins(const struct latencies *l, struct bins *b)
+{
+    double left = 1;
+
+    b->n = l->n;
+    for (uint32_t v = 0; v < LATENCY_BUCKETS; ++v) {
+        if (l->counts[v] == 0)
+            continue;
+        double p = (double)l->counts[v] / l->n;
+        b->values.push_back(v);
+        b->p.push_back(left > 0 ? std::min(1.0, p / left) : 1.0);
+        left -= p;
+    }
+}
+
+/**
+ * @brief Draw a bootstrap resample of a run and get its median and p99.
+ *
+ * The counts of the buckets follow a multinomial distribution, drawn as a
+ * sequence of binomial distributions conditioned on the samples left.
+ */
+static void resample(const struct bins *b, std::mt19937_64 &rng, uint32_t *median, uint32_t *p99)
+{
+    uint64_t left = b->n;
+    uint64_t seen = 0;
+    uint64_t median_rank = std::max<uint64_t>(1, (uint64_t)ceil(0.5 * b->n));
+    uint64_t p99_rank = std::max<uint64_t>(1, (uint64_t)ceil(0.99 * b->n));
+
+    *median = *p99 = b->values.back();
+    for (size_t i = 0; i < b->values.size() && left; ++i) {
+        uint64_t count = left;
+        if (i + 1 < b->values.size() && b->p[i] < 1) {
+            std::binomial_distribution<uint64_t> binomial(left, b->p[i]);
+            count = binomial(rng);
+        }
+        left -= count;
+
+        if (seen < median_rank && seen + count >= median_rank)
+            *median = b->values[i];
+        if (seen < p99_rank && seen + count >= p99_rank) {
+            *p99 = b->values[i];
+            return;
+        }
+        seen += count;
+    }
+}
+
+/**
+ * @brief Mann-Whitney rank-sum test of two histograms.
+ *
+ * @param[out] superiority P(new > base) + P(new == base) / 2
+ * @return Two-sided p-value (normal approximation)
+ */
+static double rank_sum(const struct latencies *base, const struct latencies *now,
+                       double *superiority)
+{
+    long double u = 0, ties = 0;
+    uint64_t base_below = 0;
+
+    for (uint32_t v = 0; v < LATENCY_BUCKETS; ++v) {
+        uint64_t b = base->counts[v], n = now->counts[v];
+        if (b == 0 && n == 0)
+            continue;
+        u += (long double)n * (base_below + 0.5L * b);
+        long double t = (long double)b + n;
+        ties += t * t * t - t;
+        base_below += b;
+    }
+
+    long double n1 = base->n, n2 = now->n, total = n1 + n2;
+    *superiority = (double)(u / (n1 * n2));
+
+    long double variance = n1 * n2 / 12 * ((total + 1) - ties / (total * (total - 1)));
+    if (variance <= 0)
+        return 1;
+    long double z = (u - n1 * n2 / 2) / sqrtl(variance);
+    return erfc((double)(fabsl(z) / sqrtl(2)));
+}
+
+static double percentile_of(std::vector<double> &v, double q)
+{
+    std::sort(v.begin(), v.end());
+    size_t i = std::min(v.size() - 1, (size_t)(q * (v.size() - 1) + 0.5));
+    return v[i];
+}
+
+static void compare(const struct run *base, const struct run *now, int resamples, double alpha,
+                    unsigned long seed)
+{
+    printf("%-14s %10s %10s %19s %19s %11s %10s  %s\n", "operation", "base n", "new n",
+           "median us (CI)", "p99 us (CI)", "P(new>base)", "p-value", "verdict");
+
+    std::mt19937_64 rng(seed);
+    for (int op = 0; op < OP_COUNT; ++op) {
+        const struct latencies *b = &base->ops[op], *n = &now->ops[op];
+        if (b->n == 0 || n->n == 0)
+            continue;
+
+        struct bins base_bins, new_bins;
+        make_bins(b, &base_bins);
+        make_bins(n, &new_bins);
+
+        std::vector<double> median_diff(resamples), p99_diff(resamples);
+        for (int i = 0; i < resamples; ++i) {
+            uint32_t base_median, base_p99, new_median, new_p99;
+            resample(&base_bins, rng, &base_median, &base_p99);
+            resample(&new_bins, rng, &new_median, &new_p99);
+            median_diff[i] = (double)new_median - base_median;
+            p99_diff[i] = (double)new_p99 - base_p99;
+        }
+
+        double median_low = percentile_of(median_diff, alpha / 2);
+        double median_high = percentile_of(median_diff, 1 - alpha / 2);
+        double p99_low = percentile_of(p99_diff, alpha / 2);
+        double p99_high = percentile_of(p99_diff, 1 - alpha / 2);
+        double superiority;
+        double p = rank_sum(b, n, &superiority);
+
+        char median[64], p99[64];
+        snprintf(median, sizeof(median), "%u>%u [%+.0f,%+.0f]%s", quantile(b->counts, b->n, 0.5),
+                 quantile(n->counts, n->n, 0.5), median_low, median_high,
+                 median_low > 0 || median_high < 0 ? "*" : "");
+        snprintf(p99, sizeof(p99), "%u>%u [%+.0f,%+.0f]%s", quantile(b->counts, b->n, 0.99),
+                 quantile(n->counts, n->n, 0.99), p99_low, p99_high,
+                 p99_low > 0 || p99_high < 0 ? "*" : "");
+
+        printf("%-14s %10lu %10lu %19s %19s %11.4f %10.2g  %s\n", operation_names[op],
+               (unsigned long)b->n, (unsigned long)n->n, median, p99, superiority, p,
+               p >= alpha ? "no significant difference" : superiority > 0.5 ? "SLOWER" : "faster");
+        if (b->clipped || n->clipped)
+            printf("%-14s %lu and %lu latencies clipped to %d us\n", "", (unsigned long)b->clipped,
+                   (unsigned long)n->clipped, LATENCY_BUCKETS - 1);
+    }
+}
+
+/**
+ * @brief Write a synthetic log: the tests 1 and 3 sequences with latencies
+ * drawn from a log-normal distribution around the duration of each
+ * transaction at 400 kHz.
+ */
+static bool generate(const char *path, unsigned long transactions, double read_factor,
+                     unsigned long seed)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    std::vector<uint8_t> out;
+    uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+    struct replay_writer w;
+    out.insert(out.end(), buf, buf + replay_encode_header(buf, &w));
+
+    std::mt19937_64 rng(seed);
+    std::lognormal_distribution<double> jitter(0, 0.15);
+    uint64_t now_us = 0;
+    for (unsigned long i = 0; i < transactions; ++i) {
+        uint8_t data[2] = {(uint8_t)(rng() % 5), (uint8_t)rng()};
+        uint8_t flags = 0;
+        int length = 2;
+        switch (i % 3) {
+        case 1: length = 1; break;
+        case 2: flags = TRACE_READ; length = 1; data[0] = data[1]; break;
+        }
+
+        double base_us = 25 + 22.5 * (length + 1);
+        if (flags & TRACE_READ)
+            base_us *= read_factor;
+        now_us += (uint64_t)(base_us * jitter(rng));
+        int n = replay_encode(buf, &w, now_us, 0x3A, flags, data, length);
+        out.insert(out.end(), buf, buf + n);
+    }
+
+    fwrite(&out[0], out.size(), 1, file);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool generating = false;
+    unsigned long transactions = 10000000;
+    double slowdown = 2;
+    int resamples = 1000;
+    double alpha = 0.05;
+    unsigned long seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "gn:d:B:a:s:")) != -1) {
+        switch (opt) {
+        case 'g': generating = true; break;
+        case 'n': transactions = strtoul(optarg, NULL, 0); break;
+        case 'd': slowdown = strtod(optarg, NULL); break;
+        case 'B': resamples = strtoul(optarg, NULL, 0); break;
+        case 'a': alpha = strtod(optarg, NULL); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        default:
+            resamples = 0;
+            break;
+        }
+    }
+
+    if (optind != argc - 2 || resamples <= 0 || alpha <= 0 || alpha >= 1) {
+        fprintf(stderr, "usage: %s [-B resamples] [-a alpha] [-s seed] base_log new_log\n"
+                        "       %s -g base_log new_log [-n transactions] [-d slowdown_percent]\n",
+                argv[0], argv[0]);
+        return 1;
+    }
+
+    if (generating)
+        return !(generate(argv[optind], transactions, 1, seed)
+                 && generate(argv[optind + 1], transactions, 1 + slowdown / 100, seed + 1));
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    static struct run base, now;
+    if (!load(argv[optind], &base) || !load(argv[optind + 1], &now))
+        return 1;
+    printf("base: %lu transactions, %lu NACKs; new: %lu transactions, %lu NACKs\n",
+           base.transactions, base.nacks, now.transactions, now.nacks);
+
+    compare(&base, &now, resamples, alpha, seed);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    fprintf(stderr, "%.2f s\n", (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9);
+
+    return 0;
+}
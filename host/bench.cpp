@@ -0,0 +1,601 @@
+/**
+ * Microbenchmarks of the code shared with the firmware and of the host
+ * simulators, decoders and checkers.
+ *
+ * Each benchmark runs an operation n times. The harness first doubles n until
+ * a run lasts about 1/10 of the target time, scales n to the target time and
+ * runs the warm-up repetitions. The repetitions are then timed in rounds, one
+ * repetition of each benchmark per round, so that a disturbance of the system
+ * slows down a few repetitions of several benchmarks rather than all the
+ * repetitions of one. The time per operation of each repetition gives min,
+ * median, mean, standard deviation and median absolute deviation (MAD, scaled
+ * like a standard deviation but not inflated by one repetition disturbed by
+ * the system). -o also writes the results as JSON, one benchmark per line.
+ *
+ * -c compares two JSON runs: a benchmark regresses when its minimum time
+ * grows by more than the threshold (in percent). The minimum is the
+ * repetition least disturbed by the system, and it varies much less between
+ * two runs than the median does; comparing a build with itself passes.
+ * The exit status is 1 if any benchmark regressed.
+ *
+ * usage: bench [-f filter] [-r repetitions] [-w warmup] [-m target_ms] [-o results.json]
+ *        bench -c base.json new.json [-t threshold_percent]
+ */
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include "column_store.h"
+#include "record.h"
+#include "replay.h"
+#include "shared_bus.h"
+#include "slave_model.h"
+#include "trace_pack.h"
+#include "verify.h"
+#include "verify_policy.h"
+
+#define TRACE_SAMPLES       (1024)      /* transactions encoded beforehand */
+#define VERIFY_CHUNK        (4096)      /* bytes compared per operation */
+#define VERIFY_STREAM       (1 << 20)
+
+struct benchmark {
+    const char *name;
+    const char *unit;                   /* what one operation is */
+    uint64_t (*run)(unsigned long n);   /* returns a checksum, so that nothing is optimised out */
+};
+
+struct result {
+    std::string name;
+    std::string unit;
+    unsigned long n;
+    int repetitions;
+    double min;
+    double median;
+    double mean;
+    double stddev;
+    double mad;
+};
+
+static volatile uint64_t sink;
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/** Transactions of the tests used by the codec benchmarks */
+static struct trace_entry samples[TRACE_SAMPLES];
+
+static void make_samples(void)
+{
+    uint32_t seed = 1;
+    uint32_t now_us = 0;
+
+    for (int i = 0; i < TRACE_SAMPLES; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        struct trace_entry *e = &samples[i];
+        e->timestamp_us = now_us += 50 + seed % 50;
+        e->address = 0x3A;
+        e->flags = (i % 3 == 2) ? TRACE_READ : 0;
+        e->length = (i % 3 == 0) ? 2 : 1;
+        e->data[0] = (i % 3 == 2) ? seed >> 8 : 1 + seed % 4;
+        e->data[1] = seed >> 16;
+    }
+}
+
+static uint64_t bench_slave_model(unsigned long n)
+{
+    struct slave_model m;
+    uint64_t sum = 0;
+
+    slave_model_init(&m, 0, 0);
+    for (unsigned long i = 0; i < n; ++i) {
+        char data[2] = {(char)(1 + i % 4), (char)i};
+        char value;
+        slave_model_write(&m, data, 2, 0);
+        slave_model_write(&m, data, 1, 0);
+        slave_model_read(&m, &value, 1, 0);
+        sum += value;
+    }
+
+    return sum;
+}
+
+/* Simulated in runs of 100 ms, so that the time per ms does not depend on n */
+static uint64_t bench_shared_bus(unsigned long n)
+{
+    struct shared_bus_config config;
+    struct shared_bus_stats stats;
+    uint64_t sum = 0;
+
+    shared_bus_default_config(&config);
+    for (unsigned long i = 0; i < n; i += 100) {
+        shared_bus_run(&config, 0.1, &stats);
+        sum += stats.transactions;
+    }
+
+    return sum;
+}
+
+static uint64_t bench_xorshift(unsigned long n)
+{
+    uint32_t seed = 1;
+    uint64_t sum = 0;
+
+    for (unsigned long i = 0; i < n; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        sum += seed >> 8;
+    }
+
+    return sum;
+}
+
+static uint64_t bench_rand(unsigned long n)
+{
+    uint64_t sum = 0;
+
+    srand(1);
+    for (unsigned long i = 0; i < n; ++i)
+        sum += rand();
+
+    return sum;
+}
+
+static uint64_t bench_verify_policy(unsigned long n)
+{
+    struct verify_policy p;
+    uint64_t sum = 0;
+
+    verify_policy_init(&p, VERIFY_POLICY_RANDOM, 10, 1);
+    for (unsigned long i = 0; i < n; ++i)
+        sum += verify_policy_after_write(&p);
+
+    return sum;
+}
+
+static uint64_t bench_record_encode(unsigned long n)
+{
+    uint8_t buf[RECORD_MAX_SIZE];
+    uint64_t sum = 0;
+
+    for (unsigned long i = 0; i < n; ++i)
+        sum += record_encode_trace(buf, i, &samples[i % TRACE_SAMPLES]) + buf[6];
+
+    return sum;
+}
+
+static uint64_t bench_record_decode(unsigned long n)
+{
+    static std::vector<uint8_t> buf;
+    static std::vector<uint32_t> offsets;
+    uint64_t sum = 0;
+
+    if (buf.empty()) {
+        uint8_t record[RECORD_MAX_SIZE];
+        for (int i = 0; i < TRACE_SAMPLES; ++i) {
+            offsets.push_back(buf.size());
+            int size = record_encode_trace(record, i, &samples[i]);
+            buf.insert(buf.end(), record, record + size);
+        }
+    }
+
+    for (unsigned long i = 0; i < n; ++i) {
+        struct record r;
+        uint32_t offset = offsets[i % TRACE_SAMPLES];
+        sum += record_decode(&buf[offset], buf.size() - offset, &r) + r.trace.entry.timestamp_us;
+    }
+
+    return sum;
+}
+
+static uint64_t bench_replay_encode(unsigned long n)
+{
+    uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+    struct replay_writer w;
+    uint64_t sum = 0;
+
+    replay_encode_header(buf, &w);
+    for (unsigned long i = 0; i < n; ++i)
+        sum += replay_encode_trace(buf, &w, &samples[i % TRACE_SAMPLES]) + buf[3];
+
+    return sum;
+}
+
+static uint64_t bench_replay_decode(unsigned long n)
+{
+    static std::vector<uint8_t> log;
+    uint64_t sum = 0;
+
+    if (log.empty()) {
+        uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+        struct replay_writer w;
+        replay_encode_header(buf, &w);
+        for (int i = 0; i < TRACE_SAMPLES; ++i) {
+            int size = replay_encode_trace(buf, &w, &samples[i]);
+            log.insert(log.end(), buf, buf + size);
+        }
+    }
+
+    uint32_t offset = 0;
+    for (unsigned long i = 0; i < n; ++i) {
+        struct replay_transaction t;
+        if (offset == log.size())
+            offset = 0;
+        offset += replay_decode(&log[offset], log.size() - offset, &t);
+        sum += t.delta_us;
+    }
+
+    return sum;
+}
+
+static uint64_t bench_trace_pack(unsigned long n)
+{
+    uint8_t block[TRACE_HISTORY_BLOCK_SIZE];
+    struct trace_pack_encoder e;
+    uint64_t sum = 0;
+
+    trace_pack_start(&e, block, sizeof(block), 0);
+    for (unsigned long i = 0; i < n; ++i) {
+        const struct trace_entry *s = &samples[i % TRACE_SAMPLES];
+        if (!trace_pack_append(&e, s->timestamp_us, s->address, s->flags, s->data, s->length)) {
+            sum += e.length;
+            trace_pack_start(&e, block, sizeof(block), i);
+            trace_pack_append(&e, s->timestamp_us, s->address, s->flags, s->data, s->length);
+        }
+    }
+
+    return sum + e.length;
+}
+
+static uint64_t bench_trace_unpack(unsigned long n)
+{
+    static std::vector<uint8_t> blocks;
+    uint64_t sum = 0;
+
+    if (blocks.empty()) {
+        uint8_t block[TRACE_HISTORY_BLOCK_SIZE];
+        struct trace_pack_encoder e;
+        trace_pack_start(&e, block, sizeof(block), 0);
+        for (int i = 0; i < TRACE_SAMPLES; ++i) {
+            const struct trace_entry *s = &samples[i];
+            if (!trace_pack_append(&e, s->timestamp_us, s->address, s->flags, s->data, s->length)) {
+                blocks.insert(blocks.end(), block, block + e.length);
+                trace_pack_start(&e, block, sizeof(block), i);
+                trace_pack_append(&e, s->timestamp_us, s->address, s->flags, s->data, s->length);
+            }
+        }
+        blocks.insert(blocks.end(), block, block + e.length);
+    }
+
+    struct trace_pack_decoder d;
+    uint32_t offset = 0;
+    d.error = true;
+    for (unsigned long i = 0; i < n; ) {
+        uint32_t index;
+        struct trace_entry entry;
+        if (!d.error && trace_pack_next(&d, &index, &entry)) {
+            sum += entry.timestamp_us;
+            ++i;
+            continue;
+        }
+        if (offset == blocks.size())
+            offset = 0;
+        int size = trace_pack_block_size(&blocks[offset], blocks.size() - offset);
+        trace_pack_decoder_init(&d, &blocks[offset], size);
+        offset += size;
+    }
+
+    return sum;
+}
+
+static uint64_t bench_column_store(unsigned long n)
+{
+    static struct column_store_decoder d;
+    struct column_store_row rows[TRACE_DATA_MAX];
+    uint64_t sum = 0;
+
+    column_store_decoder_init(&d);
+    column_store_decoder_mark(&d, 1, 0);
+    for (unsigned long i = 0; i < n; ++i)
+        sum += column_store_decode(&d, &samples[i % TRACE_SAMPLES], 0, 0, rows);
+
+    return sum;
+}
+
+static uint64_t bench_verify(enum verify_kernel kernel, unsigned long n)
+{
+    static std::vector<uint8_t> expected, actual;
+    static struct verify_mask mask;
+    size_t mismatches[16];
+    uint64_t sum = 0;
+
+    if (expected.empty()) {
+        static const uint8_t pattern[8] = {0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+        verify_mask_init(&mask, pattern, sizeof(pattern));
+        expected.resize(VERIFY_STREAM);
+        actual.resize(VERIFY_STREAM);
+        for (size_t i = 0; i < VERIFY_STREAM; ++i)
+            expected[i] = actual[i] = i % 8 < 5 ? i * 7 : 0;
+    }
+
+    for (unsigned long i = 0; i < n; ++i) {
+        size_t offset = i * VERIFY_CHUNK % VERIFY_STREAM;
+        sum += verify_streams(kernel, &expected[offset], &actual[offset], VERIFY_CHUNK, &mask,
+                              mismatches, 16);
+    }
+
+    return sum;
+}
+
+static uint64_t bench_verify_scalar(unsigned long n) { return bench_verify(VERIFY_SCALAR, n); }
+static uint64_t bench_verify_sse2(unsigned long n) { return bench_verify(VERIFY_SSE2, n); }
+static uint64_t bench_verify_avx2(unsigned long n) { return bench_verify(VERIFY_AVX2, n); }
+
+static const struct benchmark benchmarks[] = {
+    {"slave_model/write_read", "write, pointer write and read", bench_slave_model},
+    {"shared_bus/run", "simulated ms", bench_shared_bus},
+    {"prng/xorshift32", "number", bench_xorshift},
+    {"prng/rand", "number", bench_rand},
+    {"prng/verify_policy_random", "write", bench_verify_policy},
+    {"record/encode_trace", "transaction", bench_record_encode},
+    {"record/decode_trace", "transaction", bench_record_decode},
+    {"replay/encode", "transaction", bench_replay_encode},
+    {"replay/decode", "transaction", bench_replay_decode},
+    {"trace_pack/append", "transaction", bench_trace_pack},
+    {"trace_pack/next", "transaction", bench_trace_unpack},
+    {"column_store/decode", "transaction", bench_column_store},
+    {"verify/scalar", "4 KB", bench_verify_scalar},
+    {"verify/sse2", "4 KB", bench_verify_sse2},
+    {"verify/avx2", "4 KB", bench_verify_avx2},
+};
+
+static double time_run(const struct benchmark *b, unsigned long n)
+{
+    double start = now_s();
+    sink = sink + b->run(n);
+    return now_s() - start;
+}
+
+/**
+ * @brief Find the number of operations of a repetition and warm up.
+ */
+static unsigned long calibrate(const struct benchmark *b, int warmup, double target_s)
+{
+    unsigned long n = 1;
+    double elapsed;
+
+    while ((elapsed = time_run(b, n)) < target_s / 10 && n < (1UL << 40))
+        n *= 2;
+    n = std::max(1.0, n * target_s / std::max(elapsed, 1e-9));
+
+    for (int i = 0; i < warmup; ++i)
+        time_run(b, n);
+
+    return n;
+}
+
+/**
+ * @brief Statistics of the times per operation of the repetitions.
+ */
+static struct result summarize(const struct benchmark *b, unsigned long n, std::vector<double> samples)
+{
+    int repetitions = samples.size();
+
+    std::sort(samples.begin(), samples.end());
+
+    struct result r;
+    r.name = b->name;
+    r.unit = b->unit;
+    r.n = n;
+    r.repetitions = repetitions;
+    r.min = samples[0];
+    r.median = repetitions % 2 ? samples[repetitions / 2]
+                               : (samples[repetitions / 2 - 1] + samples[repetitions / 2]) / 2;
+    r.mean = 0;
+    for (int i = 0; i < repetitions; ++i)
+        r.mean += samples[i] / repetitions;
+    r.stddev = 0;
+    for (int i = 0; i < repetitions; ++i)
+        r.stddev += (samples[i] - r.mean) * (samples[i] - r.mean);
+    r.stddev = repetitions > 1 ? sqrt(r.stddev / (repetitions - 1)) : 0;
+
+    std::vector<double> deviations(repetitions);
+    for (int i = 0; i < repetitions; ++i)
+        deviations[i] = fabs(samples[i] - r.median);
+    std::sort(deviations.begin(), deviations.end());
+    r.mad = 1.4826 * deviations[repetitions / 2];
+
+    return r;
+}
+
+static void write_json(FILE *file, const std::vector<struct result> &results)
+{
+    fprintf(file, "{\"benchmarks\": [\n");
+    for (size_t i = 0; i < results.size(); ++i) {
+        const struct result &r = results[i];
+        fprintf(file, "  {\"name\": \"%s\", \"unit\": \"ns per %s\", \"n\": %lu, \"repetitions\": %d, "
+                      "\"min\": %.4f, \"median\": %.4f, \"mean\": %.4f, \"stddev\": %.4f, \"mad\": %.4f}%s\n",
+                r.name.c_str(), r.unit.c_str(), r.n, r.repetitions, r.min, r.median, r.mean,
+                r.stddev, r.mad, i + 1 < results.size() ? "," : "");
+    }
+    fprintf(file, "]}\n");
+}
+
+/**
+ * @brief Get a number following "key": in a line of the JSON output.
+ */
+static bool json_number(const char *line, const char *key, double *value)
+{
+    char pattern[64];
+
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char *p = strstr(line, pattern);
+    if (p == NULL)
+        return false;
+    *value = strtod(p + strlen(pattern), NULL);
+    return true;
+}
+
+/**
+ * @brief Read the results written by write_json().
+ */
+static bool read_json(const char *path, std::vector<struct result> &results)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        const char *name = strstr(line, "\"name\": \"");
+        if (name == NULL)
+            continue;
+        name += strlen("\"name\": \"");
+
+        struct result r;
+        r.name.assign(name, strcspn(name, "\""));
+        if (!json_number(line, "median", &r.median) || !json_number(line, "stddev", &r.stddev)
+        ||  !json_number(line, "min", &r.min) || !json_number(line, "mean", &r.mean)
+        ||  !json_number(line, "mad", &r.mad)) {
+            fprintf(stderr, "%s: invalid line for %s\n", path, r.name.c_str());
+            fclose(file);
+            return false;
+        }
+        results.push_back(r);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static int compare(const char *base_path, const char *new_path, double threshold)
+{
+    std::vector<struct result> base, current;
+    if (!read_json(base_path, base) || !read_json(new_path, current))
+        return 2;
+
+    int regressions = 0;
+    printf("%-28s %12s %12s %8s\n", "benchmark", "base min", "new min", "change");
+    for (size_t i = 0; i < current.size(); ++i) {
+        const struct result *b = NULL;
+        for (size_t j = 0; j < base.size() && b == NULL; ++j)
+            if (base[j].name == current[i].name)
+                b = &base[j];
+        if (b == NULL || b->min <= 0) {
+            printf("%-28s %12s %12.2f %8s\n", current[i].name.c_str(), "-", current[i].min, "new");
+            continue;
+        }
+
+        const struct result &c = current[i];
+        double change = (c.min - b->min) / b->min * 100;
+        const char *verdict = "";
+        if (change > threshold) {
+            verdict = "  REGRESSION";
+            ++regressions;
+        } else if (change < -threshold) {
+            verdict = "  faster";
+        }
+        printf("%-28s %12.2f %12.2f %+7.1f%%%s\n", c.name.c_str(), b->min, c.min, change, verdict);
+    }
+
+    printf("%d regressions beyond %.1f%%\n", regressions, threshold);
+    return regressions ? 1 : 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filter = NULL;
+    const char *output = NULL;
+    bool comparing = false;
+    int repetitions = 20;
+    int warmup = 2;
+    double target_ms = 50;
+    double threshold = 15;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "f:r:w:m:o:ct:")) != -1) {
+        switch (opt) {
+        case 'f': filter = optarg; break;
+        case 'r': repetitions = strtoul(optarg, NULL, 0); break;
+        case 'w': warmup = strtoul(optarg, NULL, 0); break;
+        case 'm': target_ms = strtod(optarg, NULL); break;
+        case 'o': output = optarg; break;
+        case 'c': comparing = true; break;
+        case 't': threshold = strtod(optarg, NULL); break;
+        default:
+            repetitions = 0;
+            break;
+        }
+    }
+
+    if (comparing && optind == argc - 2)
+        return compare(argv[optind], argv[optind + 1], threshold);
+
+    if (comparing || optind != argc || repetitions <= 0 || target_ms <= 0) {
+        fprintf(stderr, "usage: %s [-f filter] [-r repetitions] [-w warmup] [-m target_ms] [-o results.json]\n"
+                        "       %s -c base.json new.json [-t threshold_percent]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    make_samples();
+
+    std::vector<const struct benchmark *> selected;
+    std::vector<unsigned long> counts;
+    for (unsigned int i = 0; i < sizeof(benchmarks) / sizeof(benchmarks[0]); ++i) {
+        const struct benchmark *b = &benchmarks[i];
+        if (filter && strstr(b->name, filter) == NULL)
+            continue;
+        if ((b->run == bench_verify_sse2 && !verify_supported(VERIFY_SSE2))
+        ||  (b->run == bench_verify_avx2 && !verify_supported(VERIFY_AVX2))) {
+            printf("%-28s not supported\n", b->name);
+            continue;
+        }
+
+        selected.push_back(b);
+        counts.push_back(calibrate(b, warmup, target_ms / 1000));
+    }
+
+    std::vector<std::vector<double> > samples(selected.size(), std::vector<double>(repetitions));
+    for (int round = 0; round < repetitions; ++round)
+        for (size_t i = 0; i < selected.size(); ++i)
+            samples[i][round] = time_run(selected[i], counts[i]) * 1e9 / counts[i];
+
+    std::vector<struct result> results;
+    printf("%-28s %12s %12s %12s %8s %8s  %s\n", "benchmark", "min ns", "median ns", "mean ns",
+           "stddev", "mad", "per");
+    for (size_t i = 0; i < selected.size(); ++i) {
+        struct result r = summarize(selected[i], counts[i], samples[i]);
+        printf("%-28s %12.2f %12.2f %12.2f %7.1f%% %7.1f%%  %s\n", r.name.c_str(), r.min, r.median,
+               r.mean, r.median > 0 ? 100 * r.stddev / r.median : 0.0,
+               r.median > 0 ? 100 * r.mad / r.median : 0.0, r.unit.c_str());
+        results.push_back(r);
+    }
+
+    if (output) {
+        FILE *file = fopen(output, "w");
+        if (file == NULL) {
+            perror(output);
+            return 1;
+        }
+        write_json(file, results);
+        fclose(file);
+    }
+
+    return 0;
+}
@@ -0,0 +1,134 @@
+/**
+ * Simulate boards and peripherals sharing one I2C bus.
+ *
+ * The bus model (see shared_bus.h) runs transaction by transaction on a
+ * virtual clock, so hours of bus time are simulated in seconds. A single run
+ * reports the utilization of the bus, the latency of the board operations
+ * and the arbitration losses between the masters.
+ *
+ * -c runs the simulation for 1 to the given number of boards and reports the
+ * largest number of boards for which the operations still complete within
+ * the p99 latency target (-l) without overflowing the queues of the masters.
+ *
+ * usage: bus_sim [-m masters] [-b boards] [-r operations_per_s] [-f bus_frequency]
+ *                [-k stretch_us] [-t duration_s] [-p] [-s seed]
+ *        bus_sim -c max_boards [-l p99_target_us] [options]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "shared_bus.h"
+
+static double wall_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void print_stats(const struct shared_bus_stats *stats, double wall)
+{
+    double simulated = stats->simulated_ns / 1e9;
+
+    printf("simulated %.0f s of bus time in %.2f s (%.0fx real time, %.0f events/s)\n",
+           simulated, wall, simulated / wall, stats->events / wall);
+    printf("bus utilization %.1f%%, %.0f transactions/s\n",
+           100.0 * stats->busy_ns / stats->simulated_ns, stats->transactions / simulated);
+    printf("operations: %lu completed, %lu failed, %lu dropped, %lu mismatches\n",
+           stats->operations, stats->failed, stats->dropped, stats->mismatches);
+    printf("nacks: %lu\n", stats->nacks);
+    printf("arbitration losses: %lu (%.1f/s)\n",
+           stats->arbitration_losses, stats->arbitration_losses / simulated);
+    histogram_print(&stats->latency, "operation latency", "us");
+    histogram_print(&stats->recovery, "recovery after arbitration loss", "us");
+}
+
+/**
+ * @brief Find how many boards can share the bus.
+ */
+static int plan_capacity(struct shared_bus_config *config, double duration_s,
+                         int max_boards, uint32_t target_us)
+{
+    int capacity = 0;
+
+    /* Resolve the latencies up to twice the target, beyond is over anyway */
+    config->latency_bucket_us = (2 * target_us + HISTOGRAM_BUCKET_COUNT - 1) / HISTOGRAM_BUCKET_COUNT;
+    if (config->latency_bucket_us == 0)
+        config->latency_bucket_us = 1;
+
+    printf("%6s %8s %10s %8s %8s %10s %8s %8s\n", "boards", "busy %", "ops/s",
+           "p50 us", "p99 us", "losses/s", "failed", "dropped");
+    for (int boards = 1; boards <= max_boards; ++boards) {
+        struct shared_bus_stats stats;
+
+        config->boards = boards;
+        shared_bus_run(config, duration_s, &stats);
+
+        double simulated = stats.simulated_ns / 1e9;
+        uint32_t p99 = histogram_percentile(&stats.latency, 99);
+        printf("%6d %8.1f %10.0f %8lu %8lu %10.1f %8lu %8lu\n", boards,
+               100.0 * stats.busy_ns / stats.simulated_ns, stats.operations / simulated,
+               (unsigned long)histogram_percentile(&stats.latency, 50), (unsigned long)p99,
+               stats.arbitration_losses / simulated, stats.failed, stats.dropped);
+        fflush(stdout);
+
+        if (p99 <= target_us && stats.dropped == 0 && capacity == boards - 1)
+            capacity = boards;
+    }
+
+    printf("up to %d boards per bus with p99 latency <= %lu us\n",
+           capacity, (unsigned long)target_us);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct shared_bus_config config;
+    double duration_s = 3600;
+    int max_boards = 0;
+    uint32_t target_us = 2000;
+    int opt;
+
+    shared_bus_default_config(&config);
+    while ((opt = getopt(argc, argv, "m:b:r:f:k:t:ps:c:l:")) != -1) {
+        switch (opt) {
+        case 'm': config.masters = strtoul(optarg, NULL, 0); break;
+        case 'b': config.boards = strtoul(optarg, NULL, 0); break;
+        case 'r': config.operation_rate = strtod(optarg, NULL); break;
+        case 'f': config.frequency = strtoul(optarg, NULL, 0); break;
+        case 'k': config.stretch_ns = strtoul(optarg, NULL, 0) * 1000; break;
+        case 't': duration_s = strtod(optarg, NULL); break;
+        case 'p': config.peripherals = false; break;
+        case 's': config.seed = strtoul(optarg, NULL, 0); break;
+        case 'c': max_boards = strtoul(optarg, NULL, 0); break;
+        case 'l': target_us = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-m masters] [-b boards] [-r operations_per_s] [-f bus_frequency]\n"
+                            "          [-k stretch_us] [-t duration_s] [-p] [-s seed]\n"
+                            "       %s -c max_boards [-l p99_target_us] [options]\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if (config.masters < 1 || config.masters > SHARED_BUS_MAX_MASTERS
+    ||  config.boards < 1 || config.boards > SHARED_BUS_MAX_BOARDS
+    ||  max_boards > SHARED_BUS_MAX_BOARDS
+    ||  config.frequency <= 0 || config.operation_rate <= 0 || duration_s <= 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    if (max_boards)
+        return plan_capacity(&config, duration_s, max_boards, target_us);
+
+    struct shared_bus_stats stats;
+    double start = wall_time();
+    shared_bus_run(&config, duration_s, &stats);
+    print_stats(&stats, wall_time() - start);
+
+    return 0;
+}
@@ -0,0 +1,265 @@
+/**
+ * Collect the results published by the fixtures on a CAN bus.
+ *
+ * The gateway reads the bus through SocketCAN, so it can be tested against a
+ * virtual interface:
+ *
+ *   # ip link add dev vcan0 type vcan && ip link set vcan0 up
+ *   $ can_gateway -i vcan0 &
+ *   $ can_gateway -i vcan0 -g 48
+ *
+ * Each message is reported as soon as it is received. A summary of all
+ * fixtures is printed every period and when the gateway exits (after the
+ * given duration, if any).
+ *
+ * usage: can_gateway [-i interface] [-p period_ms] [-d duration_s]
+ *        can_gateway [-i interface] -g fixtures
+ */
+
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include "can_message.h"
+
+#define FIXTURE_COUNT       (256)
+#define TEST_COUNT          (8)     /* tests of main.cpp */
+
+struct fixture_state {
+    bool seen;
+    uint8_t next_sequence;
+    unsigned long messages;
+    unsigned long lost;
+    unsigned long transactions;
+    unsigned long nacks;
+    int passed;
+    int failed_test;
+    bool done;
+    uint64_t last_seen_ms;
+};
+
+static struct fixture_state fixtures[FIXTURE_COUNT];
+
+static uint64_t now_ms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int open_bus(const char *name)
+{
+    struct sockaddr_can addr;
+    struct ifreq ifr;
+    int fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+        perror(name);
+        close(fd);
+        return -1;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.can_family = AF_CAN;
+    addr.can_ifindex = ifr.ifr_ifindex;
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static void handle_message(const struct can_message *m)
+{
+    struct fixture_state *f = &fixtures[m->fixture];
+
+    if (f->seen && m->sequence != f->next_sequence) {
+        uint8_t lost = m->sequence - f->next_sequence;
+        printf("fixture %u: lost %u messages\n", m->fixture, lost);
+        f->lost += lost;
+    }
+    f->seen = true;
+    f->next_sequence = m->sequence + 1;
+    f->last_seen_ms = now_ms();
+    ++f->messages;
+
+    switch (m->type) {
+    case CAN_MESSAGE_RESULT:
+        printf("fixture %u: test %u %s in %lu ms\n", m->fixture, m->result.test,
+               m->result.passed ? "PASS" : "FAIL", (unsigned long)m->result.elapsed_ms);
+        if (m->result.passed)
+            ++f->passed;
+        else
+            f->failed_test = m->result.test;
+        break;
+    case CAN_MESSAGE_COUNTERS:
+        f->transactions += m->counters.transactions;
+        f->nacks += m->counters.nacks;
+        break;
+    case CAN_MESSAGE_DONE:
+        printf("fixture %u: done, %s\n", m->fixture,
+               m->done.failed_test ? "FAIL" : "all tests passed");
+        f->done = true;
+        f->failed_test = m->done.failed_test;
+        break;
+    }
+}
+
+static void print_summary(void)
+{
+    uint64_t now = now_ms();
+
+    printf("%8s %8s %6s %6s %12s %8s %8s %10s\n", "fixture", "state", "passed", "failed",
+           "transactions", "nacks", "lost", "silent ms");
+    for (int i = 0; i < FIXTURE_COUNT; ++i) {
+        const struct fixture_state *f = &fixtures[i];
+        if (!f->seen)
+            continue;
+
+        printf("%8d %8s %6d %6d %12lu %8lu %8lu %10lu\n", i,
+               f->done ? "done" : "running", f->passed, f->failed_test,
+               f->transactions, f->nacks, f->lost, (unsigned long)(now - f->last_seen_ms));
+    }
+    fflush(stdout);
+}
+
+static int gateway(int fd, unsigned long period_ms, unsigned long duration_s)
+{
+    struct pollfd pfd = {fd, POLLIN, 0};
+    uint64_t start = now_ms();
+    uint64_t next_summary = start + period_ms;
+
+    while (duration_s == 0 || now_ms() - start < duration_s * 1000) {
+        uint64_t now = now_ms();
+        int timeout = now < next_summary ? (int)(next_summary - now) : 0;
+
+        if (poll(&pfd, 1, timeout) > 0) {
+            struct can_frame frame;
+            if (read(fd, &frame, sizeof(frame)) != sizeof(frame))
+                continue;
+            if (frame.can_id & (CAN_EFF_FLAG | CAN_RTR_FLAG | CAN_ERR_FLAG))
+                continue;
+
+            struct can_message m;
+            if (can_message_decode(frame.can_id & CAN_SFF_MASK, frame.data, frame.can_dlc, &m))
+                handle_message(&m);
+            fflush(stdout);
+        }
+
+        if (now_ms() >= next_summary) {
+            print_summary();
+            next_summary += period_ms;
+        }
+    }
+
+    print_summary();
+    return 0;
+}
+
+static bool send_message(int fd, struct can_message *m, uint8_t *sequence)
+{
+    struct can_frame frame;
+    uint16_t id;
+
+    m->sequence = (*sequence)++;
+    memset(&frame, 0, sizeof(frame));
+    frame.can_dlc = can_message_encode(m, &id, frame.data);
+    frame.can_id = id;
+
+    return write(fd, &frame, sizeof(frame)) == sizeof(frame);
+}
+
+/**
+ * @brief Publish the results of a run from many fixtures at once.
+ */
+static int generate(int fd, int fixture_count)
+{
+    uint8_t sequences[FIXTURE_COUNT];
+    memset(sequences, 0, sizeof(sequences));
+
+    for (int test = 1; test <= TEST_COUNT; ++test) {
+        for (int i = 0; i < fixture_count; ++i) {
+            struct can_message m;
+            bool passed = rand() % 100 != 0;
+
+            m.fixture = i;
+            m.type = CAN_MESSAGE_RESULT;
+            m.result.test = test;
+            m.result.passed = passed;
+            m.result.elapsed_ms = 100 + rand() % 1000;
+            if (!send_message(fd, &m, &sequences[i]))
+                perror("write");
+
+            m.type = CAN_MESSAGE_COUNTERS;
+            m.counters.test = test;
+            m.counters.transactions = 1000 + rand() % 5000;
+            m.counters.nacks = 0;
+            send_message(fd, &m, &sequences[i]);
+            usleep(100);
+        }
+    }
+
+    for (int i = 0; i < fixture_count; ++i) {
+        struct can_message m;
+        m.fixture = i;
+        m.type = CAN_MESSAGE_DONE;
+        m.done.failed_test = 0;
+        m.done.test_count = TEST_COUNT;
+        send_message(fd, &m, &sequences[i]);
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *name = "can0";
+    unsigned long period_ms = 5000;
+    unsigned long duration_s = 0;
+    int fixture_count = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:p:d:g:")) != -1) {
+        switch (opt) {
+        case 'i': name = optarg; break;
+        case 'p': period_ms = strtoul(optarg, NULL, 0); break;
+        case 'd': duration_s = strtoul(optarg, NULL, 0); break;
+        case 'g': fixture_count = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-i interface] [-p period_ms] [-d duration_s]\n"
+                            "       %s [-i interface] -g fixtures\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    if (fixture_count > FIXTURE_COUNT || period_ms == 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    int fd = open_bus(name);
+    if (fd < 0)
+        return 1;
+
+    int ret = fixture_count ? generate(fd, fixture_count) : gateway(fd, period_ms, duration_s);
+    close(fd);
+
+    return ret;
+}
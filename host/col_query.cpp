@@ -0,0 +1,295 @@
+/**
+ * Query the columnar store of register accesses (see column_store.h).
+ *
+ * Rows are selected with filters on the columns, then printed (-m rows at
+ * most), counted (-c) or summarized by a percentile of their latency per
+ * board (-p). For instance:
+ *  - p99 write latency by board over the last week:
+ *    col_query store -W -s 604800 -p 99
+ *  - failures on register 3 after a write to an invalid register:
+ *    col_query store -f -r 3 -i
+ *
+ * Each filter is applied to its column for a whole block at once, and blocks
+ * outside the time window are skipped.
+ *
+ * To try it without fixtures, -g appends synthetic rows to a store.
+ *
+ * usage: col_query store [-b board] [-t test] [-r register] [-s seconds] [-R | -W] [-i] [-f]
+ *                        [-c | -p percentile | -m max_rows]
+ *        col_query -g store [-n rows] [-B boards] [-d days]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "column_store.h"
+
+#define LATENCY_BUCKETS     (4096)      /* 1 us each, the last one counts longer latencies */
+#define MAX_BOARDS          (65536)
+
+struct query {
+    long board;                 /* -1: any */
+    long test;
+    long reg;
+    uint32_t since;             /* minimum time */
+    uint8_t flags_mask;         /* rows with (flags & flags_mask) == flags_value */
+    uint8_t flags_value;
+    bool failures;              /* mismatch or NACK */
+};
+
+/**
+ * @brief Select the rows of a block matching the query, one column at a time.
+ *
+ * @return Number of rows selected
+ */
+static uint32_t select_rows(const struct column_store_block *b, const struct query *q,
+                            uint8_t *sel)
+{
+    uint32_t n = b->rows;
+
+    for (uint32_t i = 0; i < n; ++i)
+        sel[i] = (b->flags[i] & q->flags_mask) == q->flags_value;
+
+    if (q->failures)
+        for (uint32_t i = 0; i < n; ++i)
+            sel[i] &= (b->flags[i] & (COLUMN_STORE_MISMATCH | COLUMN_STORE_NACK)) != 0;
+
+    if (q->since > b->min_time)
+        for (uint32_t i = 0; i < n; ++i)
+            sel[i] &= b->time[i] >= q->since;
+
+    if (q->board >= 0) {
+        uint16_t board = q->board;
+        for (uint32_t i = 0; i < n; ++i)
+            sel[i] &= b->board[i] == board;
+    }
+
+    if (q->test >= 0) {
+        uint8_t test = q->test;
+        for (uint32_t i = 0; i < n; ++i)
+            sel[i] &= b->test[i] == test;
+    }
+
+    if (q->reg >= 0) {
+        uint8_t reg = q->reg;
+        for (uint32_t i = 0; i < n; ++i)
+            sel[i] &= b->reg[i] == reg;
+    }
+
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < n; ++i)
+        count += sel[i];
+
+    return count;
+}
+
+static void print_row(const struct column_store_block *b, uint32_t i)
+{
+    char date[32];
+    time_t t = b->time[i];
+    uint8_t flags = b->flags[i];
+
+    strftime(date, sizeof(date), "%Y-%m-%d %H:%M:%S", localtime(&t));
+    printf("%s board %u test %u #%lu %c reg %u expected %02X actual %02X %lu us%s%s%s\n",
+           date, b->board[i], b->test[i], (unsigned long)b->iteration[i],
+           (flags & COLUMN_STORE_READ) ? 'R' : 'W', b->reg[i], b->expected[i], b->actual[i],
+           (unsigned long)b->latency_us[i],
+           (flags & COLUMN_STORE_NACK) ? " NACK" : "",
+           (flags & COLUMN_STORE_MISMATCH) ? " MISMATCH" : "",
+           (flags & COLUMN_STORE_AFTER_INVALID) ? " after-invalid" : "");
+}
+
+static int run_query(const char *path, const struct query *q, bool count_only,
+                     double percentile, unsigned long max_rows)
+{
+    struct column_store_reader reader;
+    if (!column_store_map(&reader, path)) {
+        fprintf(stderr, "%s: not a store\n", path);
+        return 1;
+    }
+
+    static uint8_t sel[COLUMN_STORE_BLOCK_ROWS];
+    /* Latency histograms of the boards, in the order they are found */
+    std::vector<int> slots(MAX_BOARDS, -1);
+    std::vector<uint16_t> slot_boards;
+    std::vector<uint32_t> histograms;
+    unsigned long rows = 0;
+    unsigned long selected = 0;
+    unsigned long printed = 0;
+    unsigned long blocks = 0;
+    unsigned long skipped = 0;
+    struct timespec start, end;
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    struct column_store_block b;
+    while (column_store_next(&reader, &b)) {
+        ++blocks;
+        rows += b.rows;
+        if (b.max_time < q->since) {
+            ++skipped;
+            continue;
+        }
+
+        uint32_t n = select_rows(&b, q, sel);
+        selected += n;
+        if (n == 0 || count_only)
+            continue;
+
+        if (percentile > 0) {
+            /* Adding the selection rather than testing it avoids mispredicted
+             * branches when many rows match, but not when a few of them do */
+            bool sparse = n < b.rows / 8;
+            for (uint32_t i = 0; i < b.rows; ++i) {
+                if (sparse && !sel[i])
+                    continue;
+                int slot = slots[b.board[i]];
+                if (slot < 0) {
+                    slot = slots[b.board[i]] = slot_boards.size();
+                    slot_boards.push_back(b.board[i]);
+                    histograms.resize(slot_boards.size() * LATENCY_BUCKETS);
+                }
+                uint32_t latency = b.latency_us[i] < LATENCY_BUCKETS ? b.latency_us[i] : LATENCY_BUCKETS - 1;
+                histograms[slot * LATENCY_BUCKETS + latency] += sel[i];
+            }
+        } else {
+            for (uint32_t i = 0; i < b.rows && printed < max_rows; ++i) {
+                if (sel[i]) {
+                    print_row(&b, i);
+                    ++printed;
+                }
+            }
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    for (int board = 0; board < MAX_BOARDS; ++board) {
+        if (slots[board] < 0)
+            continue;
+        const uint32_t *h = &histograms[slots[board] * LATENCY_BUCKETS];
+
+        unsigned long total = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; ++i)
+            total += h[i];
+        if (total == 0)
+            continue;
+
+        /* Smallest latency with at least percentile % of the rows at or below it */
+        unsigned long rank = (unsigned long)(total * percentile / 100.0 + 0.999999);
+        unsigned long seen = 0;
+        int value = 0;
+        while (value < LATENCY_BUCKETS - 1 && (seen += h[value]) < rank)
+            ++value;
+        printf("board %d: %lu rows, p%g %d us%s\n", board, total, percentile, value,
+               value == LATENCY_BUCKETS - 1 ? " or more" : "");
+    }
+
+    double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "%lu rows selected out of %lu in %lu blocks (%lu skipped), %.1f ms\n",
+            selected, rows, blocks, skipped, wall * 1e3);
+
+    column_store_unmap(&reader);
+    return 0;
+}
+
+/**
+ * @brief Append synthetic rows: boards running tests 3 and 4 over the last
+ * days, with rare corruptions after invalid writes.
+ */
+static int generate(const char *path, unsigned long rows, unsigned int boards, unsigned int days)
+{
+    struct column_store_writer w;
+    if (!column_store_open(&w, path)) {
+        fprintf(stderr, "%s: cannot open store\n", path);
+        return 1;
+    }
+
+    uint32_t now = time(NULL);
+    uint32_t first = now - days * 86400;
+    uint32_t seed = 1;
+    for (unsigned long i = 0; i < rows; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+
+        struct column_store_row r;
+        r.time = first + (uint64_t)i * (now - first) / rows;
+        r.board = i % boards;
+        r.test = 3 + (seed & 1);
+        r.iteration = (i / boards / 6) % 500;
+        r.reg = (seed >> 1) % 5;
+        r.flags = (seed & 0x10) ? COLUMN_STORE_READ : 0;
+        if (r.test == 4 && (r.flags & COLUMN_STORE_READ))
+            r.flags |= COLUMN_STORE_AFTER_INVALID;
+        r.expected = r.actual = seed >> 8;
+        if ((seed >> 16) % 100000 == 0 && (r.flags & COLUMN_STORE_AFTER_INVALID)) {
+            r.actual ^= 0x08;
+            r.flags |= COLUMN_STORE_MISMATCH;
+        }
+        /* Slower boards, and a tail of stretched transactions */
+        r.latency_us = 90 + r.board % 7 * 5 + ((seed >> 20) % 64 == 0 ? (seed >> 24) : 0);
+        column_store_append(&w, &r);
+    }
+
+    column_store_close(&w);
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    struct query q = {-1, -1, -1, 0, 0, 0, false};
+    const char *output = NULL;
+    bool count_only = false;
+    double percentile = 0;
+    unsigned long max_rows = 20;
+    unsigned long rows = 10000000;
+    unsigned int boards = 100;
+    unsigned int days = 14;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:t:r:s:RWifcp:m:g:n:B:d:")) != -1) {
+        switch (opt) {
+        case 'b': q.board = strtol(optarg, NULL, 0); break;
+        case 't': q.test = strtol(optarg, NULL, 0); break;
+        case 'r': q.reg = strtol(optarg, NULL, 0); break;
+        case 's': q.since = time(NULL) - strtoul(optarg, NULL, 0); break;
+        case 'R':
+            q.flags_mask |= COLUMN_STORE_READ;
+            q.flags_value |= COLUMN_STORE_READ;
+            break;
+        case 'W':
+            q.flags_mask |= COLUMN_STORE_READ;
+            q.flags_value &= ~COLUMN_STORE_READ;
+            break;
+        case 'i':
+            q.flags_mask |= COLUMN_STORE_AFTER_INVALID;
+            q.flags_value |= COLUMN_STORE_AFTER_INVALID;
+            break;
+        case 'f': q.failures = true; break;
+        case 'c': count_only = true; break;
+        case 'p': percentile = strtod(optarg, NULL); break;
+        case 'm': max_rows = strtoul(optarg, NULL, 0); break;
+        case 'g': output = optarg; break;
+        case 'n': rows = strtoul(optarg, NULL, 0); break;
+        case 'B': boards = strtoul(optarg, NULL, 0); break;
+        case 'd': days = strtoul(optarg, NULL, 0); break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (output)
+        return boards ? generate(output, rows, boards, days) : 1;
+
+    if (optind != argc - 1 || percentile < 0 || percentile > 100) {
+        fprintf(stderr, "usage: %s store [-b board] [-t test] [-r register] [-s seconds] [-R | -W] [-i] [-f]\n"
+                        "                 [-c | -p percentile | -m max_rows]\n"
+                        "       %s -g store [-n rows] [-B boards] [-d days]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    return run_query(argv[optind], &q, count_only, percentile, max_rows);
+}
@@ -0,0 +1,265 @@
+#include "column_store.h"
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define FILE_HEADER_SIZE    (16)
+#define BLOCK_HEADER_SIZE   (16)
+
+static size_t padded(size_t size)
+{
+    return (size + 3) & ~(size_t)3;
+}
+
+/**
+ * @brief Size of a block of a given number of rows, header included.
+ */
+static size_t block_size(uint32_t rows)
+{
+    return BLOCK_HEADER_SIZE + 3 * 4 * (size_t)rows + padded(2 * (size_t)rows)
+           + 5 * padded(rows);
+}
+
+static void write_column(FILE *file, const void *data, size_t size)
+{
+    static const uint8_t zeros[4] = {0, 0, 0, 0};
+
+    fwrite(data, size, 1, file);
+    fwrite(zeros, padded(size) - size, 1, file);
+}
+
+/**
+ * @brief Write the rows buffered as one block.
+ */
+static void flush(struct column_store_writer *w)
+{
+    static uint32_t u32[COLUMN_STORE_BLOCK_ROWS];
+    static uint16_t u16[COLUMN_STORE_BLOCK_ROWS];
+    static uint8_t u8[COLUMN_STORE_BLOCK_ROWS];
+    const struct column_store_row *rows = w->rows;
+    unsigned int n = w->count;
+
+    if (n == 0)
+        return;
+
+    uint32_t header[4] = {n, rows[0].time, rows[0].time, 0};
+    for (unsigned int i = 0; i < n; ++i) {
+        if (rows[i].time < header[1])
+            header[1] = rows[i].time;
+        if (rows[i].time > header[2])
+            header[2] = rows[i].time;
+    }
+    fwrite(header, sizeof(header), 1, w->file);
+
+#define COLUMN(buf, field)                                  \
+    do {                                                    \
+        for (unsigned int i = 0; i < n; ++i)                \
+            buf[i] = rows[i].field;                         \
+        write_column(w->file, buf, n * sizeof(buf[0]));     \
+    } while (0)
+
+    COLUMN(u32, time);
+    COLUMN(u32, latency_us);
+    COLUMN(u32, iteration);
+    COLUMN(u16, board);
+    COLUMN(u8, test);
+    COLUMN(u8, reg);
+    COLUMN(u8, flags);
+    COLUMN(u8, expected);
+    COLUMN(u8, actual);
+#undef COLUMN
+
+    w->count = 0;
+}
+
+bool column_store_open(struct column_store_writer *w, const char *path)
+{
+    uint8_t header[FILE_HEADER_SIZE];
+
+    w->file = fopen(path, "a+b");
+    if (w->file == NULL)
+        return false;
+
+    fseek(w->file, 0, SEEK_END);
+    if (ftell(w->file) == 0) {
+        memset(header, 0, sizeof(header));
+        memcpy(header, "RATC", 4);
+        header[4] = COLUMN_STORE_VERSION;
+        uint32_t block_rows = COLUMN_STORE_BLOCK_ROWS;
+        memcpy(&header[8], &block_rows, 4);
+        fwrite(header, sizeof(header), 1, w->file);
+    } else {
+        fseek(w->file, 0, SEEK_SET);
+        if (fread(header, sizeof(header), 1, w->file) != 1 || memcmp(header, "RATC", 4) != 0
+        ||  header[4] != COLUMN_STORE_VERSION) {
+            fclose(w->file);
+            return false;
+        }
+        fseek(w->file, 0, SEEK_END);
+    }
+
+    w->rows = (struct column_store_row *)malloc(COLUMN_STORE_BLOCK_ROWS * sizeof(*w->rows));
+    w->count = 0;
+    return w->rows != NULL;
+}
+
+void column_store_append(struct column_store_writer *w, const struct column_store_row *row)
+{
+    w->rows[w->count++] = *row;
+    if (w->count == COLUMN_STORE_BLOCK_ROWS)
+        flush(w);
+}
+
+void column_store_close(struct column_store_writer *w)
+{
+    flush(w);
+    fclose(w->file);
+    free(w->rows);
+}
+
+bool column_store_map(struct column_store_reader *r, const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+
+    if (fd < 0 || fstat(fd, &st) < 0 || st.st_size < FILE_HEADER_SIZE) {
+        if (fd >= 0)
+            close(fd);
+        return false;
+    }
+
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED)
+        return false;
+
+    r->map = (const uint8_t *)map;
+    r->size = st.st_size;
+    r->offset = FILE_HEADER_SIZE;
+    if (memcmp(r->map, "RATC", 4) != 0 || r->map[4] != COLUMN_STORE_VERSION) {
+        column_store_unmap(r);
+        return false;
+    }
+
+    return true;
+}
+
+bool column_store_next(struct column_store_reader *r, struct column_store_block *b)
+{
+    if (r->size - r->offset < BLOCK_HEADER_SIZE)
+        return false;
+
+    const uint8_t *p = r->map + r->offset;
+    const uint32_t *header = (const uint32_t *)p;
+    uint32_t rows = header[0];
+    if (rows == 0 || rows > COLUMN_STORE_BLOCK_ROWS || r->size - r->offset < block_size(rows))
+        return false;
+
+    b->rows = rows;
+    b->min_time = header[1];
+    b->max_time = header[2];
+    p += BLOCK_HEADER_SIZE;
+    b->time = (const uint32_t *)p;
+    p += 4 * rows;
+    b->latency_us = (const uint32_t *)p;
+    p += 4 * rows;
+    b->iteration = (const uint32_t *)p;
+    p += 4 * rows;
+    b->board = (const uint16_t *)p;
+    p += padded(2 * rows);
+    b->test = p;
+    p += padded(rows);
+    b->reg = p;
+    p += padded(rows);
+    b->flags = p;
+    p += padded(rows);
+    b->expected = p;
+    p += padded(rows);
+    b->actual = p;
+
+    r->offset += block_size(rows);
+    return true;
+}
+
+void column_store_unmap(struct column_store_reader *r)
+{
+    munmap((void *)r->map, r->size);
+}
+
+void column_store_decoder_init(struct column_store_decoder *d)
+{
+    slave_model_init(&d->model, 0, 0);
+    d->last_us = 0;
+    d->started = false;
+    d->after_invalid = false;
+    d->test = 0;
+    d->iteration = 0;
+}
+
+void column_store_decoder_mark(struct column_store_decoder *d, uint8_t test, uint32_t iteration)
+{
+    d->test = test;
+    d->iteration = iteration;
+}
+
+int column_store_decode(struct column_store_decoder *d, const struct trace_entry *e,
+                        uint16_t board, uint32_t time, struct column_store_row *rows)
+{
+    int length = e->length < TRACE_DATA_MAX ? e->length : TRACE_DATA_MAX;
+    uint32_t latency = d->started ? e->timestamp_us - d->last_us : 0;
+    uint8_t flags = (d->after_invalid ? COLUMN_STORE_AFTER_INVALID : 0)
+                  | ((e->flags & TRACE_NACK) ? COLUMN_STORE_NACK : 0);
+    int first_reg;
+    int count;
+
+    d->last_us = e->timestamp_us;
+    d->started = true;
+
+    if (e->flags & TRACE_READ) {
+        char expected[TRACE_DATA_MAX] = {0};
+
+        first_reg = d->model.current_reg;
+        flags |= COLUMN_STORE_READ;
+        if (!(e->flags & TRACE_NACK))
+            slave_model_read(&d->model, expected, length, 0);
+        count = length;
+        for (int i = 0; i < count; ++i) {
+            rows[i].expected = expected[i];
+            rows[i].actual = e->data[i];
+        }
+    } else {
+        if (length == 0)
+            return 0;
+
+        first_reg = e->data[0];
+        if (!(e->flags & TRACE_NACK)) {
+            slave_model_write(&d->model, (const char *)e->data, length, 0);
+            if (length > 1)
+                d->after_invalid = first_reg >= SLAVE_MODEL_REGISTER_COUNT;
+        }
+        count = length - 1;
+        for (int i = 0; i < count; ++i)
+            rows[i].expected = rows[i].actual = e->data[i + 1];
+    }
+
+    for (int i = 0; i < count; ++i) {
+        struct column_store_row *r = &rows[i];
+        int reg = first_reg + i;
+        uint8_t mask = reg == 0 ? 0x0F : 0xFF;
+
+        r->time = time;
+        r->latency_us = latency;
+        r->iteration = d->iteration;
+        r->board = board;
+        r->test = d->test;
+        r->reg = reg > 255 ? 255 : reg;
+        r->flags = flags;
+        if (!(flags & COLUMN_STORE_NACK) && ((r->expected ^ r->actual) & mask))
+            r->flags |= COLUMN_STORE_MISMATCH;
+    }
+
+    return count;
+}
@@ -0,0 +1,152 @@
+/**
+ * Columnar store of the register accesses of many fixtures.
+ *
+ * Each row is one register access decoded from the transactions of a board:
+ * time, board, test, iteration, register, expected and actual value, latency
+ * and flags. Rows are stored in blocks of up to COLUMN_STORE_BLOCK_ROWS rows;
+ * inside a block, each column is a contiguous array so that a query only
+ * touches the columns it filters on. Each block also keeps the range of its
+ * time column, so that blocks outside a time window are skipped.
+ *
+ * File layout (little-endian, as the hosts it runs on):
+ *
+ *   header: "RATC", version (1), 3 reserved bytes, block_rows (4), 4 reserved bytes
+ *   block:  rows (4), min_time (4), max_time (4), 4 reserved bytes,
+ *           time (4 * rows), latency_us (4 * rows), iteration (4 * rows),
+ *           board (2 * rows), test, reg, flags, expected, actual (1 * rows each)
+ *
+ * Every column starts on a 4-byte boundary. New blocks are appended to an
+ * existing file, so a store can grow run after run. Queries map the file in
+ * memory.
+ */
+
+#ifndef COLUMN_STORE_H
+#define COLUMN_STORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "slave_model.h"
+#include "trace.h"
+
+#define COLUMN_STORE_VERSION        (1)
+#define COLUMN_STORE_BLOCK_ROWS     (65536)
+
+/* Row flags */
+#define COLUMN_STORE_READ           (0x01)  /* read access, write otherwise */
+#define COLUMN_STORE_NACK           (0x02)  /* transaction not acknowledged */
+#define COLUMN_STORE_MISMATCH       (0x04)  /* actual different from expected */
+#define COLUMN_STORE_AFTER_INVALID  (0x08)  /* last register written was 5-255 */
+
+struct column_store_row {
+    uint32_t time;                  /* seconds since the epoch */
+    uint32_t latency_us;            /* since the end of the previous transaction */
+    uint32_t iteration;
+    uint16_t board;
+    uint8_t test;
+    uint8_t reg;
+    uint8_t flags;
+    uint8_t expected;
+    uint8_t actual;
+};
+
+struct column_store_writer {
+    FILE *file;
+    struct column_store_row *rows;
+    unsigned int count;
+};
+
+/** Columns of one block, pointing into the mapped file */
+struct column_store_block {
+    uint32_t rows;
+    uint32_t min_time;
+    uint32_t max_time;
+    const uint32_t *time;
+    const uint32_t *latency_us;
+    const uint32_t *iteration;
+    const uint16_t *board;
+    const uint8_t *test;
+    const uint8_t *reg;
+    const uint8_t *flags;
+    const uint8_t *expected;
+    const uint8_t *actual;
+};
+
+struct column_store_reader {
+    const uint8_t *map;
+    size_t size;
+    size_t offset;
+};
+
+/** Turns the transactions of one board into rows */
+struct column_store_decoder {
+    struct slave_model model;
+    uint32_t last_us;
+    bool started;
+    bool after_invalid;
+    uint8_t test;
+    uint32_t iteration;
+};
+
+/**
+ * @brief Open a store for appending, create it if needed.
+ *
+ * @return False if the file cannot be opened or is not a store
+ */
+bool column_store_open(struct column_store_writer *w, const char *path);
+
+/**
+ * @brief Append a row.
+ */
+void column_store_append(struct column_store_writer *w, const struct column_store_row *row);
+
+/**
+ * @brief Write the last block and close the store.
+ */
+void column_store_close(struct column_store_writer *w);
+
+/**
+ * @brief Map a store in memory.
+ *
+ * @return False if the file cannot be mapped or is not a store
+ */
+bool column_store_map(struct column_store_reader *r, const char *path);
+
+/**
+ * @brief Get the next block of a mapped store.
+ *
+ * @return False at the end of the store or if the block is truncated
+ */
+bool column_store_next(struct column_store_reader *r, struct column_store_block *b);
+
+void column_store_unmap(struct column_store_reader *r);
+
+/**
+ * @brief Reset the decoder of a board, its registers are assumed to be 0.
+ */
+void column_store_decoder_init(struct column_store_decoder *d);
+
+/**
+ * @brief Set the test and iteration of the next rows.
+ */
+void column_store_decoder_mark(struct column_store_decoder *d, uint8_t test, uint32_t iteration);
+
+/**
+ * @brief Decode the register accesses of one transaction.
+ *
+ * Writes give one row per register written. Reads give one row per register
+ * read, the expected value being the one of the model of the firmware fed
+ * with the transactions of the board. A write setting only the register
+ * pointer gives no row.
+ *
+ * @param[in] d decoder of the board
+ * @param[in] e transaction
+ * @param[in] board board identifier
+ * @param[in] time time of the transaction in seconds since the epoch
+ * @param[out] rows at least TRACE_DATA_MAX rows
+ * @return Number of rows
+ */
+int column_store_decode(struct column_store_decoder *d, const struct trace_entry *e,
+                        uint16_t board, uint32_t time, struct column_store_row *rows);
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * Coroutine flavour of the register bus for the host simulations.
+ *
+ * Each simulated fixture is a coroutine (coro_task) which awaits the bus
+ * operations:
+ * @code
+ * static coro_task<bool> test(coro_bus &bus)
+ * {
+ *     char value;
+ *     if (!co_await bus.write_register(1, 0xA5)
+ *     ||  !co_await bus.read_register(1, &value))
+ *         co_return false;
+ *     co_return value == (char)0xA5;
+ * }
+ * @endcode
+ *
+ * A bus operation is performed on the slave model at once, then the
+ * coroutine sleeps for the time the transaction takes on the wire. The
+ * executor is single-threaded: it resumes the coroutines in the order of
+ * their wake-up time on a virtual clock, so thousands of sessions run on
+ * one core, deterministically.
+ *
+ * The transactions of a bus can be written to a replay log (see replay.h).
+ *
+ * Requires C++20.
+ */
+
+#ifndef CORO_BUS_H
+#define CORO_BUS_H
+
+#include <coroutine>
+#include <queue>
+#include <stdint.h>
+#include <stdio.h>
+#include <utility>
+#include <vector>
+#include "replay.h"
+#include "slave_model.h"
+
+/** 8-bit address of the simulated boards, as in main.cpp */
+#define CORO_BUS_ADDRESS    (0x3A)
+
+/**
+ * Coroutine returning a value of type T to the coroutine awaiting it.
+ *
+ * The coroutine starts when it is awaited or spawned on the executor, and
+ * resumes its caller when it completes (symmetric transfer, so that deep
+ * chains of awaits do not grow the stack).
+ */
+template <class T>
+class coro_task {
+public:
+    struct promise_type {
+        T value;
+        std::coroutine_handle<> continuation;
+
+        coro_task get_return_object()
+        {
+            return coro_task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct final_awaiter {
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept
+            {
+                std::coroutine_handle<> next = h.promise().continuation;
+                return next ? next : std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        final_awaiter final_suspend() noexcept { return {}; }
+        void return_value(T v) { value = v; }
+        void unhandled_exception() { throw; }
+    };
+
+    explicit coro_task(std::coroutine_handle<promise_type> h) : handle(h) {}
+    coro_task(coro_task &&other) : handle(std::exchange(other.handle, nullptr)) {}
+    coro_task(const coro_task &) = delete;
+    coro_task &operator=(const coro_task &) = delete;
+
+    ~coro_task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    bool await_ready() { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> caller)
+    {
+        handle.promise().continuation = caller;
+        return handle;
+    }
+
+    T await_resume() { return handle.promise().value; }
+
+    bool done() const { return handle.done(); }
+    T result() const { return handle.promise().value; }
+    std::coroutine_handle<promise_type> coroutine() const { return handle; }
+
+private:
+    std::coroutine_handle<promise_type> handle;
+};
+
+/**
+ * Single-threaded event loop on a virtual clock in nanoseconds.
+ */
+class coro_executor {
+public:
+    coro_executor() : now(0), sequence(0), resumed(0) {}
+
+    /**
+     * @brief Resume a coroutine at a given time.
+     *
+     * Coroutines waking up at the same time are resumed in the order they
+     * were scheduled.
+     */
+    void schedule(std::coroutine_handle<> h, uint64_t at_ns)
+    {
+        events.push(event{at_ns, sequence++, h});
+    }
+
+    /**
+     * @brief Start a task at a given time.
+     */
+    template <class T>
+    void spawn(coro_task<T> &task, uint64_t at_ns)
+    {
+        schedule(task.coroutine(), at_ns);
+    }
+
+    /**
+     * @brief Run until no coroutine is waiting.
+     */
+    void run()
+    {
+        while (!events.empty()) {
+            event e = events.top();
+            events.pop();
+            now = e.time_ns;
+            ++resumed;
+            e.handle.resume();
+        }
+    }
+
+    uint64_t now_ns() const { return now; }
+    uint64_t resumes() const { return resumed; }
+
+    /** Awaitable suspending the current coroutine for some time */
+    struct sleep_awaiter {
+        coro_executor &executor;
+        uint64_t duration_ns;
+
+        bool await_ready() { return false; }
+        void await_suspend(std::coroutine_handle<> h) { executor.schedule(h, executor.now + duration_ns); }
+        void await_resume() {}
+    };
+
+    sleep_awaiter sleep(uint64_t duration_ns) { return sleep_awaiter{*this, duration_ns}; }
+
+private:
+    struct event {
+        uint64_t time_ns;
+        uint64_t sequence;
+        std::coroutine_handle<> handle;
+
+        bool operator>(const event &other) const
+        {
+            return time_ns != other.time_ns ? time_ns > other.time_ns : sequence > other.sequence;
+        }
+    };
+
+    std::priority_queue<event, std::vector<event>, std::greater<event> > events;
+    uint64_t now;
+    uint64_t sequence;
+    uint64_t resumed;
+};
+
+/**
+ * Bus of one simulated fixture connected to one slave model.
+ */
+class coro_bus {
+public:
+    coro_bus(coro_executor &executor, int frequency)
+        : transactions(0), nacks(0), executor(executor), bit_time_ns(1000000000 / frequency),
+          log(NULL)
+    {
+        slave_model_init(&model, 0, 0);
+        for (int i = 0; i < SLAVE_MODEL_REGISTER_COUNT; ++i)
+            stuck_low[i] = 0;
+    }
+
+    /** Awaitable transaction, its result is 0 on ACK like mbed::I2C */
+    struct transaction_awaiter {
+        coro_bus &bus;
+        int ret;
+        int length;
+
+        bool await_ready() { return false; }
+
+        void await_suspend(std::coroutine_handle<> h)
+        {
+            bus.executor.schedule(h, bus.executor.now_ns() + bus.duration_ns(ret == 0 ? length : 0));
+        }
+
+        int await_resume() { return ret; }
+    };
+
+    /**
+     * @brief Write to the slave.
+     *
+     * @param[in] data bytes to send, data[0] is the register address
+     * @param[in] length number of bytes to send
+     */
+    transaction_awaiter write(const char *data, int length)
+    {
+        int ret = slave_model_write(&model, data, length, now_us());
+        for (int i = 0; i < SLAVE_MODEL_REGISTER_COUNT; ++i)
+            model.regs[i] &= ~stuck_low[i];
+        count(ret);
+        record(0, ret, data, length);
+        return transaction_awaiter{*this, ret, length};
+    }
+
+    /**
+     * @brief Read from the slave.
+     *
+     * @param[out] data buffer receiving the bytes
+     * @param[in] length number of bytes to read
+     */
+    transaction_awaiter read(char *data, int length)
+    {
+        int ret = slave_model_read(&model, data, length, now_us());
+        count(ret);
+        record(TRACE_READ, ret, data, length);
+        return transaction_awaiter{*this, ret, length};
+    }
+
+    /**
+     * @brief Write the transactions from now on to a replay log.
+     *
+     * @param[in] file log open for writing, NULL to stop
+     */
+    void record_to(FILE *file)
+    {
+        uint8_t header[REPLAY_HEADER_SIZE];
+
+        log = file;
+        if (log)
+            fwrite(header, replay_encode_header(header, &writer), 1, log);
+    }
+
+    coro_task<bool> write_register(char addr, char val)
+    {
+        char data[2] = {addr, val};
+
+        co_return co_await write(data, sizeof(data)) == 0;
+    }
+
+    coro_task<bool> read_register(char addr, char *val)
+    {
+        /* One await per statement: g++ 12 runs both operands of a && before
+         * suspending, and does not resume from an await in an if condition */
+        int ret = co_await write(&addr, 1);
+        if (ret != 0)
+            co_return false;
+        co_return co_await read(val, 1) == 0;
+    }
+
+    /**
+     * @brief Duration of a transaction: a start, the address byte, the data
+     * bytes and a stop. Each byte takes 9 bits including the acknowledge.
+     *
+     * @param[in] length data bytes acknowledged
+     */
+    uint64_t duration_ns(int length) const
+    {
+        return (uint64_t)((length + 1) * 9 + 2) * bit_time_ns;
+    }
+
+    struct slave_model model;
+    char stuck_low[SLAVE_MODEL_REGISTER_COUNT];     /* bits stuck at 0 */
+    unsigned long transactions;
+    unsigned long nacks;
+
+private:
+    unsigned int now_us() const
+    {
+        return executor.now_ns() / 1000;
+    }
+
+    void count(int ret)
+    {
+        ++transactions;
+        if (ret)
+            ++nacks;
+    }
+
+    /** Log a transaction with the time of its end */
+    void record(uint8_t flags, int ret, const char *data, int length)
+    {
+        if (log == NULL)
+            return;
+
+        uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+        uint32_t end_us = (executor.now_ns() + duration_ns(ret == 0 ? length : 0)) / 1000;
+        int n = replay_encode(buf, &writer, end_us, CORO_BUS_ADDRESS, flags | (ret ? TRACE_NACK : 0),
+                              (const uint8_t *)data, length);
+        fwrite(buf, n, 1, log);
+    }
+
+    coro_executor &executor;
+    uint64_t bit_time_ns;
+    FILE *log;
+    struct replay_writer writer;
+};
+
+#endif
@@ -0,0 +1,321 @@
+/**
+ * Run the tests on many simulated fixtures at once.
+ *
+ * Each fixture is a coroutine running the tests of main.cpp against its own
+ * slave model through coro_bus. All fixtures are multiplexed by one
+ * single-threaded executor on a virtual clock, so a whole production floor
+ * is simulated on one core. Fixtures start at random times within the first
+ * second. Some boards can be given a stuck bit to check that the tests catch
+ * it.
+ *
+ * The traffic of the first fixture can be written to a replay log with -w.
+ * The log is read back afterwards to check that the time between two
+ * transactions is the duration of the second one on the wire, the fixture
+ * starting each transaction when the previous one ends.
+ *
+ * usage: coro_sim [-n fixtures] [-f bus_frequency] [-x faulty_percent] [-s seed] [-w log]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include <memory>
+#include "coro_bus.h"
+#include "replay.h"
+
+#define TEST_WRITE_READ_REG_1_4_COUNT           (100)
+#define TEST_WRITE_READ_REG_0_COUNT             (10)
+#define TEST_WRITE_REG_READ_ALL_COUNT           (500)
+#define TEST_WRITE_INVALID_REG_READ_ALL_COUNT   (500)
+
+/** State of one fixture */
+struct session {
+    coro_bus bus;
+    uint32_t seed;
+    int failed_test;
+    uint64_t end_ns;
+
+    session(coro_executor &executor, int frequency, uint32_t seed)
+        : bus(executor, frequency), seed(seed), failed_test(0), end_ns(0) {}
+
+    /** Per-session PRNG (xorshift32) so that sessions do not depend on each other */
+    char rand()
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return seed >> 8;
+    }
+};
+
+static coro_task<bool> check_all_register(coro_bus &bus, const char *expected_values)
+{
+    for (int i = 0; i < 5; ++i) {
+        char value = 0;
+        if (!co_await bus.read_register(i, &value))
+            co_return false;
+
+        if (i == 0) {
+            if ((value & 0x0F) != (expected_values[i] & 0x0F))
+                co_return false;
+        } else {
+            if (value != expected_values[i])
+                co_return false;
+        }
+    }
+
+    co_return true;
+}
+
+static coro_task<bool> test_write_read_reg_1_4(session &s)
+{
+    for (int i = 0; i < TEST_WRITE_READ_REG_1_4_COUNT; ++i) {
+        char reg_address = ((unsigned char)s.rand() % 4) + 1;
+        char value = s.rand();
+
+        char value_received = 0;
+        if (!co_await s.bus.write_register(reg_address, value)
+        ||  !co_await s.bus.read_register(reg_address, &value_received))
+            co_return false;
+
+        if (value != value_received)
+            co_return false;
+    }
+
+    co_return true;
+}
+
+static coro_task<bool> test_write_read_reg_0(session &s)
+{
+    for (int i = 0; i < TEST_WRITE_READ_REG_0_COUNT; ++i) {
+        char value = s.rand();
+
+        char value_received = 0;
+        if (!co_await s.bus.write_register(0, value)
+        ||  !co_await s.bus.read_register(0, &value_received))
+            co_return false;
+
+        if ((value & 0x0F) != (value_received & 0x0F))
+            co_return false;
+    }
+
+    co_return true;
+}
+
+static coro_task<bool> test_write_reg_read_all(session &s)
+{
+    char regs[5] = {0, 0, 0, 0, 0};
+
+    for (int i = 0; i < 5; ++i)
+        if (!co_await s.bus.write_register(i, 0))
+            co_return false;
+
+    for (int i = 0; i < TEST_WRITE_REG_READ_ALL_COUNT; ++i) {
+        int reg_address = (unsigned char)s.rand() % 5;
+        regs[reg_address] = s.rand();
+
+        if (!co_await s.bus.write_register(reg_address, regs[reg_address]))
+            co_return false;
+
+        if (!co_await check_all_register(s.bus, regs))
+            co_return false;
+    }
+
+    co_return true;
+}
+
+static coro_task<bool> test_write_invalid_reg_read_all(session &s)
+{
+    char regs[5];
+
+    for (int i = 0; i < 5; ++i) {
+        regs[i] = s.rand();
+        if (!co_await s.bus.write_register(i, regs[i]))
+            co_return false;
+    }
+
+    for (int i = 0; i < TEST_WRITE_INVALID_REG_READ_ALL_COUNT; ++i) {
+        char reg_address = ((unsigned char)s.rand() % 250) + 5;
+        char value = s.rand();
+
+        if (!co_await s.bus.write_register(reg_address, value))
+            co_return false;
+
+        if (!co_await check_all_register(s.bus, regs))
+            co_return false;
+    }
+
+    co_return true;
+}
+
+/**
+ * @brief Run the tests in order like run_tests() and stop at the first
+ * failure.
+ */
+static coro_task<bool> run_tests(session &s, coro_executor &executor)
+{
+    typedef coro_task<bool> (*test_function)(session &);
+    static const test_function tests[] = {
+        test_write_read_reg_1_4,
+        test_write_read_reg_0,
+        test_write_reg_read_all,
+        test_write_invalid_reg_read_all,
+    };
+
+    for (unsigned int n = 0; n < sizeof(tests) / sizeof(tests[0]); ++n) {
+        if (!co_await tests[n](s)) {
+            s.failed_test = n + 1;
+            break;
+        }
+    }
+
+    s.end_ns = executor.now_ns();
+    co_return s.failed_test == 0;
+}
+
+/**
+ * @brief Check the delays of a replay log written by a bus.
+ *
+ * Both ends are rounded down to microseconds, so a delay may be 1 us off.
+ *
+ * @return False if the log is invalid or a delay differs
+ */
+static bool check_log(const char *path, const coro_bus &bus)
+{
+    std::vector<uint8_t> log;
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    uint8_t buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+        log.insert(log.end(), buf, buf + n);
+    fclose(file);
+
+    if (!replay_check_header(log.data(), log.size())) {
+        fprintf(stderr, "%s: invalid replay log\n", path);
+        return false;
+    }
+
+    unsigned long records = 0;
+    unsigned long wrong = 0;
+    for (uint32_t offset = REPLAY_HEADER_SIZE; offset < log.size(); ++records) {
+        struct replay_transaction t;
+        int size = replay_decode(&log[offset], log.size() - offset, &t);
+        if (size == 0) {
+            fprintf(stderr, "%s: invalid record %lu\n", path, records);
+            return false;
+        }
+        offset += size;
+        if (records == 0)
+            continue;
+
+        uint64_t expected_ns = bus.duration_ns((t.flags & TRACE_NACK) ? 0 : t.length);
+        uint64_t delta_ns = (uint64_t)t.delta_us * 1000;
+        if (delta_ns + 1000 <= expected_ns || delta_ns >= expected_ns + 1000) {
+            if (wrong++ == 0)
+                fprintf(stderr, "%s: record %lu ends %lu us after the previous one, expected %lu.%03lu us\n",
+                        path, records, (unsigned long)t.delta_us,
+                        (unsigned long)(expected_ns / 1000), (unsigned long)(expected_ns % 1000));
+        }
+    }
+
+    printf("replay log: %lu transactions, %lu with a wrong delay\n", records, wrong);
+    return wrong == 0;
+}
+
+int main(int argc, char **argv)
+{
+    int fixture_count = 1000;
+    int frequency = 400000;
+    int faulty_percent = 0;
+    unsigned int seed = 1;
+    const char *log_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:f:x:s:w:")) != -1) {
+        switch (opt) {
+        case 'n': fixture_count = strtoul(optarg, NULL, 0); break;
+        case 'f': frequency = strtoul(optarg, NULL, 0); break;
+        case 'x': faulty_percent = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        case 'w': log_path = optarg; break;
+        default:
+            fprintf(stderr, "usage: %s [-n fixtures] [-f bus_frequency] [-x faulty_percent] [-s seed] [-w log]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    if (fixture_count <= 0 || frequency <= 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    FILE *log = NULL;
+    if (log_path && (log = fopen(log_path, "wb")) == NULL) {
+        perror(log_path);
+        return 1;
+    }
+
+    srand(seed);
+    coro_executor executor;
+    std::vector<std::unique_ptr<session> > sessions;
+    std::vector<coro_task<bool> > tasks;
+    int faulty = 0;
+
+    sessions.reserve(fixture_count);
+    tasks.reserve(fixture_count);
+    for (int i = 0; i < fixture_count; ++i) {
+        sessions.emplace_back(new session(executor, frequency, rand() | 1));
+        if (rand() % 100 < faulty_percent) {
+            sessions[i]->bus.stuck_low[1 + rand() % 4] = 1 << (rand() % 8);
+            ++faulty;
+        }
+        if (i == 0 && log)
+            sessions[i]->bus.record_to(log);
+
+        tasks.push_back(run_tests(*sessions[i], executor));
+        executor.spawn(tasks[i], (uint64_t)(rand() % 1000000) * 1000);
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    executor.run();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (log) {
+        fclose(log);
+        if (!check_log(log_path, sessions[0]->bus))
+            return 1;
+    }
+
+    int passed = 0;
+    int failed_per_test[5] = {0, 0, 0, 0, 0};
+    unsigned long transactions = 0;
+    for (int i = 0; i < fixture_count; ++i) {
+        if (!tasks[i].done()) {
+            fprintf(stderr, "fixture %d did not complete\n", i);
+            return 1;
+        }
+        if (tasks[i].result())
+            ++passed;
+        else
+            ++failed_per_test[sessions[i]->failed_test];
+        transactions += sessions[i]->bus.transactions;
+    }
+
+    double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%d fixtures (%d faulty): %d passed, %d failed\n", fixture_count, faulty,
+           passed, fixture_count - passed);
+    for (int i = 1; i < 5; ++i)
+        if (failed_per_test[i])
+            printf("  test %d: %d failed\n", i, failed_per_test[i]);
+    printf("%lu transactions, %.3f s of bus time in %.3f s (%.0f transactions/s, %.0f resumes/s)\n",
+           transactions, executor.now_ns() / 1e9, wall, transactions / wall,
+           executor.resumes() / wall);
+
+    return 0;
+}
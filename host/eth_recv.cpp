@@ -0,0 +1,472 @@
+/**
+ * Receive the record streams sent by the fixtures over raw Ethernet.
+ *
+ * Frames are read either from a TAP interface (bridge it with the interface
+ * connected to the fixtures) or from a pcap capture. Lost frames are detected
+ * using the sequence number of each fixture.
+ *
+ * With -c, the register accesses are also appended to a columnar store (see
+ * column_store.h) for queries with col_query.
+ *
+ * With -l, the snapshots of the live counters (see counters.h) are shown as a
+ * table with one line per fixture, refreshed every second, instead of the
+ * records.
+ *
+ * To test the receiver without a fixture, -g writes a pcap capture of a
+ * synthetic stream encoded like the firmware does.
+ *
+ * usage: eth_recv [-q | -l] [-c store] -i tap_interface
+ *        eth_recv [-q | -l] [-c store] -r capture.pcap
+ *        eth_recv -g capture.pcap [-n transactions] [-d drop_every]
+ */
+
+#include <fcntl.h>
+#include <linux/if.h>
+#include <linux/if_tun.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "column_store.h"
+#include "counters.h"
+#include "record.h"
+#include "stream_frame.h"
+
+#define PCAP_MAGIC              (0xA1B2C3D4)
+#define PCAP_MAGIC_NS           (0xA1B23C4D)
+#define PCAP_LINKTYPE_ETHERNET  (1)
+
+/* Period of the counter snapshots of the synthetic stream */
+#define GENERATE_SNAPSHOT_PERIOD_US (250000)
+
+struct fixture_stats {
+    bool seen;
+    uint32_t next_sequence;
+    unsigned long frames;
+    unsigned long lost_frames;
+    unsigned long records;
+};
+
+static struct fixture_stats fixtures[256];
+static bool quiet;
+
+/* Last two snapshots of the live counters of each fixture */
+struct fixture_live {
+    int snapshots;
+    struct counters_snapshot last;
+    struct counters_snapshot previous;
+};
+
+static struct fixture_live live[256];
+static bool dashboard;
+static time_t dashboard_shown;
+
+/* Columnar store of the register accesses, if enabled */
+static struct column_store_writer store;
+static bool storing;
+static struct column_store_decoder decoders[256];
+
+static void store_record(uint8_t fixture, const struct record *r, uint32_t time)
+{
+    struct column_store_decoder *d = &decoders[fixture];
+    struct column_store_row rows[TRACE_DATA_MAX];
+
+    switch (r->type) {
+    case RECORD_ITERATION:
+        column_store_decoder_mark(d, r->iteration.test, r->iteration.iteration);
+        break;
+    case RECORD_TRACE: {
+        int n = column_store_decode(d, &r->trace.entry, fixture, time, rows);
+        for (int i = 0; i < n; ++i)
+            column_store_append(&store, &rows[i]);
+        break;
+    }
+    }
+}
+
+static void update_live(uint8_t fixture, const struct record_counters *c)
+{
+    struct fixture_live *l = &live[fixture];
+
+    l->previous = l->last;
+    l->last.timestamp_us = c->timestamp_us;
+    for (int i = 0; i < COUNTER_COUNT; ++i)
+        l->last.values[i] = i < c->count ? record_get_u32(&c->values[4 * i]) : 0;
+    ++l->snapshots;
+}
+
+/**
+ * @brief Show the rates between the last two snapshots of each fixture.
+ */
+static void show_dashboard(void)
+{
+    if (isatty(STDOUT_FILENO))
+        printf("\033[H\033[J");
+    printf("fixture test iteration  trans/s   bytes/s    nacks  retries  p50 us  p99 us  max us  bus kHz\n");
+
+    for (int i = 0; i < 256; ++i) {
+        const struct fixture_live *l = &live[i];
+        if (l->snapshots == 0)
+            continue;
+
+        const uint32_t *v = l->last.values;
+        double transactions = 0, bytes = 0;
+        uint32_t elapsed = l->last.timestamp_us - l->previous.timestamp_us;
+        if (l->snapshots > 1 && elapsed) {
+            transactions = (v[COUNTER_TRANSACTIONS] - l->previous.values[COUNTER_TRANSACTIONS])
+                           * 1e6 / elapsed;
+            bytes = (v[COUNTER_BYTES] - l->previous.values[COUNTER_BYTES]) * 1e6 / elapsed;
+        }
+
+        printf("%7d %4lu %9lu %8.0f %9.0f %8lu %8lu %7lu %7lu %7lu %8lu\n", i,
+               (unsigned long)v[COUNTER_TEST], (unsigned long)v[COUNTER_TEST_ITERATION],
+               transactions, bytes, (unsigned long)v[COUNTER_NACKS],
+               (unsigned long)v[COUNTER_RETRIES], (unsigned long)v[COUNTER_DURATION_P50_US],
+               (unsigned long)v[COUNTER_DURATION_P99_US], (unsigned long)v[COUNTER_DURATION_MAX_US],
+               (unsigned long)v[COUNTER_BUS_FREQUENCY] / 1000);
+    }
+    fflush(stdout);
+}
+
+static void print_record(uint8_t fixture, const struct record *r)
+{
+    if (quiet)
+        return;
+
+    switch (r->type) {
+    case RECORD_RESULT:
+        printf("fixture %u: test %u %s in %lu us\n", fixture, r->result.test,
+               r->result.passed ? "PASS" : "FAIL", (unsigned long)r->result.elapsed_us);
+        break;
+    case RECORD_ITERATION:
+        printf("fixture %u: test %u iteration %lu\n", fixture, r->iteration.test,
+               (unsigned long)r->iteration.iteration);
+        break;
+    case RECORD_TRACE: {
+        const struct trace_entry *e = &r->trace.entry;
+        printf("fixture %u: #%lu %lu us %c %02X", fixture, (unsigned long)r->trace.index,
+               (unsigned long)e->timestamp_us, (e->flags & TRACE_READ) ? 'R' : 'W', e->address);
+        for (int i = 0; i < e->length && i < TRACE_DATA_MAX; ++i)
+            printf(" %02X", e->data[i]);
+        printf("%s\n", (e->flags & TRACE_NACK) ? " NACK" : "");
+        break;
+    }
+    case RECORD_COUNTERS:
+        printf("fixture %u: counters at %lu us:", fixture, (unsigned long)r->counters.timestamp_us);
+        for (int i = 0; i < r->counters.count; ++i) {
+            const char *name = counters_name(i);
+            printf(" %s%s%lu", name ? name : "", name ? "=" : "",
+                   (unsigned long)record_get_u32(&r->counters.values[4 * i]));
+        }
+        printf("\n");
+        break;
+    default:
+        printf("fixture %u: unknown record type %u\n", fixture, r->type);
+        break;
+    }
+}
+
+static void handle_frame(const uint8_t *buf, int size, uint32_t time)
+{
+    struct stream_frame_info info;
+
+    if (!stream_frame_parse(buf, size, &info))
+        return;
+
+    struct fixture_stats *f = &fixtures[info.fixture];
+    if (!f->seen && storing)
+        column_store_decoder_init(&decoders[info.fixture]);
+    if (f->seen && info.sequence != f->next_sequence) {
+        fprintf(stderr, "fixture %u: lost %lu frames\n", info.fixture,
+                (unsigned long)(info.sequence - f->next_sequence));
+        f->lost_frames += info.sequence - f->next_sequence;
+    }
+    f->seen = true;
+    f->next_sequence = info.sequence + 1;
+    ++f->frames;
+
+    int offset = 0;
+    while (offset < info.records_length) {
+        struct record r;
+        int n = record_decode(&info.records[offset], info.records_length - offset, &r);
+        if (n == 0) {
+            fprintf(stderr, "fixture %u: invalid record in frame %lu\n",
+                    info.fixture, (unsigned long)info.sequence);
+            break;
+        }
+        if (dashboard && r.type == RECORD_COUNTERS) {
+            update_live(info.fixture, &r.counters);
+            if (::time(NULL) != dashboard_shown) {
+                dashboard_shown = ::time(NULL);
+                show_dashboard();
+            }
+        } else if (!dashboard) {
+            print_record(info.fixture, &r);
+        }
+        if (storing)
+            store_record(info.fixture, &r, time);
+        ++f->records;
+        offset += n;
+    }
+}
+
+static volatile sig_atomic_t stopping;
+
+static void stop(int sig)
+{
+    stopping = 1;
+}
+
+static int receive_tap(const char *name)
+{
+    struct ifreq ifr;
+    int fd = open("/dev/net/tun", O_RDWR);
+
+    if (fd < 0) {
+        perror("/dev/net/tun");
+        return 1;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    ifr.ifr_flags = IFF_TAP | IFF_NO_PI;
+    strncpy(ifr.ifr_name, name, IFNAMSIZ - 1);
+    if (ioctl(fd, TUNSETIFF, &ifr) < 0) {
+        perror("TUNSETIFF");
+        close(fd);
+        return 1;
+    }
+
+    /* Interrupt read() on Ctrl-C so that the store is closed */
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = stop;
+    sigaction(SIGINT, &sa, NULL);
+
+    while (!stopping) {
+        uint8_t buf[STREAM_FRAME_MAX_SIZE + 4];
+        ssize_t n = read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (!stopping)
+                perror("read");
+            break;
+        }
+        handle_frame(buf, n, ::time(NULL));
+        fflush(stdout);
+    }
+
+    close(fd);
+    return stopping ? 0 : 1;
+}
+
+static int receive_pcap(const char *path)
+{
+    FILE *file = fopen(path, "rb");
+    uint8_t header[24];
+
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    if (fread(header, sizeof(header), 1, file) != 1) {
+        fprintf(stderr, "%s: not a pcap file\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    uint32_t magic = record_get_u32(header);
+    if ((magic != PCAP_MAGIC && magic != PCAP_MAGIC_NS)
+    ||  record_get_u32(&header[20]) != PCAP_LINKTYPE_ETHERNET) {
+        fprintf(stderr, "%s: not a little-endian Ethernet pcap file\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    uint8_t packet_header[16];
+    static uint8_t buf[65536];
+    while (fread(packet_header, sizeof(packet_header), 1, file) == 1) {
+        uint32_t length = record_get_u32(&packet_header[8]);
+        if (length > sizeof(buf) || fread(buf, length, 1, file) != 1) {
+            fprintf(stderr, "%s: truncated capture\n", path);
+            break;
+        }
+        handle_frame(buf, length, record_get_u32(&packet_header[0]));
+    }
+
+    fclose(file);
+    return 0;
+}
+
+static void write_pcap_frame(FILE *file, const struct stream_frame *f, uint32_t timestamp_us)
+{
+    uint8_t header[16];
+
+    record_put_u32(&header[0], timestamp_us / 1000000);
+    record_put_u32(&header[4], timestamp_us % 1000000);
+    record_put_u32(&header[8], f->length);
+    record_put_u32(&header[12], f->length);
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(f->buf, f->length, 1, file);
+}
+
+/**
+ * @brief Append a record to the frame, write the frame if it is full.
+ */
+static void generate_record(FILE *file, struct stream_frame *frame, const uint8_t *record,
+                            int length, uint32_t now_us, unsigned long drop_every)
+{
+    if (!stream_frame_append(frame, record, length)) {
+        if (drop_every == 0 || (frame->sequence + 1) % drop_every != 0)
+            write_pcap_frame(file, frame, now_us);
+        stream_frame_next(frame);
+        stream_frame_append(frame, record, length);
+    }
+}
+
+/**
+ * @brief Write a synthetic stream, frames are dropped to exercise the loss
+ * detection.
+ */
+static int generate_pcap(const char *path, unsigned long transactions, unsigned long drop_every)
+{
+    static const uint8_t mac[STREAM_FRAME_MAC_SIZE] = {0x02, 0, 0, 0, 0, 1};
+    FILE *file = fopen(path, "wb");
+    uint8_t header[24];
+
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+
+    record_put_u32(&header[0], PCAP_MAGIC);
+    record_put_u16(&header[4], 2);
+    record_put_u16(&header[6], 4);
+    record_put_u32(&header[8], 0);
+    record_put_u32(&header[12], 0);
+    record_put_u32(&header[16], STREAM_FRAME_MAX_SIZE);
+    record_put_u32(&header[20], PCAP_LINKTYPE_ETHERNET);
+    fwrite(header, sizeof(header), 1, file);
+
+    static struct stream_frame frame;
+    stream_frame_init(&frame, mac, 1);
+
+    uint8_t record[RECORD_MAX_SIZE];
+    uint32_t now_us = 0;
+    uint32_t next_snapshot_us = GENERATE_SNAPSHOT_PERIOD_US;
+    counters_init();
+    counter_set(COUNTER_TEST, 1);
+    counter_set(COUNTER_BUS_FREQUENCY, 400000);
+    for (unsigned long i = 0; i <= transactions; ++i) {
+        int length;
+        if (i < transactions) {
+            if (i % 4 == 0) {
+                generate_record(file, &frame, record, record_encode_iteration(record, 1, i / 4),
+                                now_us, drop_every);
+                counter_add(COUNTER_ITERATIONS, 1);
+                counter_set(COUNTER_TEST_ITERATION, i / 4);
+            }
+            if (now_us >= next_snapshot_us) {
+                struct counters_snapshot s;
+                counters_snapshot(&s, now_us);
+                counters_summarize(&s);
+                generate_record(file, &frame, record,
+                                record_encode_counters(record, s.timestamp_us, s.values, COUNTER_COUNT),
+                                now_us, drop_every);
+                next_snapshot_us += GENERATE_SNAPSHOT_PERIOD_US;
+            }
+
+            char data[2] = {(char)(i % 5), (char)i};
+            struct trace_entry e;
+            e.timestamp_us = now_us += 75;
+            e.address = 0x3A;
+            e.flags = (i & 1) ? TRACE_READ : 0;
+            e.length = sizeof(data);
+            memcpy(e.data, data, sizeof(data));
+            length = record_encode_trace(record, i, &e);
+            counter_add(COUNTER_TRANSACTIONS, 1);
+            counter_add(COUNTER_BYTES, sizeof(data));
+            counters_add_duration(60 + i % 20);
+        } else {
+            length = record_encode_result(record, 1, true, now_us);
+        }
+
+        generate_record(file, &frame, record, length, now_us, drop_every);
+    }
+    if (drop_every == 0 || (frame.sequence + 1) % drop_every != 0)
+        write_pcap_frame(file, &frame, now_us);
+
+    fclose(file);
+    return 0;
+}
+
+static void print_stats(void)
+{
+    for (int i = 0; i < 256; ++i) {
+        const struct fixture_stats *f = &fixtures[i];
+        if (f->seen)
+            fprintf(stderr, "fixture %d: %lu frames, %lu records, %lu frames lost\n",
+                    i, f->frames, f->records, f->lost_frames);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *tap = NULL;
+    const char *input = NULL;
+    const char *output = NULL;
+    const char *store_path = NULL;
+    unsigned long transactions = 10000;
+    unsigned long drop_every = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "qli:r:g:n:d:c:")) != -1) {
+        switch (opt) {
+        case 'q': quiet = true; break;
+        case 'l': dashboard = true; break;
+        case 'c': store_path = optarg; break;
+        case 'i': tap = optarg; break;
+        case 'r': input = optarg; break;
+        case 'g': output = optarg; break;
+        case 'n': transactions = strtoul(optarg, NULL, 0); break;
+        case 'd': drop_every = strtoul(optarg, NULL, 0); break;
+        default:
+            tap = input = output = NULL;
+            break;
+        }
+    }
+
+    if (store_path && !(input || tap)) {
+        tap = input = output = NULL;
+    } else if (store_path) {
+        if (!column_store_open(&store, store_path)) {
+            fprintf(stderr, "%s: cannot open store\n", store_path);
+            return 1;
+        }
+        storing = true;
+    }
+
+    int ret;
+    if (output)
+        return generate_pcap(output, transactions, drop_every);
+    else if (input)
+        ret = receive_pcap(input);
+    else if (tap)
+        ret = receive_tap(tap);
+    else {
+        fprintf(stderr, "usage: %s [-q | -l] [-c store] -i tap_interface\n"
+                        "       %s [-q | -l] [-c store] -r capture.pcap\n"
+                        "       %s -g capture.pcap [-n transactions] [-d drop_every]\n",
+                argv[0], argv[0], argv[0]);
+        return 1;
+    }
+
+    if (storing)
+        column_store_close(&store);
+    if (dashboard)
+        show_dashboard();
+    print_stats();
+    return ret;
+}
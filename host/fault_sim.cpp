@@ -0,0 +1,265 @@
+/**
+ * Mass fault simulation using the bit-sliced model.
+ *
+ * Each batch simulates SLICED_MODEL_BOARDS boards starting from random
+ * register values. Board 0 is fault-free, every other board gets one random
+ * fault. The same random sequence of test transactions, shaped like the tests
+ * of main.cpp, is run against all boards and compared against a fault-free
+ * copy of the model. The report gives, for each kind of fault, how many were
+ * detected and how many transactions it took.
+ *
+ * Board 0 is also checked against the scalar model after every read so that
+ * both models cannot diverge.
+ *
+ * usage: fault_sim [-b batches] [-n steps] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "sliced_model.h"
+
+#define REGISTER_COUNT      SLAVE_MODEL_REGISTER_COUNT
+#define MAX_READ_LENGTH     (10)
+
+enum fault_kind {
+    FAULT_NONE,
+    FAULT_STUCK0,
+    FAULT_STUCK1,
+    FAULT_IGNORE_WRITE,
+    FAULT_NO_INCREMENT,
+    FAULT_REG0_UPPER_WRITABLE,
+    FAULT_ADDRESS_ALIAS,
+    FAULT_KIND_COUNT
+};
+
+static const char *fault_names[FAULT_KIND_COUNT] = {
+    "none",
+    "stuck-at-0 bit",
+    "stuck-at-1 bit",
+    "ignored write",
+    "no auto-increment",
+    "reg0 upper half writable",
+    "address aliasing",
+};
+
+struct fault_stats {
+    unsigned long injected;
+    unsigned long detected;
+    unsigned long long latency;     /* sum of transactions before detection */
+};
+
+struct batch {
+    struct sliced_model dut;
+    struct sliced_model golden;
+    struct slave_model scalar;      /* reference for board 0 */
+    enum fault_kind kinds[SLICED_MODEL_BOARDS];
+    sliced_word detected;
+    unsigned long detected_at[SLICED_MODEL_BOARDS];
+    unsigned long transactions;
+};
+
+static void inject_fault(struct sliced_faults *f, int board, enum fault_kind kind)
+{
+    sliced_word bit = (sliced_word)1 << board;
+    int reg = rand() % REGISTER_COUNT;
+
+    switch (kind) {
+    case FAULT_STUCK0: f->stuck0[reg][rand() % 8] |= bit; break;
+    case FAULT_STUCK1: f->stuck1[reg][rand() % 8] |= bit; break;
+    case FAULT_IGNORE_WRITE: f->ignore_write[reg] |= bit; break;
+    case FAULT_NO_INCREMENT: f->no_increment |= bit; break;
+    case FAULT_REG0_UPPER_WRITABLE: f->reg0_upper_writable |= bit; break;
+    case FAULT_ADDRESS_ALIAS: f->address_alias |= bit; break;
+    default: break;
+    }
+}
+
+static void batch_write(struct batch *batch, const char *data, int length)
+{
+    sliced_model_write(&batch->dut, data, length);
+    sliced_model_write(&batch->golden, data, length);
+    slave_model_write(&batch->scalar, data, length, 0);
+    ++batch->transactions;
+}
+
+/**
+ * @brief Read from all boards and record the boards that differ.
+ *
+ * Only the lower half of register 0 is compared, like the tests do.
+ */
+static void batch_read(struct batch *batch, int length)
+{
+    sliced_word actual[MAX_READ_LENGTH * 8];
+    sliced_word expected[MAX_READ_LENGTH * 8];
+    char masks[MAX_READ_LENGTH];
+    char scalar[MAX_READ_LENGTH];
+
+    /* The golden model has no fault: all boards share its current register */
+    int reg = 0;
+    while (reg < REGISTER_COUNT && !batch->golden.current[reg])
+        ++reg;
+    for (int i = 0; i < length; ++i)
+        masks[i] = reg + i == 0 ? 0x0F : 0xFF;
+
+    sliced_model_read(&batch->dut, actual, length);
+    sliced_model_read(&batch->golden, expected, length);
+    slave_model_read(&batch->scalar, scalar, length, 0);
+    ++batch->transactions;
+
+    for (int i = 0; i < length; ++i) {
+        if (sliced_model_byte(&actual[i * 8], 0) != scalar[i]) {
+            fprintf(stderr, "sliced and scalar models differ\n");
+            exit(2);
+        }
+    }
+
+    sliced_word mismatch = sliced_model_compare(actual, expected, masks, length);
+    sliced_word fresh = mismatch & ~batch->detected;
+    for (int board = 0; fresh; ++board, fresh >>= 1)
+        if (fresh & 1)
+            batch->detected_at[board] = batch->transactions;
+    batch->detected |= mismatch;
+}
+
+static void read_all(struct batch *batch)
+{
+    for (int r = 0; r < REGISTER_COUNT; ++r) {
+        char addr = r;
+        batch_write(batch, &addr, 1);
+        batch_read(batch, 1);
+    }
+}
+
+/**
+ * @brief Run one step shaped like one iteration of a test of main.cpp.
+ */
+static void run_step(struct batch *batch)
+{
+    char data[11];
+
+    switch (rand() % 6) {
+    case 0:     /* write/read registers 1-4 */
+        data[0] = (rand() % 4) + 1;
+        data[1] = rand();
+        batch_write(batch, data, 2);
+        batch_write(batch, data, 1);
+        batch_read(batch, 1);
+        break;
+    case 1:     /* write reg/read all */
+        data[0] = rand() % REGISTER_COUNT;
+        data[1] = rand();
+        batch_write(batch, data, 2);
+        read_all(batch);
+        break;
+    case 2:     /* write invalid reg/read all */
+        data[0] = (rand() % 250) + 5;
+        data[1] = rand();
+        batch_write(batch, data, 2);
+        read_all(batch);
+        break;
+    case 3:     /* write invalid reg/read zero */
+        data[0] = (rand() % 250) + 5;
+        data[1] = rand();
+        batch_write(batch, data, 2);
+        batch_read(batch, 1);
+        break;
+    case 4:     /* write reg/multiple read */
+        data[0] = 0;
+        batch_write(batch, data, 1);
+        batch_read(batch, MAX_READ_LENGTH);
+        break;
+    case 5:     /* write multiple reg/read */
+        data[0] = 0;
+        for (int i = 1; i < 11; ++i)
+            data[i] = i < 6 ? rand() : 0;
+        batch_write(batch, data, sizeof(data));
+        read_all(batch);
+        break;
+    }
+}
+
+static void run_batch(struct batch *batch, int steps, struct fault_stats *stats)
+{
+    sliced_model_init(&batch->dut);
+    sliced_model_init(&batch->golden);
+    slave_model_init(&batch->scalar, 0, 0);
+    batch->detected = 0;
+    batch->transactions = 0;
+
+    for (int board = 0; board < SLICED_MODEL_BOARDS; ++board) {
+        char regs[REGISTER_COUNT];
+        for (int r = 0; r < REGISTER_COUNT; ++r)
+            regs[r] = rand();
+        sliced_model_load(&batch->dut, board, regs);
+        sliced_model_load(&batch->golden, board, regs);
+        if (board == 0) {
+            memcpy(batch->scalar.regs, regs, sizeof(regs));
+            batch->scalar.regs[0] &= 0x0F;
+        }
+
+        batch->kinds[board] = board == 0 ? FAULT_NONE
+                            : (enum fault_kind)(1 + rand() % (FAULT_KIND_COUNT - 1));
+        inject_fault(&batch->dut.faults, board, batch->kinds[board]);
+    }
+
+    for (int i = 0; i < steps; ++i)
+        run_step(batch);
+
+    for (int board = 0; board < SLICED_MODEL_BOARDS; ++board) {
+        struct fault_stats *s = &stats[batch->kinds[board]];
+        ++s->injected;
+        if (batch->detected & ((sliced_word)1 << board)) {
+            ++s->detected;
+            s->latency += batch->detected_at[board];
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long batches = 1000;
+    int steps = 200;
+    unsigned int seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "b:n:s:")) != -1) {
+        switch (opt) {
+        case 'b': batches = strtoul(optarg, NULL, 0); break;
+        case 'n': steps = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-b batches] [-n steps] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(seed);
+
+    static struct batch batch;
+    struct fault_stats stats[FAULT_KIND_COUNT];
+    unsigned long long transactions = 0;
+    memset(stats, 0, sizeof(stats));
+
+    clock_t start = clock();
+    for (unsigned long i = 0; i < batches; ++i) {
+        run_batch(&batch, steps, stats);
+        transactions += batch.transactions;
+    }
+    double elapsed = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+    printf("%-26s %10s %10s %8s %14s\n", "fault", "injected", "detected", "ratio", "mean latency");
+    for (int k = 0; k < FAULT_KIND_COUNT; ++k) {
+        const struct fault_stats *s = &stats[k];
+        printf("%-26s %10lu %10lu %7.1f%% %14.1f\n", fault_names[k], s->injected, s->detected,
+               s->injected ? 100.0 * s->detected / s->injected : 0.0,
+               s->detected ? (double)s->latency / s->detected : 0.0);
+    }
+    printf("%lu boards, %llu transactions per board, %.2f s, %.3g board-transactions/s\n",
+           batches * SLICED_MODEL_BOARDS, transactions / (batches ? batches : 1), elapsed,
+           elapsed > 0 ? transactions * SLICED_MODEL_BOARDS / elapsed : 0.0);
+
+    return stats[FAULT_NONE].detected == 0 ? 0 : 1;
+}
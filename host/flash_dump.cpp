@@ -0,0 +1,330 @@
+/**
+ * Decode a trace store read back from the SPI NOR flash of a fixture.
+ *
+ * The whole log is printed, or only one iteration of a test: the index is
+ * used to find the first page of the iteration without scanning the log.
+ *
+ * -r also writes the transactions printed to a replay log (see replay.h), to
+ * run the traffic of a failing iteration again with the REPLAY option of
+ * main.cpp or host/replay_sim. -c appends the register accesses to a columnar
+ * store (see column_store.h), -b giving the board identifier.
+ *
+ * To test the decoder without a fixture, -g writes an image produced by the
+ * firmware code running against a simulated flash.
+ *
+ * usage: flash_dump image [-t test -n iteration] [-r log] [-c store [-b board]]
+ *        flash_dump -g image [-n transactions]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "column_store.h"
+#include "flash_log.h"
+#include "record.h"
+#include "replay.h"
+#include "trace.h"
+
+#define IMAGE_SIZE      (1024 * 1024)
+
+static uint8_t image[IMAGE_SIZE];
+static uint32_t image_size;
+
+/* Replay log of the transactions printed */
+static FILE *replay_log;
+static struct replay_writer replay_writer;
+
+/* Columnar store of the register accesses printed */
+static struct column_store_writer store;
+static bool storing;
+static struct column_store_decoder store_decoder;
+static uint16_t store_board;
+static uint32_t store_time;
+
+static void store_record(const struct record *r)
+{
+    struct column_store_row rows[TRACE_DATA_MAX];
+
+    if (r->type == RECORD_ITERATION) {
+        column_store_decoder_mark(&store_decoder, r->iteration.test, r->iteration.iteration);
+    } else if (r->type == RECORD_TRACE) {
+        int n = column_store_decode(&store_decoder, &r->trace.entry, store_board, store_time, rows);
+        for (int i = 0; i < n; ++i)
+            column_store_append(&store, &rows[i]);
+    }
+}
+
+/* Simulated flash */
+static bool write_enabled;
+static int busy_polls;
+
+static void sim_transfer(const uint8_t *cmd, int cmd_length, const uint8_t *tx, int tx_length,
+                         uint8_t *rx, int rx_length)
+{
+    uint32_t address = cmd_length >= 4 ? (cmd[1] << 16) | (cmd[2] << 8) | cmd[3] : 0;
+
+    switch (cmd[0]) {
+    case 0x9F:
+        rx[0] = 0xEF;
+        rx[1] = 0x40;
+        rx[2] = 0x15;
+        break;
+    case 0x06:
+        write_enabled = true;
+        break;
+    case 0x05:
+        rx[0] = busy_polls ? 0x01 : 0x00;
+        if (busy_polls)
+            --busy_polls;
+        break;
+    case 0x02:
+        if (!write_enabled || busy_polls) {
+            fprintf(stderr, "program at %06X while not ready\n", address);
+            break;
+        }
+        /* Programming only clears bits and wraps around in the page */
+        for (int i = 0; i < tx_length; ++i) {
+            uint32_t a = (address & ~(FLASH_LOG_PAGE_SIZE - 1))
+                       | ((address + i) & (FLASH_LOG_PAGE_SIZE - 1));
+            image[a] &= tx[i];
+        }
+        write_enabled = false;
+        busy_polls = 2;
+        break;
+    case 0xD8:
+        memset(&image[address & ~(FLASH_LOG_BLOCK_SIZE - 1)], 0xFF, FLASH_LOG_BLOCK_SIZE);
+        write_enabled = false;
+        busy_polls = 10;
+        break;
+    }
+}
+
+static const struct flash_log_ops sim_ops = {
+    sim_transfer
+};
+
+static int generate(const char *path, unsigned long transactions)
+{
+    if (!flash_log_init(&sim_ops, IMAGE_SIZE)) {
+        fprintf(stderr, "flash not found\n");
+        return 1;
+    }
+
+    uint32_t now_us = 0;
+    unsigned long done = 0;
+    for (int test = 1; test <= 5 && done < transactions; ++test) {
+        for (uint32_t i = 0; i < 100 && done < transactions; ++i) {
+            flash_log_mark(test, i);
+            for (int j = 0; j < 4; ++j, ++done) {
+                char data[2] = {(char)(j + 1), (char)(i + j)};
+                trace_record(now_us += 75, 0x3A, (j & 1) ? TRACE_READ : 0, data, sizeof(data));
+                flash_log_trace();
+            }
+        }
+
+        uint8_t record[RECORD_MAX_SIZE];
+        flash_log_write(record, record_encode_result(record, test, true, now_us));
+        flash_log_sync();
+    }
+    fprintf(stderr, "%lu records dropped\n", (unsigned long)flash_log_dropped());
+
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    fwrite(image, IMAGE_SIZE, 1, file);
+    fclose(file);
+
+    return 0;
+}
+
+static void print_record(const struct record *r)
+{
+    switch (r->type) {
+    case RECORD_RESULT:
+        printf("test %u %s in %lu us\n", r->result.test,
+               r->result.passed ? "PASS" : "FAIL", (unsigned long)r->result.elapsed_us);
+        break;
+    case RECORD_ITERATION:
+        printf("test %u iteration %lu\n", r->iteration.test,
+               (unsigned long)r->iteration.iteration);
+        break;
+    case RECORD_TRACE: {
+        const struct trace_entry *e = &r->trace.entry;
+        printf("  #%lu %lu us %c %02X", (unsigned long)r->trace.index,
+               (unsigned long)e->timestamp_us, (e->flags & TRACE_READ) ? 'R' : 'W', e->address);
+        for (int i = 0; i < e->length && i < TRACE_DATA_MAX; ++i)
+            printf(" %02X", e->data[i]);
+        printf("%s\n", (e->flags & TRACE_NACK) ? " NACK" : "");
+        break;
+    }
+    default:
+        printf("unknown record type %u\n", r->type);
+        break;
+    }
+}
+
+/**
+ * @brief Print the records of the log starting from a page.
+ *
+ * If test is not 0, printing starts at the marker of the iteration and stops
+ * at the next marker.
+ */
+static int dump(uint32_t first_page, uint32_t page_count, int test, uint32_t iteration)
+{
+    bool printing = test == 0;
+
+    for (uint32_t page = first_page; page < page_count; ++page) {
+        const uint8_t *p = &image[page * FLASH_LOG_PAGE_SIZE];
+        if (p[0] != 'L' || record_get_u32(&p[4]) != page)
+            break;
+
+        int used = record_get_u16(&p[2]);
+        if (used > FLASH_LOG_PAGE_SIZE) {
+            fprintf(stderr, "page %lu: invalid header\n", (unsigned long)page);
+            return 1;
+        }
+
+        for (int offset = FLASH_LOG_PAGE_HEADER_SIZE; offset < used; ) {
+            struct record r;
+            int n = record_decode(&p[offset], used - offset, &r);
+            if (n == 0) {
+                fprintf(stderr, "page %lu: invalid record\n", (unsigned long)page);
+                return 1;
+            }
+            offset += n;
+
+            if (test && r.type == RECORD_ITERATION) {
+                if (printing)
+                    return 0;
+                printing = r.iteration.test == test && r.iteration.iteration == iteration;
+            }
+            if (!printing)
+                continue;
+
+            print_record(&r);
+            if (storing)
+                store_record(&r);
+            if (replay_log && r.type == RECORD_TRACE) {
+                uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+                fwrite(buf, replay_encode_trace(buf, &replay_writer, &r.trace.entry), 1, replay_log);
+            }
+        }
+    }
+
+    return test && !printing;
+}
+
+static int decode(const char *path, int test, uint32_t iteration)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL) {
+        perror(path);
+        return 1;
+    }
+    image_size = fread(image, 1, IMAGE_SIZE, file);
+    fclose(file);
+
+    if (image_size < FLASH_LOG_SUPERBLOCK_SIZE || memcmp(image, "RATL", 4) != 0
+    ||  image[4] != FLASH_LOG_VERSION) {
+        fprintf(stderr, "%s: no trace store found\n", path);
+        return 1;
+    }
+
+    uint32_t page_count = record_get_u32(&image[8]);
+    uint32_t first_page = record_get_u32(&image[12]);
+    if (page_count > image_size / FLASH_LOG_PAGE_SIZE) {
+        fprintf(stderr, "%s: image truncated, %lu pages expected\n", path, (unsigned long)page_count);
+        page_count = image_size / FLASH_LOG_PAGE_SIZE;
+    }
+    fprintf(stderr, "%lu pages, log starts at page %lu\n",
+            (unsigned long)page_count, (unsigned long)first_page);
+
+    /* Seek to the last index entry before the iteration */
+    uint32_t start = first_page;
+    if (test) {
+        const uint8_t *index = &image[FLASH_LOG_PAGE_SIZE];
+        int entries = (first_page - 1) * FLASH_LOG_PAGE_SIZE / FLASH_LOG_INDEX_ENTRY_SIZE;
+        for (int i = 0; i < entries; ++i) {
+            struct flash_log_index_entry e;
+            if (!flash_log_decode_index(&index[i * FLASH_LOG_INDEX_ENTRY_SIZE], &e))
+                break;
+            if (e.test > test || (e.test == test && e.iteration > iteration))
+                break;
+            start = e.page;
+        }
+        fprintf(stderr, "seeking to page %lu\n", (unsigned long)start);
+    }
+
+    if (dump(start, page_count, test, iteration)) {
+        fprintf(stderr, "test %d iteration %lu not found\n", test, (unsigned long)iteration);
+        return 1;
+    }
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    const char *output = NULL;
+    const char *replay_path = NULL;
+    const char *store_path = NULL;
+    unsigned long transactions = 2000;
+    int test = 0;
+    uint32_t iteration = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "g:t:n:r:c:b:")) != -1) {
+        switch (opt) {
+        case 'g': output = optarg; break;
+        case 'r': replay_path = optarg; break;
+        case 'c': store_path = optarg; break;
+        case 'b': store_board = strtoul(optarg, NULL, 0); break;
+        case 't': test = strtoul(optarg, NULL, 0); break;
+        case 'n': transactions = iteration = strtoul(optarg, NULL, 0); break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (output)
+        return generate(output, transactions);
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s image [-t test -n iteration] [-r log] [-c store [-b board]]\n"
+                        "       %s -g image [-n transactions]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    if (replay_path) {
+        uint8_t header[REPLAY_HEADER_SIZE];
+        if ((replay_log = fopen(replay_path, "wb")) == NULL) {
+            perror(replay_path);
+            return 1;
+        }
+        fwrite(header, replay_encode_header(header, &replay_writer), 1, replay_log);
+    }
+
+    if (store_path) {
+        if (!column_store_open(&store, store_path)) {
+            fprintf(stderr, "%s: cannot open store\n", store_path);
+            return 1;
+        }
+        column_store_decoder_init(&store_decoder);
+        store_time = time(NULL);
+        storing = true;
+    }
+
+    int ret = decode(argv[optind], test, iteration);
+    if (replay_log)
+        fclose(replay_log);
+    if (storing)
+        column_store_close(&store);
+
+    return ret;
+}
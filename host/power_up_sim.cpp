@@ -0,0 +1,110 @@
+/**
+ * Run the power-up benchmark against the slave model.
+ *
+ * Time is simulated: each transaction advances the clock by its duration on
+ * the bus, so the benchmark runs much faster than real time. The boot delay
+ * of the model varies from one cycle to the next within the jitter given on
+ * the command line to produce a distribution.
+ *
+ * usage: power_up_sim [-n cycles] [-b boot_delay_us] [-i init_delay_us]
+ *                     [-j jitter_us] [-f bus_frequency] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "power_up.h"
+#include "slave_model.h"
+
+static struct slave_model model;
+static uint32_t now_us;
+static uint32_t bit_time_ns = 2500;     /* 400 kHz */
+static uint32_t boot_delay_us = 2000;
+static uint32_t init_delay_us = 5000;
+static uint32_t jitter_us = 1000;
+
+/**
+ * @brief Advance the clock by the duration of a transaction.
+ *
+ * A transaction is made of a start, the address byte, the data bytes and a
+ * stop. Each byte takes 9 bits including the acknowledge.
+ */
+static void advance_transaction(int length)
+{
+    now_us += ((length + 1) * 9 + 2) * bit_time_ns / 1000;
+}
+
+static void sim_power(bool on)
+{
+    if (on) {
+        uint32_t jitter = jitter_us ? rand() % jitter_us : 0;
+        model.boot_delay_us = boot_delay_us + jitter;
+        model.init_delay_us = init_delay_us + jitter;
+    }
+    slave_model_power(&model, on, now_us);
+}
+
+static int sim_write(const char *data, int length)
+{
+    int ret = slave_model_write(&model, data, length, now_us);
+    advance_transaction(ret == 0 ? length : 0);
+    return ret;
+}
+
+static int sim_read(char *data, int length)
+{
+    int ret = slave_model_read(&model, data, length, now_us);
+    advance_transaction(ret == 0 ? length : 0);
+    return ret;
+}
+
+static uint32_t sim_time_us(void)
+{
+    return now_us;
+}
+
+static void sim_wait_us(uint32_t us)
+{
+    now_us += us;
+}
+
+int main(int argc, char **argv)
+{
+    struct power_up_config config = {1000, 100000, 50, 1000000, 500};
+    unsigned int seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:b:i:j:f:s:")) != -1) {
+        switch (opt) {
+        case 'n': config.cycles = strtoul(optarg, NULL, 0); break;
+        case 'b': boot_delay_us = strtoul(optarg, NULL, 0); break;
+        case 'i': init_delay_us = strtoul(optarg, NULL, 0); break;
+        case 'j': jitter_us = strtoul(optarg, NULL, 0); break;
+        case 'f': bit_time_ns = 1000000000UL / strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n cycles] [-b boot_delay_us] [-i init_delay_us] "
+                            "[-j jitter_us] [-f bus_frequency] [-s seed]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    srand(seed);
+    slave_model_init(&model, boot_delay_us, init_delay_us);
+
+    static const struct power_up_ops ops = {
+        sim_power,
+        sim_write,
+        sim_read,
+        sim_time_us,
+        sim_wait_us
+    };
+    struct power_up_result result;
+
+    printf("power-up benchmark: %u cycles, boot delay %u us, init delay %u us, jitter %u us\n",
+           config.cycles, boot_delay_us, init_delay_us, jitter_us);
+    bool ok = power_up_run(&ops, &config, &result);
+    power_up_print(&result);
+
+    return ok ? 0 : 1;
+}
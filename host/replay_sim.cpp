@@ -0,0 +1,129 @@
+/**
+ * Replay a transaction log (see replay.h) into the slave model.
+ *
+ * The log is mapped in memory and replayed as fast as possible, so that the
+ * traffic of a failing board can be checked against the model of the
+ * firmware. Transactions whose response differs from the log are printed.
+ * -l replays the log several times to measure the replay rate.
+ *
+ * usage: replay_sim [-l loops] [-m max_printed] log
+ */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "replay.h"
+#include "slave_model.h"
+
+#define SLAVE_ADDRESS   (0x3A)
+
+static struct slave_model model;
+static unsigned long printed;
+static unsigned long max_printed = 10;
+
+static int model_write(uint8_t address, const char *data, int length, uint32_t at_us)
+{
+    if (address != SLAVE_ADDRESS)
+        return 1;
+
+    return slave_model_write(&model, data, length, at_us);
+}
+
+static int model_read(uint8_t address, char *data, int length, uint32_t at_us)
+{
+    if (address != SLAVE_ADDRESS)
+        return 1;
+
+    return slave_model_read(&model, data, length, at_us);
+}
+
+static void print_mismatch(uint32_t index, const struct replay_transaction *t, int ret,
+                           const char *data)
+{
+    if (printed++ >= max_printed)
+        return;
+
+    printf("#%lu %c %02X:", (unsigned long)index, (t->flags & TRACE_READ) ? 'R' : 'W', t->address);
+    if (t->data)
+        for (int i = 0; i < t->length; ++i)
+            printf(" %02X", t->data[i]);
+    printf("%s, got%s", (t->flags & TRACE_NACK) ? " NACK" : "", ret ? " NACK" : "");
+    if (data && ret == 0)
+        for (int i = 0; i < t->length; ++i)
+            printf(" %02X", (unsigned char)data[i]);
+    printf("\n");
+}
+
+static const struct replay_ops model_ops = {
+    model_write,
+    model_read,
+    NULL,
+    print_mismatch,
+};
+
+int main(int argc, char **argv)
+{
+    unsigned long loops = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "l:m:")) != -1) {
+        switch (opt) {
+        case 'l': loops = strtoul(optarg, NULL, 0); break;
+        case 'm': max_printed = strtoul(optarg, NULL, 0); break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind != argc - 1 || loops == 0) {
+        fprintf(stderr, "usage: %s [-l loops] [-m max_printed] log\n", argv[0]);
+        return 1;
+    }
+
+    const char *path = argv[optind];
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) < 0) {
+        perror(path);
+        return 1;
+    }
+
+    const uint8_t *log = (const uint8_t *)mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (log == MAP_FAILED) {
+        perror(path);
+        return 1;
+    }
+    madvise((void *)log, st.st_size, MADV_SEQUENTIAL);
+
+    struct replay_stats stats;
+    unsigned long transactions = 0;
+    unsigned long mismatches = 0;
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned long i = 0; i < loops; ++i) {
+        slave_model_init(&model, 0, 0);
+        if (!replay_run(log, st.st_size, &model_ops, false, &stats)) {
+            fprintf(stderr, "%s: invalid log after %lu transactions\n", path,
+                    (unsigned long)stats.transactions);
+            return 1;
+        }
+        transactions += stats.transactions;
+        mismatches += stats.mismatches;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    double wall = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%lu transactions (%.3f s recorded), %lu mismatches\n", (unsigned long)stats.transactions,
+           stats.recorded_us / 1e6, mismatches / loops);
+    printf("%.0f bytes per transaction, %.0f transactions/s\n",
+           (double)(st.st_size - REPLAY_HEADER_SIZE) / stats.transactions, transactions / wall);
+
+    munmap((void *)log, st.st_size);
+    return mismatches != 0;
+}
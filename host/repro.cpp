@@ -0,0 +1,337 @@
+/**
+ * Reproduce a failure from the reproduction bundle of a fixture (see
+ * repro_bundle.h).
+ *
+ * With REPRO_BUNDLE, a fixture prints the bundle after a failure, as "repro:"
+ * lines. The input is the console log of the fixture (other lines are
+ * ignored), or the raw bundle with -b; -o writes the raw bundle.
+ *
+ * The transactions of the bundle start in the middle of a run, so the state
+ * of the slave at that point is rebuilt first:
+ *  - the transactions before the first write are skipped, the current
+ *    register of the slave being unknown,
+ *  - a register read before being written in the window is assumed to hold
+ *    the value first read,
+ *  - a write of registers 0-4 restores these values before the window.
+ *
+ * This replay log is run against the slave model, and the transactions whose
+ * response differs are printed with their number since boot. -r writes it to
+ * a file, to be replayed against a fresh board by the REPLAY mode of the
+ * firmware (copied as replay.bin on the USB drive of the mbed).
+ *
+ * The exit code is 0 if the model reproduces the failure.
+ *
+ * usage: repro [-b] [-m max_printed] [-o bundle] [-r log] input
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "replay.h"
+#include "repro_bundle.h"
+#include "slave_model.h"
+#include "trace.h"
+#include "trace_pack.h"
+
+#define LINE_PREFIX     "repro:"
+
+struct transaction {
+    uint32_t index;                 /* since boot */
+    struct trace_entry entry;
+};
+
+static struct slave_model model;
+static uint8_t slave_address;
+static std::vector<uint32_t> log_indexes;   /* transaction of each record of the replay log */
+static unsigned long printed;
+static unsigned long max_printed = 10;
+static uint32_t first_mismatch;
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief Read the bundle of a console log, or of a raw file.
+ */
+static bool load(const char *path, bool binary, std::vector<uint8_t> &bundle)
+{
+    FILE *file = fopen(path, binary ? "rb" : "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    if (binary) {
+        uint8_t buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+            bundle.insert(bundle.end(), buf, buf + n);
+    } else {
+        char line[4096];
+        while (fgets(line, sizeof(line), file)) {
+            const char *p = strstr(line, LINE_PREFIX);
+            if (p == NULL)
+                continue;
+            for (p += strlen(LINE_PREFIX); hex_value(p[0]) >= 0 && hex_value(p[1]) >= 0; p += 2)
+                bundle.push_back(hex_value(p[0]) << 4 | hex_value(p[1]));
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool unpack(const struct repro_bundle *b, std::vector<struct transaction> &transactions)
+{
+    uint32_t next_index = 0;
+
+    for (uint32_t offset = 0; offset < b->history_size; ) {
+        int size = trace_pack_block_size(&b->history[offset], b->history_size - offset);
+        struct trace_pack_decoder d;
+        if (!trace_pack_decoder_init(&d, &b->history[offset], size)) {
+            fprintf(stderr, "history truncated\n");
+            return false;
+        }
+        offset += size;
+
+        if (!transactions.empty() && d.index != next_index)
+            printf("%lu transactions missing before #%lu\n",
+                   (unsigned long)(d.index - next_index), (unsigned long)d.index);
+
+        struct transaction t;
+        while (trace_pack_next(&d, &t.index, &t.entry))
+            transactions.push_back(t);
+        next_index = d.index;
+        if (d.error) {
+            fprintf(stderr, "invalid history record\n");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Find the values of the registers at the first write of the window.
+ *
+ * The window is run on a copy of the model, registers being marked known
+ * when written; a read of a register not known yet adopts the value read.
+ *
+ * @param[out] regs values of registers 0-4, 0 if never read
+ * @return Position of the first write, transactions.size() if none
+ */
+static size_t initial_state(const std::vector<struct transaction> &transactions, char *regs)
+{
+    size_t start = 0;
+    while (start < transactions.size()
+       && ((transactions[start].entry.flags & (TRACE_READ | TRACE_NACK))
+           || transactions[start].entry.length == 0))
+        ++start;
+
+    struct slave_model shadow;
+    bool known[SLAVE_MODEL_REGISTER_COUNT] = {false};
+    slave_model_init(&shadow, 0, 0);
+    memset(regs, 0, SLAVE_MODEL_REGISTER_COUNT);
+
+    for (size_t i = start; i < transactions.size(); ++i) {
+        const struct trace_entry *e = &transactions[i].entry;
+        int length = e->length < TRACE_DATA_MAX ? e->length : TRACE_DATA_MAX;
+        if (e->flags & TRACE_NACK)
+            continue;
+
+        if (e->flags & TRACE_READ) {
+            char data[TRACE_DATA_MAX];
+            for (int n = 0; n < length; ++n) {
+                unsigned int reg = shadow.current_reg + n;
+                if (reg < SLAVE_MODEL_REGISTER_COUNT && !known[reg]) {
+                    regs[reg] = shadow.regs[reg] = e->data[n];
+                    known[reg] = true;
+                }
+            }
+            slave_model_read(&shadow, data, length, 0);
+        } else {
+            for (int n = 1; n < length; ++n)
+                if (e->data[0] + n - 1 < SLAVE_MODEL_REGISTER_COUNT)
+                    known[e->data[0] + n - 1] = true;
+            slave_model_write(&shadow, (const char *)e->data, length, 0);
+        }
+    }
+
+    return start;
+}
+
+/**
+ * @brief Write the replay log: the write restoring the registers, then the
+ * window from its first write.
+ */
+static void build_log(const std::vector<struct transaction> &transactions, std::vector<uint8_t> &log)
+{
+    uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+    struct replay_writer w;
+    char regs[SLAVE_MODEL_REGISTER_COUNT];
+    size_t start = initial_state(transactions, regs);
+
+    log.insert(log.end(), buf, buf + replay_encode_header(buf, &w));
+    if (start == transactions.size())
+        return;
+
+    uint8_t restore[1 + SLAVE_MODEL_REGISTER_COUNT] = {0};
+    memcpy(&restore[1], regs, SLAVE_MODEL_REGISTER_COUNT);
+    log.insert(log.end(), buf, buf + replay_encode(buf, &w, transactions[start].entry.timestamp_us,
+                                                   transactions[start].entry.address, 0, restore,
+                                                   sizeof(restore)));
+    log_indexes.push_back(transactions[start].index);
+
+    printf("state before #%lu:", (unsigned long)transactions[start].index);
+    for (int i = 0; i < SLAVE_MODEL_REGISTER_COUNT; ++i)
+        printf(" %02X", (unsigned char)regs[i]);
+    printf("\n");
+    if (start)
+        printf("%lu transactions before the first write skipped\n", (unsigned long)start);
+
+    for (size_t i = start; i < transactions.size(); ++i) {
+        log.insert(log.end(), buf, buf + replay_encode_trace(buf, &w, &transactions[i].entry));
+        log_indexes.push_back(transactions[i].index);
+    }
+}
+
+static int model_write(uint8_t address, const char *data, int length, uint32_t at_us)
+{
+    if (address != slave_address)
+        return 1;
+
+    return slave_model_write(&model, data, length, at_us);
+}
+
+static int model_read(uint8_t address, char *data, int length, uint32_t at_us)
+{
+    if (address != slave_address)
+        return 1;
+
+    return slave_model_read(&model, data, length, at_us);
+}
+
+static void print_mismatch(uint32_t index, const struct replay_transaction *t, int ret,
+                           const char *data)
+{
+    if (printed++ == 0)
+        first_mismatch = log_indexes[index];
+    if (printed > max_printed)
+        return;
+
+    printf("#%lu %c %02X:", (unsigned long)log_indexes[index],
+           (t->flags & TRACE_READ) ? 'R' : 'W', t->address);
+    if (t->data)
+        for (int i = 0; i < t->length; ++i)
+            printf(" %02X", t->data[i]);
+    printf("%s, model%s", (t->flags & TRACE_NACK) ? " NACK" : "", ret ? " NACK" : "");
+    if (data && ret == 0)
+        for (int i = 0; i < t->length; ++i)
+            printf(" %02X", (unsigned char)data[i]);
+    printf("\n");
+}
+
+static const struct replay_ops model_ops = {
+    model_write,
+    model_read,
+    NULL,
+    print_mismatch,
+};
+
+static bool write_file(const char *path, const std::vector<uint8_t> &data)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+    fwrite(data.data(), data.size(), 1, file);
+    fclose(file);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    bool binary = false;
+    const char *bundle_path = NULL;
+    const char *replay_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "bm:o:r:")) != -1) {
+        switch (opt) {
+        case 'b': binary = true; break;
+        case 'm': max_printed = strtoul(optarg, NULL, 0); break;
+        case 'o': bundle_path = optarg; break;
+        case 'r': replay_path = optarg; break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-b] [-m max_printed] [-o bundle] [-r log] input\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    struct repro_bundle b;
+    if (!load(argv[optind], binary, data))
+        return 1;
+    if (!repro_decode(data.data(), data.size(), &b)) {
+        fprintf(stderr, "%s: no valid bundle\n", argv[optind]);
+        return 1;
+    }
+    if (bundle_path && !write_file(bundle_path, data))
+        return 1;
+
+    printf("test %d iteration %lu, seed %lu, bus at %lu Hz, %lu transactions since boot\n",
+           b.info.test, (unsigned long)b.info.iteration, (unsigned long)b.info.seed,
+           (unsigned long)b.info.bus_frequency, (unsigned long)b.info.transactions);
+    char name[REPRO_NAME_MAX + 1];
+    uint32_t value;
+    while (repro_next_setting(&b, name, &value))
+        printf("  %-40s %lu\n", name, (unsigned long)value);
+
+    std::vector<struct transaction> transactions;
+    if (!unpack(&b, transactions))
+        return 1;
+    if (transactions.empty()) {
+        fprintf(stderr, "no transactions in the bundle\n");
+        return 1;
+    }
+    printf("%lu transactions: #%lu to #%lu\n", (unsigned long)transactions.size(),
+           (unsigned long)transactions.front().index, (unsigned long)transactions.back().index);
+
+    std::vector<uint8_t> log;
+    build_log(transactions, log);
+    if (replay_path && !write_file(replay_path, log))
+        return 1;
+
+    struct replay_stats stats;
+    slave_address = transactions.front().entry.address;
+    slave_model_init(&model, 0, 0);
+    if (!replay_run(log.data(), log.size(), &model_ops, false, &stats)) {
+        fprintf(stderr, "invalid replay log after %lu transactions\n",
+                (unsigned long)stats.transactions);
+        return 1;
+    }
+
+    if (stats.mismatches == 0) {
+        printf("not reproduced: the model gives the recorded responses\n");
+        return 1;
+    }
+    printf("reproduced: %lu mismatches, first at #%lu\n", (unsigned long)stats.mismatches,
+           (unsigned long)first_mismatch);
+    return 0;
+}
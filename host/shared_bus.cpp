@@ -0,0 +1,574 @@
+#include "shared_bus.h"
+#include <math.h>
+#include <queue>
+#include <string.h>
+#include <vector>
+
+#define DEVICE_BOARD        (0)
+#define DEVICE_EEPROM       (1)
+#define DEVICE_SENSOR       (2)
+#define MAX_DEVICES         (SHARED_BUS_MAX_BOARDS + 2)
+
+/* Transactions, the last one of an operation is TX_READ_BACK */
+#define TX_WRITE_REGISTER   (0)
+#define TX_SET_POINTER      (1)
+#define TX_READ_BACK        (2)
+#define TX_SENSOR           (3)
+#define TX_EEPROM           (4)
+#define TX_EEPROM_POLL      (5)     /* address only, until the write cycle ends */
+
+/* Interval of the EEPROM acknowledge polling */
+#define EEPROM_POLL_NS      (100000)
+
+#define EVENT_OPERATION     (0)     /* index: board */
+#define EVENT_SENSOR        (1)
+#define EVENT_EEPROM        (2)
+#define EVENT_START         (3)
+#define EVENT_FREE          (4)
+#define EVENT_RETRY         (5)
+
+struct device {
+    int type;
+    uint8_t address;
+    struct slave_model model;
+    uint8_t memory[256];
+    uint64_t busy_until_ns;     /* EEPROM write cycle, sensor conversion */
+};
+
+struct transaction {
+    uint8_t kind;
+    uint8_t address;            /* 8-bit address, bit 0 set for a read */
+    uint8_t length;             /* data bytes */
+    char data[2];
+    char expected;
+    uint64_t arrival_ns;        /* arrival of the operation */
+};
+
+struct master {
+    struct transaction queue[SHARED_BUS_QUEUE_SIZE];
+    int head;
+    int count;
+    struct transaction eeprom;      /* EEPROM write, polled between the queued transactions */
+    bool eeprom_pending;
+    uint64_t eeprom_at_ns;          /* next attempt */
+    struct transaction *current;    /* transaction sent at the last start */
+    bool lost;
+    uint64_t lost_at_ns;
+    bool winning;               /* owns the bus with the current transaction */
+    bool acked;
+};
+
+struct event {
+    uint64_t time_ns;
+    uint64_t sequence;
+    int type;
+    int index;
+
+    bool operator>(const event &other) const
+    {
+        return time_ns != other.time_ns ? time_ns > other.time_ns : sequence > other.sequence;
+    }
+};
+
+struct simulation {
+    const struct shared_bus_config *config;
+    struct shared_bus_stats *stats;
+    uint64_t now_ns;
+    uint64_t bit_ns;
+    uint64_t random;
+
+    struct device devices[MAX_DEVICES];
+    int device_count;
+    int device_by_address[128];
+    struct master masters[SHARED_BUS_MAX_MASTERS];
+
+    uint8_t eeprom_address;         /* next byte written to the EEPROM */
+
+    bool bus_busy;
+    bool start_pending;
+
+    std::priority_queue<event, std::vector<event>, std::greater<event> > events;
+    uint64_t sequence;
+};
+
+static uint64_t next_random(struct simulation *s)
+{
+    s->random ^= s->random << 13;
+    s->random ^= s->random >> 7;
+    s->random ^= s->random << 17;
+    return s->random;
+}
+
+/**
+ * @brief Interval before the next arrival of a Poisson process.
+ */
+static uint64_t exponential_ns(struct simulation *s, double rate)
+{
+    double u = (next_random(s) >> 11) * (1.0 / 9007199254740992.0);
+
+    return (uint64_t)(-log(1.0 - u) / rate * 1e9);
+}
+
+static void schedule(struct simulation *s, uint64_t time_ns, int type, int index)
+{
+    event e = {time_ns, s->sequence++, type, index};
+
+    s->events.push(e);
+}
+
+static struct transaction *queue_push(struct master *m)
+{
+    if (m->count == SHARED_BUS_QUEUE_SIZE)
+        return NULL;
+
+    return &m->queue[(m->head + m->count++) % SHARED_BUS_QUEUE_SIZE];
+}
+
+static void queue_pop(struct master *m)
+{
+    m->head = (m->head + 1) % SHARED_BUS_QUEUE_SIZE;
+    --m->count;
+}
+
+/**
+ * @brief Transaction a master sends next, NULL if none.
+ *
+ * A pending EEPROM write goes first when its next attempt is due; while the
+ * EEPROM is busy, the queued transactions go on.
+ */
+static struct transaction *next_transaction(const struct simulation *s, struct master *m)
+{
+    if (m->eeprom_pending && m->eeprom_at_ns <= s->now_ns)
+        return &m->eeprom;
+    if (m->count > 0)
+        return &m->queue[m->head];
+
+    return NULL;
+}
+
+/**
+ * @brief Start a transaction soon if the bus is free.
+ *
+ * Masters seeing the bus free within half a bit of each other all send a
+ * start condition and contend.
+ */
+static void request_bus(struct simulation *s)
+{
+    if (s->bus_busy || s->start_pending)
+        return;
+
+    s->start_pending = true;
+    schedule(s, s->now_ns + s->bit_ns / 2, EVENT_START, 0);
+}
+
+static void add_operation(struct simulation *s, int board)
+{
+    struct master *m = &s->masters[board % s->config->masters];
+    struct device *d = &s->devices[board];
+
+    if (m->count + 3 > SHARED_BUS_QUEUE_SIZE) {
+        ++s->stats->dropped;
+        return;
+    }
+
+    uint64_t r = next_random(s);
+    char reg = 1 + r % 4;
+    char value = r >> 8;
+
+    struct transaction *t = queue_push(m);
+    t->kind = TX_WRITE_REGISTER;
+    t->address = d->address;
+    t->length = 2;
+    t->data[0] = reg;
+    t->data[1] = value;
+    t->arrival_ns = s->now_ns;
+
+    t = queue_push(m);
+    t->kind = TX_SET_POINTER;
+    t->address = d->address;
+    t->length = 1;
+    t->data[0] = reg;
+    t->arrival_ns = s->now_ns;
+
+    t = queue_push(m);
+    t->kind = TX_READ_BACK;
+    t->address = d->address | 1;
+    t->length = 1;
+    t->expected = value;
+    t->arrival_ns = s->now_ns;
+
+    request_bus(s);
+}
+
+static void add_peripheral_transaction(struct simulation *s, int kind)
+{
+    struct master *m = &s->masters[0];
+    struct transaction *t;
+
+    if (kind == TX_EEPROM) {
+        /* Still polling the previous write */
+        if (m->eeprom_pending) {
+            ++s->stats->dropped;
+            return;
+        }
+        t = &m->eeprom;
+        m->eeprom_pending = true;
+        m->eeprom_at_ns = s->now_ns;
+    } else if ((t = queue_push(m)) == NULL) {
+        ++s->stats->dropped;
+        return;
+    }
+
+    t->kind = kind;
+    t->arrival_ns = s->now_ns;
+    if (kind == TX_SENSOR) {
+        t->address = SHARED_BUS_SENSOR_ADDRESS | 1;
+        t->length = 2;
+    } else {
+        t->address = SHARED_BUS_EEPROM_ADDRESS;
+        t->length = 2;
+        t->data[0] = s->eeprom_address++;
+        t->data[1] = next_random(s);
+    }
+
+    request_bus(s);
+}
+
+/**
+ * @brief Bit sent by a master at a position of its transaction.
+ *
+ * Only the address and the data of writes are sent by the master. Past the
+ * end, the master releases SDA.
+ */
+static int sent_bit(const struct transaction *t, int position)
+{
+    int byte = position / 8;
+    int bit = 7 - position % 8;
+
+    if (byte == 0)
+        return (t->address >> bit) & 1;
+    if ((t->address & 1) || byte > t->length)
+        return 1;
+
+    return ((uint8_t)t->data[byte - 1] >> bit) & 1;
+}
+
+static int sent_bits(const struct transaction *t)
+{
+    return (t->address & 1) ? 8 : 8 * (1 + t->length);
+}
+
+/**
+ * @brief Perform the transaction of the winner(s) on the device.
+ *
+ * @return Time the device stretches the clock, *acked is false if the
+ * address is not acknowledged
+ */
+static uint64_t perform(struct simulation *s, struct transaction *t, char *data, bool *acked)
+{
+    int index = s->device_by_address[t->address >> 1];
+    unsigned int now_us = s->now_ns / 1000;
+
+    *acked = false;
+    if (index < 0)
+        return 0;
+
+    struct device *d = &s->devices[index];
+    switch (d->type) {
+    case DEVICE_BOARD:
+        if (t->address & 1)
+            *acked = slave_model_read(&d->model, data, t->length, now_us) == 0;
+        else
+            *acked = slave_model_write(&d->model, t->data, t->length, now_us) == 0;
+        return (uint64_t)s->config->stretch_ns * (1 + t->length);
+
+    case DEVICE_EEPROM:
+        if (s->now_ns < d->busy_until_ns)
+            return 0;
+        *acked = true;
+        if (t->length == 0)
+            return 0;
+        for (int i = 1; i < t->length; ++i)
+            d->memory[(uint8_t)(t->data[0] + i - 1)] = t->data[i];
+        d->busy_until_ns = s->now_ns + (uint64_t)s->config->eeprom_write_us * 1000;
+        return 0;
+
+    case DEVICE_SENSOR: {
+        uint64_t stretch = s->now_ns < d->busy_until_ns ? d->busy_until_ns - s->now_ns : 0;
+        *acked = true;
+        data[0] = data[1] = 0;
+        d->busy_until_ns = s->now_ns + stretch + (uint64_t)s->config->sensor_conversion_us * 1000;
+        return stretch;
+    }
+    }
+
+    return 0;
+}
+
+static void start(struct simulation *s)
+{
+    int contenders[SHARED_BUS_MAX_MASTERS];
+    int count = 0;
+
+    s->start_pending = false;
+    for (int i = 0; i < s->config->masters; ++i) {
+        struct master *m = &s->masters[i];
+        if ((m->current = next_transaction(s, m)) != NULL)
+            contenders[count++] = i;
+    }
+    if (count == 0)
+        return;
+
+    /* Arbitration: compare the bits sent until one master is left */
+    int alive = count;
+    int lost_at_bit[SHARED_BUS_MAX_MASTERS] = {0};
+    bool in[SHARED_BUS_MAX_MASTERS];
+    int max_bits = 0;
+    for (int i = 0; i < count; ++i) {
+        struct master *m = &s->masters[contenders[i]];
+        in[i] = true;
+        int bits = sent_bits(m->current);
+        if (bits > max_bits)
+            max_bits = bits;
+    }
+    for (int position = 0; position < max_bits && alive > 1; ++position) {
+        int wired_and = 1;
+        for (int i = 0; i < count; ++i)
+            if (in[i])
+                wired_and &= sent_bit(s->masters[contenders[i]].current, position);
+
+        for (int i = 0; i < count; ++i) {
+            struct master *m = &s->masters[contenders[i]];
+            if (in[i] && sent_bit(m->current, position) != wired_and) {
+                in[i] = false;
+                lost_at_bit[i] = position;
+                --alive;
+            }
+        }
+    }
+
+    /* All masters left send the same transaction: they all complete it */
+    struct transaction *t = NULL;
+    for (int i = 0; i < count; ++i) {
+        struct master *m = &s->masters[contenders[i]];
+        if (!in[i]) {
+            ++s->stats->arbitration_losses;
+            if (!m->lost) {
+                m->lost = true;
+                m->lost_at_ns = s->now_ns + (1 + lost_at_bit[i] + lost_at_bit[i] / 8) * s->bit_ns;
+            }
+            continue;
+        }
+
+        if (m->lost) {
+            histogram_add(&s->stats->recovery, (s->now_ns - m->lost_at_ns) / 1000);
+            m->lost = false;
+        }
+        m->winning = true;
+        t = m->current;
+    }
+
+    char data[2];
+    bool acked;
+    uint64_t stretch = perform(s, t, data, &acked);
+    int bytes = acked ? 1 + t->length : 1;
+    uint64_t duration = (2 + 9 * bytes) * s->bit_ns + stretch + s->bit_ns / 2;
+
+    for (int i = 0; i < count; ++i) {
+        struct master *m = &s->masters[contenders[i]];
+        if (m->winning) {
+            m->acked = acked;
+            if (acked && (t->address & 1))
+                memcpy(m->current->data, data, t->length);
+        }
+    }
+
+    s->bus_busy = true;
+    s->stats->busy_ns += duration;
+    schedule(s, s->now_ns + duration, EVENT_FREE, 0);
+}
+
+/**
+ * @brief Drop the rest of a board operation after a transaction failed.
+ */
+static void abort_operation(struct simulation *s, struct master *m)
+{
+    int kind;
+
+    do {
+        kind = m->queue[m->head].kind;
+        queue_pop(m);
+    } while (kind != TX_READ_BACK && kind != TX_SENSOR && m->count > 0);
+
+    if (kind != TX_SENSOR)
+        ++s->stats->failed;
+}
+
+static void complete(struct simulation *s, struct master *m)
+{
+    struct transaction *t = m->current;
+
+    m->winning = false;
+    if (!m->acked) {
+        ++s->stats->nacks;
+        if (t == &m->eeprom) {
+            m->eeprom_at_ns = s->now_ns + EEPROM_POLL_NS;
+            schedule(s, m->eeprom_at_ns, EVENT_RETRY, 0);
+        } else {
+            abort_operation(s, m);
+        }
+        return;
+    }
+
+    ++s->stats->transactions;
+    if (t == &m->eeprom) {
+        /* Poll the EEPROM until the end of its write cycle */
+        if (t->kind == TX_EEPROM_POLL) {
+            m->eeprom_pending = false;
+        } else {
+            t->kind = TX_EEPROM_POLL;
+            t->length = 0;
+            m->eeprom_at_ns = s->now_ns + EEPROM_POLL_NS;
+            schedule(s, m->eeprom_at_ns, EVENT_RETRY, 0);
+        }
+        return;
+    }
+    if (t->kind == TX_READ_BACK) {
+        if (t->data[0] != t->expected)
+            ++s->stats->mismatches;
+        ++s->stats->operations;
+        histogram_add(&s->stats->latency, (s->now_ns - t->arrival_ns) / 1000);
+    }
+    queue_pop(m);
+}
+
+static void free_bus(struct simulation *s)
+{
+    bool pending = false;
+
+    for (int i = 0; i < s->config->masters; ++i) {
+        struct master *m = &s->masters[i];
+        if (m->winning)
+            complete(s, m);
+        pending |= next_transaction(s, m) != NULL;
+    }
+
+    s->bus_busy = false;
+    if (pending)
+        request_bus(s);
+}
+
+static void add_device(struct simulation *s, int type, uint8_t address)
+{
+    struct device *d = &s->devices[s->device_count];
+
+    memset(d, 0, sizeof(*d));
+    d->type = type;
+    d->address = address;
+    slave_model_init(&d->model, 0, 0);
+    s->device_by_address[address >> 1] = s->device_count++;
+}
+
+/**
+ * @brief 8-bit address of a board, skipping the addresses of the EEPROM and
+ * the sensor.
+ */
+static uint8_t board_address(int board)
+{
+    uint8_t address = 0x10 + 2 * board;
+
+    if (address >= SHARED_BUS_SENSOR_ADDRESS)
+        address += 2;
+    if (address >= SHARED_BUS_EEPROM_ADDRESS)
+        address += 2;
+
+    return address;
+}
+
+void shared_bus_default_config(struct shared_bus_config *config)
+{
+    config->frequency = 400000;
+    config->masters = 1;
+    config->boards = 4;
+    config->operation_rate = 100;
+    config->stretch_ns = 5000;
+    config->peripherals = true;
+    config->eeprom_period_us = 100000;
+    config->eeprom_write_us = 5000;
+    config->sensor_period_us = 10000;
+    config->sensor_conversion_us = 500;
+    config->seed = 1;
+    config->latency_bucket_us = 50;
+}
+
+void shared_bus_run(const struct shared_bus_config *config, double duration_s,
+                    struct shared_bus_stats *stats)
+{
+    static struct simulation s;
+    uint64_t end_ns = (uint64_t)(duration_s * 1e9);
+
+    memset(stats, 0, sizeof(*stats));
+    histogram_init(&stats->latency, config->latency_bucket_us);
+    histogram_init(&stats->recovery, config->latency_bucket_us);
+
+    s.config = config;
+    s.stats = stats;
+    s.now_ns = 0;
+    s.bit_ns = 1000000000 / config->frequency;
+    s.random = 0x9E3779B97F4A7C15ULL * (config->seed + 1);
+    s.eeprom_address = 0;
+    s.bus_busy = false;
+    s.start_pending = false;
+    s.sequence = 0;
+    s.events = std::priority_queue<event, std::vector<event>, std::greater<event> >();
+    memset(s.masters, 0, sizeof(s.masters));
+
+    s.device_count = 0;
+    for (int i = 0; i < 128; ++i)
+        s.device_by_address[i] = -1;
+    for (int i = 0; i < config->boards && i < SHARED_BUS_MAX_BOARDS; ++i)
+        add_device(&s, DEVICE_BOARD, board_address(i));
+    if (config->peripherals) {
+        add_device(&s, DEVICE_EEPROM, SHARED_BUS_EEPROM_ADDRESS);
+        add_device(&s, DEVICE_SENSOR, SHARED_BUS_SENSOR_ADDRESS);
+        schedule(&s, 0, EVENT_SENSOR, 0);
+        schedule(&s, 0, EVENT_EEPROM, 0);
+    }
+
+    for (int i = 0; i < config->boards && i < SHARED_BUS_MAX_BOARDS; ++i)
+        schedule(&s, exponential_ns(&s, config->operation_rate), EVENT_OPERATION, i);
+
+    while (!s.events.empty() && s.events.top().time_ns < end_ns) {
+        event e = s.events.top();
+        s.events.pop();
+        s.now_ns = e.time_ns;
+        ++stats->events;
+
+        switch (e.type) {
+        case EVENT_OPERATION:
+            add_operation(&s, e.index);
+            schedule(&s, s.now_ns + exponential_ns(&s, config->operation_rate),
+                     EVENT_OPERATION, e.index);
+            break;
+        case EVENT_SENSOR:
+            add_peripheral_transaction(&s, TX_SENSOR);
+            schedule(&s, s.now_ns + (uint64_t)config->sensor_period_us * 1000, EVENT_SENSOR, 0);
+            break;
+        case EVENT_EEPROM:
+            add_peripheral_transaction(&s, TX_EEPROM);
+            schedule(&s, s.now_ns + (uint64_t)config->eeprom_period_us * 1000, EVENT_EEPROM, 0);
+            break;
+        case EVENT_START:
+            start(&s);
+            break;
+        case EVENT_FREE:
+            free_bus(&s);
+            break;
+        case EVENT_RETRY:
+            request_bus(&s);
+            break;
+        }
+    }
+
+    stats->simulated_ns = end_ns;
+}
@@ -0,0 +1,84 @@
+/**
+ * Discrete-event model of an I2C bus shared by several masters and devices.
+ *
+ * Devices:
+ *  - boards running the robotarmclick firmware (slave model), which stretch
+ *    the clock after each byte while the firmware handles it,
+ *  - an EEPROM which does not acknowledge its address during its write cycle
+ *    (the master polls it),
+ *  - a sensor which stretches the clock on a read until its conversion is
+ *    done, then starts the next conversion.
+ *
+ * Each master is a fixture testing its own boards: operations (a register
+ * write followed by a read back) arrive at random (Poisson) and are queued.
+ * Master 0 also reads the sensor and writes to the EEPROM periodically; it
+ * polls the EEPROM between its queued transactions, so the write cycle does
+ * not hold the board operations back. An operation whose write or read is not
+ * acknowledged is abandoned.
+ *
+ * The bus is simulated one transaction at a time, not one bit at a time:
+ * masters starting within the same window contend, and the arbitration is
+ * resolved by comparing the bits they send (wired-AND, the first master
+ * sending 1 while another sends 0 loses). Identical transactions all win.
+ * Losers retry when the bus is free again.
+ */
+
+#ifndef SHARED_BUS_H
+#define SHARED_BUS_H
+
+#include <stdint.h>
+#include "histogram.h"
+#include "slave_model.h"
+
+#define SHARED_BUS_MAX_MASTERS      (4)
+#define SHARED_BUS_MAX_BOARDS       (64)
+#define SHARED_BUS_QUEUE_SIZE       (64)
+#define SHARED_BUS_EEPROM_ADDRESS   (0xA0)
+#define SHARED_BUS_SENSOR_ADDRESS   (0x90)
+
+struct shared_bus_config {
+    int frequency;                  /* bus frequency in Hz */
+    int masters;
+    int boards;                     /* shared by the masters round-robin */
+    double operation_rate;          /* operations per second and per board */
+    uint32_t stretch_ns;            /* stretching of a board after each byte */
+    bool peripherals;               /* add the EEPROM and the sensor */
+    uint32_t eeprom_period_us;      /* master 0 writes one EEPROM byte per period */
+    uint32_t eeprom_write_us;       /* write cycle of the EEPROM */
+    uint32_t sensor_period_us;      /* master 0 reads the sensor once per period */
+    uint32_t sensor_conversion_us;  /* conversion time of the sensor */
+    uint32_t seed;
+    uint32_t latency_bucket_us;     /* bucket width of the latency histograms */
+};
+
+struct shared_bus_stats {
+    uint64_t simulated_ns;
+    uint64_t busy_ns;               /* time the bus is not free */
+    unsigned long transactions;     /* completed transactions */
+    unsigned long operations;       /* completed board operations */
+    unsigned long failed;           /* operations abandoned after a nack */
+    unsigned long nacks;
+    unsigned long arbitration_losses;
+    unsigned long mismatches;       /* read back different from written */
+    unsigned long dropped;          /* operations dropped, master queue full */
+    unsigned long events;
+    struct histogram latency;       /* operation arrival to completion, us */
+    struct histogram recovery;      /* arbitration loss to next win, us */
+};
+
+/**
+ * @brief Simulate the bus.
+ *
+ * @param[in] config configuration
+ * @param[in] duration_s simulated time in seconds
+ * @param[out] stats statistics of the run
+ */
+void shared_bus_run(const struct shared_bus_config *config, double duration_s,
+                    struct shared_bus_stats *stats);
+
+/**
+ * @brief Fill a configuration with typical values.
+ */
+void shared_bus_default_config(struct shared_bus_config *config);
+
+#endif
@@ -0,0 +1,115 @@
+#include "sliced_model.h"
+#include <string.h>
+
+#define REGISTER_COUNT      SLAVE_MODEL_REGISTER_COUNT
+
+/**
+ * @brief Move the current register of every board to the next one.
+ *
+ * Boards with the no_increment fault keep their current register.
+ */
+static void increment(struct sliced_model *m)
+{
+    sliced_word inc = ~m->faults.no_increment;
+
+    m->current[REGISTER_COUNT] |= m->current[REGISTER_COUNT - 1] & inc;
+    for (int r = REGISTER_COUNT - 1; r > 0; --r)
+        m->current[r] = (m->current[r] & ~inc) | (m->current[r - 1] & inc);
+    m->current[0] &= ~inc;
+}
+
+/**
+ * @brief Select the current register from the address sent by the master.
+ */
+static void select_register(struct sliced_model *m, unsigned int address)
+{
+    sliced_word alias = m->faults.address_alias;
+
+    memset(m->current, 0, sizeof(m->current));
+    m->current[address < REGISTER_COUNT ? address : REGISTER_COUNT] |= ~alias;
+    m->current[(address & 7) < REGISTER_COUNT ? (address & 7) : REGISTER_COUNT] |= alias;
+}
+
+void sliced_model_init(struct sliced_model *m)
+{
+    memset(m, 0, sizeof(*m));
+    m->current[0] = SLICED_MODEL_ALL;
+}
+
+void sliced_model_load(struct sliced_model *m, int board, const char *regs)
+{
+    sliced_word bit = (sliced_word)1 << board;
+
+    for (int r = 0; r < REGISTER_COUNT; ++r) {
+        for (int b = 0; b < 8; ++b) {
+            if ((r == 0 && b >= 4) || !(regs[r] & (1 << b)))
+                m->regs[r][b] &= ~bit;
+            else
+                m->regs[r][b] |= bit;
+        }
+    }
+}
+
+void sliced_model_write(struct sliced_model *m, const char *data, int length)
+{
+    if (length == 0)
+        return;
+
+    select_register(m, (unsigned char)data[0]);
+    for (int i = 1; i < length; ++i) {
+        for (int r = 0; r < REGISTER_COUNT; ++r) {
+            sliced_word selected = m->current[r] & ~m->faults.ignore_write[r];
+
+            for (int b = 0; b < 8; ++b) {
+                sliced_word sel = selected;
+                if (r == 0 && b >= 4)
+                    sel &= m->faults.reg0_upper_writable;
+
+                sliced_word value = (data[i] & (1 << b)) ? SLICED_MODEL_ALL : 0;
+                m->regs[r][b] = (m->regs[r][b] & ~sel) | (value & sel);
+            }
+        }
+        increment(m);
+    }
+}
+
+void sliced_model_read(struct sliced_model *m, sliced_word *planes, int length)
+{
+    for (int i = 0; i < length; ++i) {
+        for (int b = 0; b < 8; ++b) {
+            sliced_word bit = 0;
+
+            for (int r = 0; r < REGISTER_COUNT; ++r) {
+                sliced_word value = (m->regs[r][b] | m->faults.stuck1[r][b])
+                                  & ~m->faults.stuck0[r][b];
+                bit |= m->current[r] & value;
+            }
+            planes[i * 8 + b] = bit;
+        }
+        increment(m);
+    }
+}
+
+char sliced_model_byte(const sliced_word *planes, int board)
+{
+    char value = 0;
+
+    for (int b = 0; b < 8; ++b)
+        if (planes[b] & ((sliced_word)1 << board))
+            value |= 1 << b;
+
+    return value;
+}
+
+sliced_word sliced_model_compare(const sliced_word *a, const sliced_word *b,
+                                 const char *masks, int length)
+{
+    sliced_word mismatch = 0;
+
+    for (int i = 0; i < length; ++i)
+        for (int bit = 0; bit < 8; ++bit)
+            if (masks[i] & (1 << bit))
+                mismatch |= a[i * 8 + bit] ^ b[i * 8 + bit];
+
+    return mismatch;
+}
@@ -0,0 +1,100 @@
+/**
+ * Bit-sliced model of the robotarmclick firmware.
+ *
+ * Each bit position of a sliced_word is a separate simulated board, so one
+ * operation on the model is applied to SLICED_MODEL_BOARDS boards at once.
+ * Register bit b of register r is stored in regs[r][b] for all boards and the
+ * current register of each board is stored one-hot in current[].
+ *
+ * Boards can start from different register values and can have faults
+ * injected individually through the masks of struct sliced_faults. Without
+ * faults, every board behaves exactly like the scalar model of slave_model.h.
+ */
+
+#ifndef SLICED_MODEL_H
+#define SLICED_MODEL_H
+
+#include <stdint.h>
+#include "slave_model.h"
+
+typedef uint64_t sliced_word;
+
+#define SLICED_MODEL_BOARDS         (64)
+#define SLICED_MODEL_ALL            (~(sliced_word)0)
+
+struct sliced_faults {
+    sliced_word stuck0[SLAVE_MODEL_REGISTER_COUNT][8];  /* bit reads as 0 */
+    sliced_word stuck1[SLAVE_MODEL_REGISTER_COUNT][8];  /* bit reads as 1 */
+    sliced_word ignore_write[SLAVE_MODEL_REGISTER_COUNT];
+    sliced_word no_increment;           /* current register never increments */
+    sliced_word reg0_upper_writable;    /* upper half of register 0 is writable */
+    sliced_word address_alias;          /* only 3 bits of the address are decoded */
+};
+
+struct sliced_model {
+    sliced_word regs[SLAVE_MODEL_REGISTER_COUNT][8];
+
+    /* current[SLAVE_MODEL_REGISTER_COUNT]: past the last or invalid register */
+    sliced_word current[SLAVE_MODEL_REGISTER_COUNT + 1];
+
+    struct sliced_faults faults;
+};
+
+/**
+ * @brief Reset all boards: registers cleared, current register 0, no fault.
+ *
+ * @param[out] m model to reset
+ */
+void sliced_model_init(struct sliced_model *m);
+
+/**
+ * @brief Set the registers of one board.
+ *
+ * @param[in] m model
+ * @param[in] board board number
+ * @param[in] regs values of registers 0-4
+ */
+void sliced_model_load(struct sliced_model *m, int board, const char *regs);
+
+/**
+ * @brief Perform the same write transaction on all boards.
+ *
+ * @param[in] m model
+ * @param[in] data bytes sent by the master, data[0] is the register address
+ * @param[in] length number of bytes sent
+ */
+void sliced_model_write(struct sliced_model *m, const char *data, int length);
+
+/**
+ * @brief Perform the same read transaction on all boards.
+ *
+ * planes[i * 8 + b] holds bit b of byte i of all boards.
+ *
+ * @param[in] m model
+ * @param[out] planes bit planes of the bytes read (length * 8 entries)
+ * @param[in] length number of bytes to read
+ */
+void sliced_model_read(struct sliced_model *m, sliced_word *planes, int length);
+
+/**
+ * @brief Extract the byte of one board from its bit planes.
+ *
+ * @param[in] planes 8 bit planes of one byte
+ * @param[in] board board number
+ * @return Byte of the board
+ */
+char sliced_model_byte(const sliced_word *planes, int board);
+
+/**
+ * @brief Compare bit planes of two reads.
+ *
+ * @param[in] a bit planes of the first read
+ * @param[in] b bit planes of the second read
+ * @param[in] masks bits to compare for each byte
+ * @param[in] length number of bytes
+ * @return Mask of the boards for which at least one compared bit differs
+ */
+sliced_word sliced_model_compare(const sliced_word *a, const sliced_word *b,
+                                 const char *masks, int length);
+
+#endif
@@ -0,0 +1,230 @@
+/**
+ * Decode the packed history of the flight recorder (see trace_pack.h).
+ *
+ * With TRACE_DUMP, a fixture prints the blocks of its packed history in hex
+ * after a failure, one "trace:" line per block. The input is the console log
+ * of the fixture (other lines are ignored), or the raw blocks with -b. The
+ * transactions are printed oldest first; -r also writes them to a replay log
+ * (see replay.h).
+ *
+ * -p packs a replay log into blocks of the size used by the firmware, to
+ * measure the compression on a traffic (for instance from coro_sim -w); the
+ * blocks are written to output.
+ *
+ * usage: trace_unpack [-b] [-r log] input
+ *        trace_unpack -p replay_log output
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+#include "record.h"
+#include "replay.h"
+#include "trace.h"
+#include "trace_pack.h"
+
+#define LINE_PREFIX     "trace:"
+
+static int hex_value(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F')
+        return c - 'A' + 10;
+    return -1;
+}
+
+/**
+ * @brief Read the blocks of a console log, or of a raw file.
+ */
+static bool load(const char *path, bool binary, std::vector<uint8_t> &blocks)
+{
+    FILE *file = fopen(path, binary ? "rb" : "r");
+    if (file == NULL) {
+        perror(path);
+        return false;
+    }
+
+    if (binary) {
+        uint8_t buf[4096];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), file)) > 0)
+            blocks.insert(blocks.end(), buf, buf + n);
+    } else {
+        char line[4096];
+        while (fgets(line, sizeof(line), file)) {
+            const char *p = strstr(line, LINE_PREFIX);
+            if (p == NULL)
+                continue;
+            for (p += strlen(LINE_PREFIX); hex_value(p[0]) >= 0 && hex_value(p[1]) >= 0; p += 2)
+                blocks.push_back(hex_value(p[0]) << 4 | hex_value(p[1]));
+        }
+    }
+
+    fclose(file);
+    return true;
+}
+
+static void print_entry(uint32_t index, const struct trace_entry *e)
+{
+    printf("  #%lu %lu us %c %02X", (unsigned long)index, (unsigned long)e->timestamp_us,
+           (e->flags & TRACE_READ) ? 'R' : 'W', e->address);
+    if ((e->flags & (TRACE_READ | TRACE_NACK)) != (TRACE_READ | TRACE_NACK))
+        for (int i = 0; i < e->length && i < TRACE_DATA_MAX; ++i)
+            printf(" %02X", e->data[i]);
+    printf("%s\n", (e->flags & TRACE_NACK) ? " NACK" : "");
+}
+
+static int unpack(const char *path, bool binary, const char *replay_path)
+{
+    std::vector<uint8_t> blocks;
+    if (!load(path, binary, blocks))
+        return 1;
+
+    FILE *log = NULL;
+    struct replay_writer writer;
+    if (replay_path) {
+        uint8_t header[REPLAY_HEADER_SIZE];
+        if ((log = fopen(replay_path, "wb")) == NULL) {
+            perror(replay_path);
+            return 1;
+        }
+        fwrite(header, replay_encode_header(header, &writer), 1, log);
+    }
+
+    unsigned long transactions = 0;
+    int block_count = 0;
+    uint32_t next_index = 0;
+    int ret = 0;
+    for (size_t offset = 0; offset < blocks.size(); ++block_count) {
+        int size = trace_pack_block_size(&blocks[offset], blocks.size() - offset);
+        struct trace_pack_decoder d;
+        if (!trace_pack_decoder_init(&d, &blocks[offset], size)) {
+            fprintf(stderr, "block %d: truncated\n", block_count);
+            ret = 1;
+            break;
+        }
+        offset += size;
+
+        if (block_count && d.index != next_index)
+            printf("%lu transactions missing\n", (unsigned long)(d.index - next_index));
+
+        uint32_t index;
+        struct trace_entry e;
+        while (trace_pack_next(&d, &index, &e)) {
+            print_entry(index, &e);
+            if (log) {
+                uint8_t buf[REPLAY_MAX_RECORD_SIZE];
+                fwrite(buf, replay_encode_trace(buf, &writer, &e), 1, log);
+            }
+            ++transactions;
+        }
+        next_index = d.index;
+        if (d.error) {
+            fprintf(stderr, "block %d: invalid record\n", block_count);
+            ret = 1;
+            break;
+        }
+    }
+
+    if (log)
+        fclose(log);
+    fprintf(stderr, "%d blocks, %lu transactions in %lu bytes (%.2f bytes per transaction)\n",
+            block_count, transactions, (unsigned long)blocks.size(),
+            transactions ? (double)blocks.size() / transactions : 0.0);
+
+    return ret;
+}
+
+static int pack(const char *replay_path, const char *output)
+{
+    std::vector<uint8_t> log;
+    if (!load(replay_path, true, log))
+        return 1;
+    if (!replay_check_header(log.data(), log.size())) {
+        fprintf(stderr, "%s: not a replay log\n", replay_path);
+        return 1;
+    }
+
+    FILE *file = fopen(output, "wb");
+    if (file == NULL) {
+        perror(output);
+        return 1;
+    }
+
+    uint8_t block[TRACE_HISTORY_BLOCK_SIZE];
+    struct trace_pack_encoder e;
+    uint32_t now_us = 0;
+    unsigned long transactions = 0, packed = 0, record_bytes = 0;
+    int block_count = 1;
+    static const uint8_t none[TRACE_DATA_MAX] = {0};
+
+    trace_pack_start(&e, block, sizeof(block), 0);
+    for (uint32_t offset = REPLAY_HEADER_SIZE; offset < log.size(); ) {
+        struct replay_transaction t;
+        int n = replay_decode(&log[offset], log.size() - offset, &t);
+        if (n == 0) {
+            fprintf(stderr, "%s: invalid record at %lu\n", replay_path, (unsigned long)offset);
+            break;
+        }
+        offset += n;
+
+        now_us += t.delta_us;
+        const uint8_t *data = t.data ? t.data : none;
+        if (!trace_pack_append(&e, now_us, t.address, t.flags, data, t.length)) {
+            fwrite(block, e.length, 1, file);
+            packed += e.length;
+            trace_pack_start(&e, block, sizeof(block), transactions);
+            trace_pack_append(&e, now_us, t.address, t.flags, data, t.length);
+            ++block_count;
+        }
+        ++transactions;
+        record_bytes += RECORD_HEADER_SIZE + 11 + (t.length < TRACE_DATA_MAX ? t.length : TRACE_DATA_MAX);
+    }
+    fwrite(block, e.length, 1, file);
+    packed += e.length;
+    fclose(file);
+
+    printf("%lu transactions in %d blocks: %lu bytes (%.2f bytes per transaction)\n",
+           transactions, block_count, packed, transactions ? (double)packed / transactions : 0.0);
+    if (packed)
+        printf("%.1fx smaller than the flight recorder entries, %.1fx smaller than trace records\n",
+               (double)transactions * sizeof(struct trace_entry) / packed,
+               (double)record_bytes / packed);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    bool binary = false;
+    bool packing = false;
+    const char *replay_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "bpr:")) != -1) {
+        switch (opt) {
+        case 'b': binary = true; break;
+        case 'p': packing = true; break;
+        case 'r': replay_path = optarg; break;
+        default:
+            optind = argc + 1;
+            break;
+        }
+    }
+
+    if (packing && optind == argc - 2)
+        return pack(argv[optind], argv[optind + 1]);
+
+    if (packing || optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-b] [-r log] input\n"
+                        "       %s -p replay_log output\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    return unpack(argv[optind], binary, replay_path);
+}
@@ -0,0 +1,149 @@
+#include "verify.h"
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define VERIFY_X86
+#endif
+
+void verify_mask_init(struct verify_mask *mask, const uint8_t *pattern, size_t length)
+{
+    mask->period = length * 64;
+    for (size_t i = 0; i < mask->period; ++i)
+        mask->table[i] = pattern[i % length];
+}
+
+static inline void add_mismatch(size_t position, size_t count, size_t *mismatches,
+                                size_t max_mismatches)
+{
+    if (count < max_mismatches)
+        mismatches[count] = position;
+}
+
+static size_t verify_scalar(const uint8_t *expected, const uint8_t *actual, size_t start,
+                            size_t length, const struct verify_mask *mask, size_t offset,
+                            size_t *mismatches, size_t max_mismatches, size_t count)
+{
+    for (size_t i = start; i < length; ++i) {
+        if ((expected[i] ^ actual[i]) & mask->table[offset])
+            add_mismatch(i, count++, mismatches, max_mismatches);
+        if (++offset == mask->period)
+            offset = 0;
+    }
+
+    return count;
+}
+
+#ifdef VERIFY_X86
+/**
+ * @brief Record the positions of the bits set in a movemask result.
+ */
+static inline size_t add_mismatches(uint32_t bits, size_t base, size_t count,
+                                    size_t *mismatches, size_t max_mismatches)
+{
+    while (bits) {
+        add_mismatch(base + __builtin_ctz(bits), count++, mismatches, max_mismatches);
+        bits &= bits - 1;
+    }
+
+    return count;
+}
+
+__attribute__((target("sse2")))
+static size_t verify_sse2(const uint8_t *expected, const uint8_t *actual, size_t length,
+                          const struct verify_mask *mask, size_t *mismatches, size_t max_mismatches)
+{
+    const __m128i zero = _mm_setzero_si128();
+    size_t count = 0;
+    size_t offset = 0;
+    size_t i = 0;
+
+    for (; i + 16 <= length; i += 16) {
+        __m128i e = _mm_loadu_si128((const __m128i *)&expected[i]);
+        __m128i a = _mm_loadu_si128((const __m128i *)&actual[i]);
+        __m128i m = _mm_loadu_si128((const __m128i *)&mask->table[offset]);
+        __m128i diff = _mm_and_si128(_mm_xor_si128(e, a), m);
+        uint32_t bits = ~_mm_movemask_epi8(_mm_cmpeq_epi8(diff, zero)) & 0xFFFF;
+
+        if (bits)
+            count = add_mismatches(bits, i, count, mismatches, max_mismatches);
+        offset += 16;
+        if (offset == mask->period)
+            offset = 0;
+    }
+
+    return verify_scalar(expected, actual, i, length, mask, offset, mismatches, max_mismatches, count);
+}
+
+__attribute__((target("avx2")))
+static size_t verify_avx2(const uint8_t *expected, const uint8_t *actual, size_t length,
+                          const struct verify_mask *mask, size_t *mismatches, size_t max_mismatches)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    size_t count = 0;
+    size_t offset = 0;
+    size_t i = 0;
+
+    /* Two vectors per iteration, mismatches are rare so test them together */
+    for (; i + 64 <= length; i += 64) {
+        __m256i m0 = _mm256_loadu_si256((const __m256i *)&mask->table[offset]);
+        __m256i m1 = _mm256_loadu_si256((const __m256i *)&mask->table[offset + 32]);
+        __m256i d0 = _mm256_and_si256(_mm256_xor_si256(
+                         _mm256_loadu_si256((const __m256i *)&expected[i]),
+                         _mm256_loadu_si256((const __m256i *)&actual[i])), m0);
+        __m256i d1 = _mm256_and_si256(_mm256_xor_si256(
+                         _mm256_loadu_si256((const __m256i *)&expected[i + 32]),
+                         _mm256_loadu_si256((const __m256i *)&actual[i + 32])), m1);
+
+        if (!_mm256_testz_si256(_mm256_or_si256(d0, d1), _mm256_or_si256(d0, d1))) {
+            uint32_t bits0 = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d0, zero));
+            uint32_t bits1 = ~(uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(d1, zero));
+            count = add_mismatches(bits0, i, count, mismatches, max_mismatches);
+            count = add_mismatches(bits1, i + 32, count, mismatches, max_mismatches);
+        }
+
+        offset += 64;
+        if (offset == mask->period)
+            offset = 0;
+    }
+
+    return verify_scalar(expected, actual, i, length, mask, offset, mismatches, max_mismatches, count);
+}
+#endif
+
+bool verify_supported(enum verify_kernel kernel)
+{
+    switch (kernel) {
+    case VERIFY_AUTO:
+    case VERIFY_SCALAR:
+        return true;
+#ifdef VERIFY_X86
+    case VERIFY_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case VERIFY_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+    default:
+        return false;
+    }
+}
+
+size_t verify_streams(enum verify_kernel kernel, const uint8_t *expected, const uint8_t *actual,
+                      size_t length, const struct verify_mask *mask,
+                      size_t *mismatches, size_t max_mismatches)
+{
+    if (kernel == VERIFY_AUTO)
+        kernel = verify_supported(VERIFY_AVX2) ? VERIFY_AVX2
+               : verify_supported(VERIFY_SSE2) ? VERIFY_SSE2 : VERIFY_SCALAR;
+
+    switch (kernel) {
+#ifdef VERIFY_X86
+    case VERIFY_SSE2:
+        return verify_sse2(expected, actual, length, mask, mismatches, max_mismatches);
+    case VERIFY_AVX2:
+        return verify_avx2(expected, actual, length, mask, mismatches, max_mismatches);
+#endif
+    default:
+        return verify_scalar(expected, actual, 0, length, mask, 0, mismatches, max_mismatches, 0);
+    }
+}
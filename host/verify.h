@@ -0,0 +1,68 @@
+/**
+ * Bulk comparison of read-back streams with the expected register values.
+ *
+ * Streams are byte arrays in which each position is a register read back.
+ * The bits compared at each position are given by a mask pattern repeated
+ * over the whole stream, e.g. {0x0F, 0xFF, 0xFF, 0xFF, 0xFF} for bursts of
+ * registers 0-4, where only the lower half of register 0 is defined. Bytes
+ * read past register 4 must be 0: their expected value is 0 and their mask
+ * 0xFF.
+ *
+ * The comparison uses SSE2 or AVX2 when available, chosen at run time, and
+ * falls back to a scalar loop.
+ */
+
+#ifndef VERIFY_H
+#define VERIFY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Longest mask pattern */
+#define VERIFY_MAX_PATTERN      (64)
+
+enum verify_kernel {
+    VERIFY_AUTO,
+    VERIFY_SCALAR,
+    VERIFY_SSE2,
+    VERIFY_AVX2,
+};
+
+struct verify_mask {
+    size_t period;
+    /* Pattern repeated to a multiple of 64 bytes, so vectors never straddle it */
+    uint8_t table[VERIFY_MAX_PATTERN * 64];
+};
+
+/**
+ * @brief Prepare a mask pattern.
+ *
+ * @param[out] mask prepared mask
+ * @param[in] pattern mask of each position of the pattern
+ * @param[in] length length of the pattern (1 to VERIFY_MAX_PATTERN)
+ */
+void verify_mask_init(struct verify_mask *mask, const uint8_t *pattern, size_t length);
+
+/**
+ * @brief Find the positions where the actual and expected bytes differ.
+ *
+ * @param[in] kernel implementation to use, VERIFY_AUTO for the fastest one
+ * @param[in] expected expected bytes
+ * @param[in] actual bytes read back
+ * @param[in] length number of bytes
+ * @param[in] mask mask pattern, position 0 of the pattern is position 0 of
+ * the streams
+ * @param[out] mismatches positions of the first max_mismatches mismatches
+ * @param[in] max_mismatches size of mismatches
+ * @return Number of mismatches, which may be larger than max_mismatches
+ */
+size_t verify_streams(enum verify_kernel kernel, const uint8_t *expected, const uint8_t *actual,
+                      size_t length, const struct verify_mask *mask,
+                      size_t *mismatches, size_t max_mismatches);
+
+/**
+ * @return True if a kernel can run on this machine
+ */
+bool verify_supported(enum verify_kernel kernel);
+
+#endif
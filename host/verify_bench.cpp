@@ -0,0 +1,128 @@
+/**
+ * Check and benchmark the verification kernels of verify.h.
+ *
+ * Streams of 8-byte bursts (registers 0-4 followed by 3 bytes read past
+ * register 4, which must be 0) are generated with random mismatches. The
+ * upper half of register 0 is random in the actual stream, it must not be
+ * reported. Each kernel must find exactly the injected mismatches; its
+ * throughput is the size of both streams divided by the best time.
+ *
+ * usage: verify_bench [-n megabytes] [-e mismatches_per_million] [-r repetitions] [-s seed]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+#include "verify.h"
+
+#define BURST_LENGTH    (8)
+
+static double now_s(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char **argv)
+{
+    size_t megabytes = 256;
+    unsigned long per_million = 10;
+    int repetitions = 5;
+    unsigned int seed = 1;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:e:r:s:")) != -1) {
+        switch (opt) {
+        case 'n': megabytes = strtoul(optarg, NULL, 0); break;
+        case 'e': per_million = strtoul(optarg, NULL, 0); break;
+        case 'r': repetitions = strtoul(optarg, NULL, 0); break;
+        case 's': seed = strtoul(optarg, NULL, 0); break;
+        default:
+            fprintf(stderr, "usage: %s [-n megabytes] [-e mismatches_per_million] [-r repetitions] [-s seed]\n",
+                    argv[0]);
+            return 1;
+        }
+    }
+
+    size_t length = megabytes << 20;
+    if (length == 0 || repetitions <= 0) {
+        fprintf(stderr, "invalid arguments\n");
+        return 1;
+    }
+
+    static const uint8_t pattern[BURST_LENGTH] = {0x0F, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+    static struct verify_mask mask;
+    verify_mask_init(&mask, pattern, BURST_LENGTH);
+
+    std::vector<uint8_t> expected(length), actual(length);
+    std::vector<size_t> injected;
+    srand(seed);
+    for (size_t i = 0; i < length; ++i) {
+        int reg = i % BURST_LENGTH;
+        expected[i] = reg < 5 ? rand() : 0;
+        actual[i] = expected[i];
+        if (reg == 0)
+            actual[i] = (rand() & 0xF0) | (expected[i] & 0x0F);
+
+        if ((unsigned long)rand() % 1000000 < per_million) {
+            actual[i] ^= 1 << (reg == 0 ? rand() % 4 : rand() % 8);
+            injected.push_back(i);
+        }
+    }
+
+    std::vector<size_t> found(injected.size() + 1);
+    std::vector<uint8_t> copy(length);
+    double best = 1e9;
+    for (int r = 0; r < repetitions; ++r) {
+        double start = now_s();
+        memcpy(&copy[0], &actual[0], length);
+        double elapsed = now_s() - start;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    printf("%lu MB per stream, %lu mismatches\n", (unsigned long)megabytes,
+           (unsigned long)injected.size());
+    printf("%-8s %8.2f GB/s (memcpy, reference)\n", "memcpy", 2 * length / best / 1e9);
+
+    static const struct {
+        enum verify_kernel kernel;
+        const char *name;
+    } kernels[] = {
+        {VERIFY_SCALAR, "scalar"},
+        {VERIFY_SSE2, "sse2"},
+        {VERIFY_AVX2, "avx2"},
+    };
+
+    int ret = 0;
+    for (unsigned int k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+        if (!verify_supported(kernels[k].kernel)) {
+            printf("%-8s not supported\n", kernels[k].name);
+            continue;
+        }
+
+        size_t count = 0;
+        best = 1e9;
+        for (int r = 0; r < repetitions; ++r) {
+            double start = now_s();
+            count = verify_streams(kernels[k].kernel, &expected[0], &actual[0], length, &mask,
+                                   &found[0], found.size());
+            double elapsed = now_s() - start;
+            if (elapsed < best)
+                best = elapsed;
+        }
+
+        bool correct = count == injected.size()
+                    && memcmp(&found[0], &injected[0], count * sizeof(size_t)) == 0;
+        printf("%-8s %8.2f GB/s %s\n", kernels[k].name, 2 * length / best / 1e9,
+               correct ? "" : "WRONG MISMATCHES");
+        if (!correct)
+            ret = 1;
+    }
+
+    return ret;
+}
@@ -0,0 +1,176 @@
+#include "lockstep_i2c.h"
+
+/* Number of CPU cycles of one iteration of the delay loop */
+#define DELAY_LOOP_CYCLES           (4)
+
+/* Maximum number of half periods a slave may stretch the clock */
+#define CLOCK_STRETCH_TIMEOUT       (10000)
+
+LockstepI2C::LockstepI2C(PortName port, uint32_t scl_mask, uint32_t sda_mask)
+    : _port(port, scl_mask | sda_mask),
+      _gpio((LPC_GPIO_TypeDef *)(LPC_GPIO0_BASE + port * 0x20)),
+      _scl(scl_mask),
+      _sda(sda_mask),
+      _count(0)
+{
+    for (int i = 0; i < 32 && _count < LOCKSTEP_I2C_MAX_BUS; ++i)
+        if (sda_mask & (1UL << i))
+            _sda_pin[_count++] = i;
+
+    /* Release all lines before switching them to output */
+    _port.mode(OpenDrain);
+    _gpio->FIOSET = _scl | _sda;
+    _port.output();
+
+    frequency(100000);
+}
+
+void LockstepI2C::frequency(int hz)
+{
+    _delay_loops = SystemCoreClock / (hz * 2 * DELAY_LOOP_CYCLES);
+}
+
+uint32_t LockstepI2C::write(int address, const char *data, int length, bool repeated)
+{
+    start();
+    uint32_t acked = write_byte(address & 0xFE);
+    for (int i = 0; i < length; ++i)
+        acked &= write_byte(data[i]);
+
+    if (!repeated)
+        stop();
+
+    return to_bus_mask(acked);
+}
+
+uint32_t LockstepI2C::read(int address, uint32_t *planes, int length, bool repeated)
+{
+    start();
+    uint32_t acked = write_byte(address | 0x01);
+    for (int i = 0; i < length; ++i)
+        read_byte(&planes[i * 8], i < length - 1);
+
+    if (!repeated)
+        stop();
+
+    return to_bus_mask(acked);
+}
+
+char LockstepI2C::byte(const uint32_t *planes, int bus)
+{
+    char value = 0;
+
+    for (int b = 0; b < 8; ++b)
+        if (planes[b] & (1UL << bus))
+            value |= 1 << b;
+
+    return value;
+}
+
+void LockstepI2C::delay()
+{
+    for (volatile uint32_t i = 0; i < _delay_loops; ++i)
+        ;
+}
+
+/**
+ * @brief Release all SCL lines and wait until every slave releases them.
+ *
+ * A slave stretching the clock holds back all buses.
+ */
+void LockstepI2C::scl_release()
+{
+    _gpio->FIOSET = _scl;
+    for (int i = 0; i < CLOCK_STRETCH_TIMEOUT && (_gpio->FIOPIN & _scl) != _scl; ++i)
+        delay();
+}
+
+void LockstepI2C::start()
+{
+    /* Also works as a repeated start: SCL is low after a byte */
+    _gpio->FIOSET = _sda;
+    delay();
+    scl_release();
+    delay();
+    _gpio->FIOCLR = _sda;
+    delay();
+    _gpio->FIOCLR = _scl;
+}
+
+void LockstepI2C::stop()
+{
+    _gpio->FIOCLR = _sda;
+    delay();
+    scl_release();
+    delay();
+    _gpio->FIOSET = _sda;
+    delay();
+}
+
+/**
+ * @brief Send one byte on all buses.
+ *
+ * @return SDA lines pulled low by the slaves during the acknowledge bit
+ */
+uint32_t LockstepI2C::write_byte(char value)
+{
+    for (int b = 7; b >= 0; --b) {
+        if (value & (1 << b))
+            _gpio->FIOSET = _sda;
+        else
+            _gpio->FIOCLR = _sda;
+        delay();
+        scl_release();
+        delay();
+        _gpio->FIOCLR = _scl;
+    }
+
+    _gpio->FIOSET = _sda;
+    delay();
+    scl_release();
+    uint32_t acked = ~_gpio->FIOPIN & _sda;
+    delay();
+    _gpio->FIOCLR = _scl;
+
+    return acked;
+}
+
+/**
+ * @brief Receive one byte on all buses.
+ *
+ * @param[out] planes bit planes of the byte, in bus order
+ * @param[in] ack acknowledge the byte on all buses
+ */
+void LockstepI2C::read_byte(uint32_t *planes, bool ack)
+{
+    _gpio->FIOSET = _sda;
+    for (int b = 7; b >= 0; --b) {
+        delay();
+        scl_release();
+        planes[b] = to_bus_mask(_gpio->FIOPIN & _sda);
+        delay();
+        _gpio->FIOCLR = _scl;
+    }
+
+    if (ack)
+        _gpio->FIOCLR = _sda;
+    delay();
+    scl_release();
+    delay();
+    _gpio->FIOCLR = _scl;
+    _gpio->FIOSET = _sda;
+}
+
+/**
+ * @brief Convert SDA lines to a mask of bus numbers.
+ */
+uint32_t LockstepI2C::to_bus_mask(uint32_t sda)
+{
+    uint32_t mask = 0;
+
+    for (int i = 0; i < _count; ++i)
+        if (sda & (1UL << _sda_pin[i]))
+            mask |= 1UL << i;
+
+    return mask;
+}
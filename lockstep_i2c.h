@@ -0,0 +1,105 @@
+/**
+ * Bit-banged I2C master driving several buses in lockstep.
+ *
+ * All SCL and SDA lines are on the same GPIO port and are configured in open
+ * drain mode: writing a 1 releases the line, writing a 0 pulls it low. This
+ * means that all lines can be moved with a single FIOSET/FIOCLR write and
+ * all SDA lines sampled with a single FIOPIN read.
+ *
+ * Bus n uses the n-th lowest bit of scl_mask as SCL and the n-th lowest bit of
+ * sda_mask as SDA. Each bus is connected to one board under test and all
+ * boards receive the same transaction at the same time. Results are returned
+ * in bit-sliced form: bit n of a mask holds the result of bus n.
+ */
+
+#ifndef LOCKSTEP_I2C_H
+#define LOCKSTEP_I2C_H
+
+#include "mbed.h"
+
+#define LOCKSTEP_I2C_MAX_BUS        (16)
+
+class LockstepI2C {
+public:
+    /**
+     * @brief Configure the pins of all buses.
+     *
+     * @param[in] port GPIO port holding all lines
+     * @param[in] scl_mask SCL line of each bus
+     * @param[in] sda_mask SDA line of each bus, must have as many bits set as
+     * scl_mask
+     */
+    LockstepI2C(PortName port, uint32_t scl_mask, uint32_t sda_mask);
+
+    /**
+     * @brief Set the frequency of the buses.
+     *
+     * The frequency is approximate, boards stretching the clock slow down
+     * all buses.
+     *
+     * @param[in] hz bus frequency in hertz
+     */
+    void frequency(int hz);
+
+    /**
+     * @brief Write the same bytes to the slave of every bus.
+     *
+     * The transaction is always completed on every bus even if some of
+     * them do not acknowledge.
+     *
+     * @param[in] address 8-bit I2C slave address
+     * @param[in] data bytes to send
+     * @param[in] length number of bytes to send
+     * @param[in] repeated do not send a stop condition at the end
+     * @return Mask of the buses whose slave acknowledged every byte
+     */
+    uint32_t write(int address, const char *data, int length, bool repeated = false);
+
+    /**
+     * @brief Read bytes from the slave of every bus.
+     *
+     * planes[i * 8 + b] holds bit b of byte i of every bus. Use byte() to
+     * retrieve the bytes of one bus.
+     *
+     * @param[in] address 8-bit I2C slave address
+     * @param[out] planes bit planes of the bytes read (length * 8 entries)
+     * @param[in] length number of bytes to read
+     * @param[in] repeated do not send a stop condition at the end
+     * @return Mask of the buses whose slave acknowledged the address
+     */
+    uint32_t read(int address, uint32_t *planes, int length, bool repeated = false);
+
+    /**
+     * @brief Extract the byte read on one bus from its bit planes.
+     *
+     * @param[in] planes 8 bit planes of one byte
+     * @param[in] bus bus number
+     * @return Byte read on the bus
+     */
+    static char byte(const uint32_t *planes, int bus);
+
+    /** @return Number of buses */
+    int count() const { return _count; }
+
+    /** @return Mask with one bit set per bus */
+    uint32_t all() const { return _count == 32 ? 0xFFFFFFFF : (1UL << _count) - 1; }
+
+private:
+    void delay();
+    void scl_release();
+    void start();
+    void stop();
+    uint32_t write_byte(char value);
+    void read_byte(uint32_t *planes, bool ack);
+    uint32_t to_bus_mask(uint32_t sda);
+
+    PortInOut _port;
+    LPC_GPIO_TypeDef *_gpio;
+    uint32_t _scl;
+    uint32_t _sda;
+    int _count;
+    uint8_t _sda_pin[LOCKSTEP_I2C_MAX_BUS];
+    uint32_t _delay_loops;
+};
+
+#endif
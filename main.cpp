@@ -12,14 +12,63 @@
  * 4. write register 5-255 and read registers 0-4
  * 5. write register 5-255 and i2c read
  * 6. write to register 0-4 and perform multiple read
+ * 7. write multiple registers and read all
+ * 8. combinations of start register, burst length, prior invalid write and
+ *    direction, each followed by a burst read of register 0-4
+ *
+ * If POWER_UP_BENCH is enabled, the power of the PIC12LF1552 must be switched
+ * by a load switch controlled by pin 21 (high: powered).
+ *
+ * If FLASH_LOG is enabled, transactions are logged to an SPI NOR flash on
+ * pins 11 (MOSI), 12 (MISO), 13 (SCK) and 14 (CS).
+ *
+ * If REPLAY is enabled, the transaction log REPLAY_FILE on the USB drive of
+ * the mbed is replayed against the board before the tests.
+ *
+ * If LOCKSTEP_TEST is enabled, test 1 is also run on up to 4 extra boards
+ * with bit-banged buses: SCL on pins 8, 7, 6, 5 and SDA on pins 15, 16, 17, 18.
+ *
+ * If MULTI_MASTER_BENCH is enabled, pin 28 (SDA) must be connected to pin 9
+ * and pin 27 (SCL) to pin 10, so that I2C2 is a second master on the bus.
  */
 
 #include "mbed.h"
 #include <stdio.h>
+#include "power_up.h"
+#include "lockstep_i2c.h"
+#include "fast_i2c.h"
+#include "trace.h"
+#include "record.h"
+#include "eth_stream.h"
+#include "stream_frame.h"
+#include "can_report.h"
+#include "flash_log.h"
+#include "reg_watch.h"
+#include "scheduler.h"
+#include "covering.h"
+#include "slave_model.h"
+#include "mem_report.h"
+#include "replay.h"
+#include "verify_policy.h"
+#include "group_verify.h"
+#include "counters.h"
+#include "repro_bundle.h"
+#include "ahb_sram.h"
 
 #define SLAVE_ADDRESS       (0x3A)
+#define I2C_FREQUENCY       (400000)
+
+/** Identifier of this fixture in the result streams */
+#define FIXTURE_ID          (0)
 
+/** Use the direct-register I2C driver instead of mbed::I2C */
+#define FAST_I2C            (0)
+
+#if FAST_I2C
+FastI2C<1, p9, p10> i2c;
+#else
 I2C i2c(p9, p10);
+#endif
 DigitalOut led1(LED1);
 DigitalOut led2(LED2);
 DigitalOut led3(LED3);
@@ -42,7 +91,136 @@ struct test {
 #define TEST_WRITE_INVALID_REG_READ_ZERO_RANDOM (1)
 #define TEST_WRITE_REG_MULTIPLE_READ_RANDOM     (1)
 #define TEST_WRITE_MULTIPLE_REG_READ_RANDOM     (1)
+#define TEST_COMBINATORIAL_STRENGTH             (2)     /* 2: pairwise, 3: 3-way */
+#define TEST_COMBINATORIAL_MAX_BURST            (6)
+#define TEST_COMBINATORIAL_MAX_ROWS             (256)
+
+/**
+ * Read-back policy of tests 3 and 4: VERIFY_POLICY_EVERY_WRITE reads back all
+ * registers after each write, VERIFY_POLICY_PERIODIC and VERIFY_POLICY_RANDOM
+ * only check the register written and read back all registers every
+ * TEST_VERIFY_SWEEP_PERIOD writes (on average if random).
+ */
+#define TEST_VERIFY_POLICY                      (VERIFY_POLICY_EVERY_WRITE)
+#define TEST_VERIFY_SWEEP_PERIOD                (10)
+
+/**
+ * If not 0, tests 3 and 4 instead write registers in groups of this size and
+ * burst read registers 0-4 once per group, replaying the group only when it
+ * does not verify to find the write at fault.
+ */
+#define TEST_VERIFY_GROUP_SIZE                  (0)
+
+/** Seed of the random values of the tests, 0 to seed from the RTC */
+#define TEST_SEED                               (0)
+
+/** Power-up benchmark configuration */
+#define POWER_UP_BENCH                          (0)
+#define POWER_UP_BENCH_CYCLES                   (200)
+#define POWER_UP_BENCH_OFF_TIME_US              (100000)
+#define POWER_UP_BENCH_POLL_INTERVAL_US         (50)
+#define POWER_UP_BENCH_TIMEOUT_US               (1000000)
+#define POWER_UP_BENCH_BUCKET_WIDTH_US          (500)
+
+/** Lockstep test configuration */
+#define LOCKSTEP_TEST                           (0)
+#define LOCKSTEP_TEST_PORT                      (Port0)
+#define LOCKSTEP_TEST_SCL_MASK                  (0x000003C0)    /* P0.6-P0.9 */
+#define LOCKSTEP_TEST_SDA_MASK                  (0x07800000)    /* P0.23-P0.26 */
+#define LOCKSTEP_TEST_FREQUENCY                 (100000)
+#define LOCKSTEP_TEST_COUNT                     (100)
+
+/** I2C driver benchmark configuration */
+#define I2C_DRIVER_BENCH                        (0)
+#define I2C_DRIVER_BENCH_COUNT                  (10000)
+#define I2C_DRIVER_BENCH_FREQUENCY              (400000)
+
+/**
+ * Multi-master benchmark: I2C1 and I2C2 send colliding register traffic to
+ * the board at increasing offered loads (percent of the bus capacity)
+ */
+#define MULTI_MASTER_BENCH                      (0)
+#define MULTI_MASTER_BENCH_FREQUENCY            (400000)
+#define MULTI_MASTER_BENCH_SLOTS                (20000)     /* per offered load */
+#define MULTI_MASTER_BENCH_BACKLOG              (8)
+#define MULTI_MASTER_BENCH_TIMEOUT_US           (10000)
+#define MULTI_MASTER_BENCH_BUCKET_WIDTH_US      (20)
+
+/** Run background tasks while FastI2C waits for the bus */
+#define SCHEDULER                               (0)
+#define SCHEDULER_FLASH_LOG_TURN_US             (15)    /* one SPI command of flash_log_step() */
+#define SCHEDULER_BENCH                         (0)
+#define SCHEDULER_BENCH_FREQUENCY               (100000)
+#define SCHEDULER_BENCH_CALIBRATION_US          (100000)
+
+#if SCHEDULER && !FAST_I2C
+#error "SCHEDULER requires FAST_I2C"
+#endif
+
+/** Stream results and transactions as raw Ethernet frames */
+#define ETH_STREAM                              (0)
+
+/**
+ * Snapshot the live counters (see counters.h) into the Ethernet stream every
+ * COUNTERS_PERIOD_US, for the dashboard of host/eth_recv -l
+ */
+#define COUNTERS                                (0)
+#define COUNTERS_PERIOD_US                      (250000)
+
+#if COUNTERS && !ETH_STREAM
+#error "COUNTERS requires ETH_STREAM"
+#endif
+
+#if COUNTERS
+Ticker counters_ticker;
+#endif
+
+/** Publish results on a CAN bus (pins 30 and 29) */
+#define CAN_REPORT                              (0)
+#define CAN_REPORT_FREQUENCY                    (500000)
+
+/** Log transactions to an SPI NOR flash */
+#define FLASH_LOG                               (0)
+#define FLASH_LOG_SIZE                          (2 * 1024 * 1024)
+#define FLASH_LOG_SPI_FREQUENCY                 (20000000)
+
+#if FLASH_LOG
+SPI flash_spi(p11, p12, p13);
+DigitalOut flash_cs(p14, 1);
+#endif
+
+/** Watch the registers in the background while the tests run */
+#define REG_WATCH                               (0)
+#define REG_WATCH_MIN_PERIOD_US                 (1000)
+#define REG_WATCH_MAX_PERIOD_US                 (100000)
+
+#if REG_WATCH
+Ticker reg_watch_ticker;
+#endif
 
+/** Print the packed history of the flight recorder when a test fails */
+#define TRACE_DUMP                              (0)
+
+/**
+ * Print a reproduction bundle when a test fails: seed, test, iteration,
+ * configuration and the last REPRO_BUNDLE_BLOCKS blocks of the packed history,
+ * to be replayed by host/repro from the console log.
+ */
+#define REPRO_BUNDLE                            (0)
+#define REPRO_BUNDLE_BLOCKS                     (TRACE_HISTORY_BLOCKS)
+
+/** Print the RAM usage (stack high-water mark, heap, static buffers) at the end */
+#define MEMORY_REPORT                           (0)
+
+/** Replay a transaction log from the USB drive of the mbed before the tests */
+#define REPLAY                                  (0)
+#define REPLAY_FILE                             "/local/replay.bin"
+#define REPLAY_TIMED                            (0)     /* 0: as fast as possible */
+#define REPLAY_MAX_PRINTED                      (10)
+
+#if REPLAY
+LocalFileSystem local("local");
+#endif
 
 /**
  * @brief Show a number in binary form using the 4 LED's present on the board.
@@ -65,18 +243,245 @@ static void led_show_number(char c)
         led4 = 1;
 }
 
+/** Test being run and its counters */
+static uint32_t test_seed;
+static int current_test;
+static uint32_t test_transactions;
+static uint32_t test_nacks;
+
+/**
+ * Set while a test runs. The register watch must not use the bus then, except
+ * between two iterations, since a test may rely on the current register of
+ * the slave between two transactions.
+ */
+static volatile bool bus_owned;
+
+/** Time spent in transactions by the tests, reset by the register watch */
+static volatile uint32_t bus_busy_us;
+
+#if REG_WATCH
+static volatile bool reg_watch_pending;
+static uint32_t reg_watch_period_us;
+static uint32_t reg_watch_sample_us;
+static uint32_t reg_watch_last_tick_us;
+
+/**
+ * @brief Read back registers 0-4 and compare them with the shadow.
+ *
+ * The transactions are not traced: they do not belong to a test.
+ */
+static void reg_watch_sample(void)
+{
+    char reg = 0;
+    char regs[REG_WATCH_REGISTER_COUNT];
+    uint32_t start = us_ticker_read();
+
+#if FAST_I2C
+    /* Background tasks must not run from the ticker interrupt */
+    fast_i2c_idle idle = i2c.idle();
+    i2c.on_idle(NULL);
+#endif
+
+    bool acked = i2c.write(SLAVE_ADDRESS, &reg, 1) == 0
+              && i2c.read(SLAVE_ADDRESS, regs, sizeof(regs)) == 0;
+    uint32_t end = us_ticker_read();
+
+#if FAST_I2C
+    i2c.on_idle(idle);
+#endif
+
+    reg_watch_check(end, acked ? regs : NULL);
+    reg_watch_sample_us = end - start;
+}
+
+/**
+ * @brief Sample the registers if the bus is free, otherwise leave the sample
+ * to the next iteration of the test, and adapt the period to the bus load.
+ */
+static void reg_watch_tick(void)
+{
+    uint32_t now = us_ticker_read();
+    uint32_t period = reg_watch_adapt(now - reg_watch_last_tick_us, bus_busy_us,
+                                      reg_watch_sample_us);
+
+    reg_watch_last_tick_us = now;
+    bus_busy_us = 0;
+
+    if (bus_owned)
+        reg_watch_pending = true;
+    else
+        reg_watch_sample();
+
+    if (period != reg_watch_period_us) {
+        reg_watch_period_us = period;
+        reg_watch_ticker.attach_us(&reg_watch_tick, period);
+    }
+}
+
+/**
+ * @brief Take the sample left by reg_watch_tick() while the bus was owned.
+ */
+static void reg_watch_poll(void)
+{
+    if (reg_watch_pending) {
+        reg_watch_pending = false;
+        reg_watch_sample();
+    }
+}
+
+static void reg_watch_start(void)
+{
+    reg_watch_period_us = reg_watch_init(REG_WATCH_MIN_PERIOD_US, REG_WATCH_MAX_PERIOD_US);
+    reg_watch_last_tick_us = us_ticker_read();
+    reg_watch_ticker.attach_us(&reg_watch_tick, reg_watch_period_us);
+}
+#endif
+
+#if COUNTERS
+static struct counters_snapshot counters_last;
+static volatile bool counters_pending;
+
+/**
+ * @brief Take a snapshot of the counters, unless the previous one was not
+ * sent yet. The Ethernet stream is not reentrant, the snapshot is sent by
+ * counters_poll().
+ */
+static void counters_tick(void)
+{
+    if (!counters_pending) {
+        counters_snapshot(&counters_last, us_ticker_read());
+        counters_pending = true;
+    }
+}
+
+/**
+ * @brief Send the snapshot taken by counters_tick(), with the summary of the
+ * durations at this time.
+ */
+static void counters_poll(void)
+{
+    if (counters_pending) {
+        uint8_t record[RECORD_MAX_SIZE];
+
+        counters_summarize(&counters_last);
+        eth_stream_write(record, record_encode_counters(record, counters_last.timestamp_us,
+                                                        counters_last.values, COUNTER_COUNT));
+        eth_stream_flush();
+        counters_pending = false;
+    }
+}
+#endif
+
+/**
+ * @brief Called after each transaction with the slave.
+ *
+ * The transaction is stored in the flight recorder and streamed if enabled.
+ */
+static void on_transaction(uint8_t flags, const char *data, int length)
+{
+    ++test_transactions;
+    counter_add(COUNTER_TRANSACTIONS, 1);
+    counter_add(COUNTER_BYTES, length);
+    if (flags & TRACE_NACK) {
+        ++test_nacks;
+        counter_add(COUNTER_NACKS, 1);
+    }
+
+    trace_record(us_ticker_read(), SLAVE_ADDRESS, flags, data, length);
+
+#if ETH_STREAM
+    eth_stream_trace();
+#endif
+
+#if FLASH_LOG
+    flash_log_trace();
+#endif
+
+#if REG_WATCH
+    if (!(flags & (TRACE_READ | TRACE_NACK)))
+        reg_watch_write(data, length);
+#endif
+
+#if COUNTERS
+    counters_poll();
+#endif
+}
+
+/**
+ * @brief Called at the start of each iteration of a test.
+ *
+ * @param[in] iteration iteration number (starting from 0)
+ */
+static void on_iteration(int iteration)
+{
+    counter_add(COUNTER_ITERATIONS, 1);
+    counter_set(COUNTER_TEST_ITERATION, iteration);
+
+#if ETH_STREAM
+    uint8_t record[RECORD_MAX_SIZE];
+    eth_stream_write(record, record_encode_iteration(record, current_test, iteration));
+#endif
+
+#if FLASH_LOG
+    flash_log_mark(current_test, iteration);
+#endif
+
+#if REG_WATCH
+    reg_watch_poll();
+#endif
+}
+
+static int slave_write(const char *data, int length)
+{
+    uint32_t start = us_ticker_read();
+    int ret = i2c.write(SLAVE_ADDRESS, data, length);
+    uint32_t elapsed = us_ticker_read() - start;
+
+    bus_busy_us += elapsed;
+    counters_add_duration(elapsed);
+    on_transaction(ret ? TRACE_NACK : 0, data, length);
+    return ret;
+}
+
+static int slave_read(char *data, int length)
+{
+    uint32_t start = us_ticker_read();
+    int ret = i2c.read(SLAVE_ADDRESS, data, length);
+    uint32_t elapsed = us_ticker_read() - start;
+
+    bus_busy_us += elapsed;
+    counters_add_duration(elapsed);
+    on_transaction(TRACE_READ | (ret ? TRACE_NACK : 0), data, length);
+    return ret;
+}
+
 static bool write_register(char addr, char val)
 {
     char data[2] = {addr, val};
 
-    return i2c.write(SLAVE_ADDRESS, data, sizeof(data)) == 0;
+    return slave_write(data, sizeof(data)) == 0;
 }
 
 static bool read_register(char addr, char *val)
 {
-    return i2c.write(SLAVE_ADDRESS, &addr, 1) == 0
-        && i2c.read(SLAVE_ADDRESS, val, 1) == 0;
+    return slave_write(&addr, 1) == 0
+        && slave_read(val, 1) == 0;
+}
+
+#if !TEST_VERIFY_GROUP_SIZE
+static bool check_register(int addr, char expected_value)
+{
+    char value = 0;
+
+    if (!read_register(addr, &value))
+        return false;
+
+    if (addr == 0)
+        return (value & 0x0F) == (expected_value & 0x0F);
+
+    return value == expected_value;
 }
+#endif
 
 static bool check_all_register(char *expected_values)
 {
@@ -112,6 +517,7 @@ static bool test_write_read_reg_1_4(void)
     for (int i = 0; i < TEST_WRITE_READ_REG_1_4_COUNT; ++i) {
         char reg_address, value;
 
+        on_iteration(i);
 #if TEST_WRITE_READ_REG_1_4_RANDOM
         reg_address = (rand() % 4) + 1;
         value = rand();
@@ -145,6 +551,8 @@ static bool test_write_read_reg_0(void)
 {
     for (int i = 0; i < TEST_WRITE_READ_REG_0_COUNT; ++i) {
         char value;
+
+        on_iteration(i);
 #if TEST_WRITE_READ_REG_0_RANDOM
         value = rand();
 #else
@@ -164,6 +572,108 @@ static bool test_write_read_reg_0(void)
     return true;
 }
 
+#if TEST_VERIFY_GROUP_SIZE
+static struct group_verify write_reg_read_all_group;
+static struct group_verify write_invalid_reg_read_all_group;
+
+static bool group_write(uint8_t reg, uint8_t value)
+{
+    return write_register(reg, value);
+}
+
+static bool group_restore(const char *regs)
+{
+    char data[6] = {0, regs[0], regs[1], regs[2], regs[3], regs[4]};
+
+    counter_add(COUNTER_RETRIES, 1);
+    return slave_write(data, sizeof(data)) == 0;
+}
+
+static bool group_read_all(char *regs)
+{
+    char addr = 0;
+
+    return slave_write(&addr, 1) == 0
+        && slave_read(regs, 5) == 0;
+}
+
+static const struct group_verify_ops group_ops = {
+    group_write,
+    group_restore,
+    group_read_all
+};
+
+/**
+ * @brief Report the write found by the replay of a group which did not verify.
+ */
+static bool group_failed(const struct group_verify *g)
+{
+    if (g->failed_write == GROUP_VERIFY_NOT_FOUND)
+        fprintf(stderr, "Group of writes did not verify, %s\n",
+                g->reproduced ? "transaction failed" : "not reproduced by the replay");
+    else if (g->nacked)
+        fprintf(stderr, "Write %lu (register %d = %02X) not acknowledged\n",
+                (unsigned long)g->failed_write, g->failed.reg, g->failed.value);
+    else
+        fprintf(stderr, "Write %lu (register %d = %02X) changed the registers\n",
+                (unsigned long)g->failed_write, g->failed.reg, g->failed.value);
+    return false;
+}
+#else
+/** Read-back statistics of tests 3 and 4 */
+static struct verify_policy write_reg_read_all_policy;
+static struct verify_policy write_invalid_reg_read_all_policy;
+
+/**
+ * @brief Seed of the random read-back schedule.
+ *
+ * Only the random policy draws it, so that with the other policies the tests
+ * get the same random values from a seed as before the policies existed.
+ */
+static uint32_t verify_seed(void)
+{
+    return TEST_VERIFY_POLICY == VERIFY_POLICY_RANDOM ? rand() : 1;
+}
+
+/**
+ * @brief Read back all registers if the policy asks for it.
+ *
+ * @param[in] policy read-back policy of the test
+ * @param[in] regs expected values of register 0-4
+ * @param[in] spot_reg register checked alone otherwise
+ * @return True if successful, false otherwise
+ */
+static bool verify_after_write(struct verify_policy *policy, char *regs, int spot_reg)
+{
+    if (!verify_policy_after_write(policy))
+        return check_register(spot_reg, regs[spot_reg]);
+
+    if (check_all_register(regs))
+        return true;
+
+    if (verify_policy_gap(policy) > 1)
+        fprintf(stderr, "Register mismatch caused by one of the last %u writes\n",
+                verify_policy_gap(policy));
+    return false;
+}
+
+/**
+ * @brief Read back all registers at the end of a test if not done yet.
+ */
+static bool verify_finish(struct verify_policy *policy, char *regs)
+{
+    if (!verify_policy_finish(policy))
+        return true;
+
+    if (check_all_register(regs))
+        return true;
+
+    fprintf(stderr, "Register mismatch caused by one of the last %u writes\n",
+            verify_policy_gap(policy));
+    return false;
+}
+#endif
+
 /**
  * @brief Check that a write to one register does not affect other registers
  *
@@ -173,25 +683,45 @@ static bool test_write_reg_read_all(void)
 {
     char regs[5] = {0, 0, 0, 0, 0};
 
+#if !TEST_VERIFY_GROUP_SIZE
+    struct verify_policy *policy = &write_reg_read_all_policy;
+    verify_policy_init(policy, TEST_VERIFY_POLICY, TEST_VERIFY_SWEEP_PERIOD, verify_seed());
+#endif
+
     /* Ensure all registers are set to 0 at the beginning */
     for (int i = 0; i < 5; ++i)
         if (!write_register(i, 0))
             return false;
 
+#if TEST_VERIFY_GROUP_SIZE
+    struct group_verify *group = &write_reg_read_all_group;
+    group_verify_init(group, &group_ops, TEST_VERIFY_GROUP_SIZE, regs);
+#endif
+
     for (int i = 0; i < TEST_WRITE_REG_READ_ALL_COUNT; ++i) {
         int reg_address;
 
+        on_iteration(i);
         reg_address = rand() % 5;
         regs[reg_address] = rand();
 
+#if TEST_VERIFY_GROUP_SIZE
+        if (!group_verify_write(group, reg_address, regs[reg_address]))
+            return group_failed(group);
+#else
         if (!write_register(reg_address, regs[reg_address]))
             return false;
 
-        if (!check_all_register(regs))
+        if (!verify_after_write(policy, regs, reg_address))
             return false;
+#endif
     }
 
-    return true;
+#if TEST_VERIFY_GROUP_SIZE
+    return group_verify_flush(group) || group_failed(group);
+#else
+    return verify_finish(policy, regs);
+#endif
 }
 
 /**
@@ -205,6 +735,11 @@ static bool test_write_invalid_reg_read_all(void)
 {
     char regs[5];
 
+#if !TEST_VERIFY_GROUP_SIZE
+    struct verify_policy *policy = &write_invalid_reg_read_all_policy;
+    verify_policy_init(policy, TEST_VERIFY_POLICY, TEST_VERIFY_SWEEP_PERIOD, verify_seed());
+#endif
+
     /* Write values to register 0-4 */
     for (int i = 0; i < 5; ++i) {
 #if TEST_WRITE_INVALID_REG_READ_ALL_RANDOM
@@ -216,9 +751,15 @@ static bool test_write_invalid_reg_read_all(void)
             return false;
     }
 
+#if TEST_VERIFY_GROUP_SIZE
+    struct group_verify *group = &write_invalid_reg_read_all_group;
+    group_verify_init(group, &group_ops, TEST_VERIFY_GROUP_SIZE, regs);
+#endif
+
     for (int i = 0; i < TEST_WRITE_INVALID_REG_READ_ALL_COUNT; ++i) {
         char reg_address, value;
 
+        on_iteration(i);
 #if TEST_WRITE_INVALID_REG_READ_ALL_RANDOM
         reg_address = (rand() % 250) + 5;
         value = rand();
@@ -227,14 +768,25 @@ static bool test_write_invalid_reg_read_all(void)
         value = i;
 #endif
 
+#if TEST_VERIFY_GROUP_SIZE
+        if (!group_verify_write(group, reg_address, value))
+            return group_failed(group);
+#else
         if (!write_register(reg_address, value))
             return false;
 
-        if (!check_all_register(regs))
+        /* The register written does not exist: spot checks go through
+         * register 0-4 in turn */
+        if (!verify_after_write(policy, regs, i % 5))
             return false;
+#endif
     }
 
-    return true;
+#if TEST_VERIFY_GROUP_SIZE
+    return group_verify_flush(group) || group_failed(group);
+#else
+    return verify_finish(policy, regs);
+#endif
 }
 
 /**
@@ -250,6 +802,7 @@ static bool test_write_invalid_reg_read_zero(void)
     for (int i = 0; i < TEST_WRITE_INVALID_REG_READ_ZERO_COUNT; ++i) {
         char reg_address, value;
 
+        on_iteration(i);
 #if TEST_WRITE_INVALID_REG_READ_ZERO_RANDOM
         reg_address = (rand() % 250) + 5;
         value = rand();
@@ -262,7 +815,7 @@ static bool test_write_invalid_reg_read_zero(void)
             return false;
 
         char value_received = 0xFF;
-        if (i2c.read(SLAVE_ADDRESS, &value_received, sizeof(value_received)) != 0)
+        if (slave_read(&value_received, sizeof(value_received)) != 0)
             return false;
 
         if (value_received != 0)
@@ -297,8 +850,8 @@ static bool test_write_reg_multiple_read(void)
 
     char data[10];
     memset(data, 0, sizeof(data));
-    if (i2c.write(SLAVE_ADDRESS, data, 1) != 0      /* Reset current_reg to 0 */
-    ||  i2c.read(SLAVE_ADDRESS, data, sizeof(data)) != 0)
+    if (slave_write(data, 1) != 0       /* Reset current_reg to 0 */
+    ||  slave_read(data, sizeof(data)) != 0)
         return false;
 
     for (int i = 0; i < 5; ++i) {
@@ -346,75 +899,1051 @@ static bool test_write_multiple_reg_read(void)
 #endif
     }
 
-    if (i2c.write(SLAVE_ADDRESS, data, sizeof(data)) != 0)
+    if (slave_write(data, sizeof(data)) != 0)
         return false;
 
     return check_all_register(&data[1]);
 }
 
+/* Factors of the combinatorial test */
+#define COMBINATORIAL_START         (0)
+#define COMBINATORIAL_LENGTH        (1)
+#define COMBINATORIAL_PRIOR         (2)
+#define COMBINATORIAL_DIRECTION     (3)
+#define COMBINATORIAL_FACTORS       (4)
+
+/* Levels of the prior invalid write */
+#define PRIOR_NONE                  (0)
+#define PRIOR_DATA                  (1)     /* invalid register and a value */
+#define PRIOR_ADDRESS               (2)     /* invalid register only */
+
 /**
- * @brief Run all tests.
- *
- * @return 0 if all tests are successful, otherwise return the first test number
- * (greater or equal to 1) that failed.
+ * @brief Write to the slave and apply the write to the model.
  */
-static int run_tests(struct test *tests)
+static bool combinatorial_write(struct slave_model *model, const char *data, int length)
 {
-    int n = 0;
+    if (slave_write(data, length) != 0)
+        return false;
 
-    if (tests == NULL)
-        return 0;
+    slave_model_write(model, data, length, 0);
+    return true;
+}
 
-    while (tests[n].name != NULL && tests[n].f != NULL) {
-        printf("test %d: %s: ", n + 1, tests[n].name);
-        if (!tests[n].f()) {
-            printf("FAIL\n");
-            return n+1;
-        }
+/**
+ * @brief Compare a burst read from the slave with the model.
+ *
+ * Only the lower half of register 0 is compared.
+ */
+static bool combinatorial_compare(const char *data, const char *expected, int length,
+                                  unsigned char first_reg)
+{
+    for (int i = 0; i < length; ++i) {
+        char mask = first_reg + i == 0 ? 0x0F : 0xFF;
 
-        printf("PASS\n");
-        ++n;
+        if ((data[i] & mask) != (expected[i] & mask)) {
+            fprintf(stderr, "Read %02X at offset %d from register %d, expected %02X\n",
+                    data[i], i, first_reg, expected[i]);
+            return false;
+        }
     }
 
-    return 0;
+    return true;
 }
 
 /**
- * @brief Flash all LED's present on the board.
+ * @brief Cover the combinations of start register, burst length, prior
+ * invalid write and direction.
  *
- * This function is used to indicate that all tests were successfull without
- * having to look at the UART output.
+ * A covering array gives the scenarios so that every combination of any 2
+ * (or 3) factors is tried once, in far fewer transactions than trying them
+ * all or sampling them at random. Each scenario starts from random values in
+ * registers 0-4 and ends with a burst read of registers 0-4. The expected
+ * values come from the model of the firmware.
+ *
+ * @return True if successful, false otherwise
  */
-static void flash_all_leds(void)
+static bool test_combinatorial(void)
 {
-    while (1) {
-        led1 = led2 = led3 = led4 = !led1;
-        wait_ms(100);
-    }
-}
+    static const unsigned char start_registers[] = {0, 1, 2, 3, 4, 5, 255};
+    static const uint8_t levels[COMBINATORIAL_FACTORS] = {
+        sizeof(start_registers), TEST_COMBINATORIAL_MAX_BURST, 3, 2
+    };
+    static uint8_t rows[TEST_COMBINATORIAL_MAX_ROWS * COMBINATORIAL_FACTORS] AHB_SRAM0;
+    struct slave_model model;
 
-int main()
-{
-    srand(time(NULL));
-    i2c.frequency(400000);
+    int row_count = covering_generate(levels, COMBINATORIAL_FACTORS, TEST_COMBINATORIAL_STRENGTH,
+                                      rows, TEST_COMBINATORIAL_MAX_ROWS);
+    if (row_count == 0)
+        return false;
 
-    led1 = 0;
-    led2 = 0;
-    led3 = 0;
-    led4 = 0;
+    slave_model_init(&model, 0, 0);
+    for (int i = 0; i < row_count; ++i) {
+        const uint8_t *row = &rows[i * COMBINATORIAL_FACTORS];
+        unsigned char start = start_registers[row[COMBINATORIAL_START]];
+        int length = row[COMBINATORIAL_LENGTH] + 1;
+        char data[TEST_COMBINATORIAL_MAX_BURST + 1];
+        char expected[TEST_COMBINATORIAL_MAX_BURST];
 
-    struct test tests[] = {
-        {"write/read registers 1-4", test_write_read_reg_1_4},
-        {"write/read register 0", test_write_read_reg_0},
-        {"write reg/read all", test_write_reg_read_all},
+        on_iteration(i);
+
+        data[0] = 0;
+        for (int j = 1; j <= 5; ++j)
+            data[j] = rand();
+        if (!combinatorial_write(&model, data, 6))
+            return false;
+
+        if (row[COMBINATORIAL_PRIOR] != PRIOR_NONE) {
+            data[0] = (rand() % 250) + 5;
+            data[1] = rand();
+            if (!combinatorial_write(&model, data, row[COMBINATORIAL_PRIOR] == PRIOR_DATA ? 2 : 1))
+                return false;
+        }
+
+        data[0] = start;
+        if (row[COMBINATORIAL_DIRECTION] == 0) {
+            for (int j = 1; j <= length; ++j)
+                data[j] = rand();
+            if (!combinatorial_write(&model, data, length + 1))
+                return false;
+        } else {
+            if (!combinatorial_write(&model, data, 1)
+            ||  slave_read(data, length) != 0)
+                return false;
+
+            slave_model_read(&model, expected, length, 0);
+            if (!combinatorial_compare(data, expected, length, start))
+                return false;
+        }
+
+        /* Burst verification of registers 0-4 */
+        data[0] = 0;
+        if (!combinatorial_write(&model, data, 1)
+        ||  slave_read(data, 5) != 0)
+            return false;
+
+        slave_model_read(&model, expected, 5, 0);
+        if (!combinatorial_compare(data, expected, 5, 0))
+            return false;
+    }
+
+    return true;
+}
+
+#if POWER_UP_BENCH
+/* Load switch of the board, powered from boot */
+DigitalOut dut_power(p21, 1);
+
+static void power_up_set_power(bool on)
+{
+    dut_power = on;
+}
+
+static int power_up_write(const char *data, int length)
+{
+    return i2c.write(SLAVE_ADDRESS, data, length);
+}
+
+static int power_up_read(char *data, int length)
+{
+    return i2c.read(SLAVE_ADDRESS, data, length);
+}
+
+static void power_up_wait_us(uint32_t us)
+{
+    wait_us(us);
+}
+
+/**
+ * @brief Measure how long the board takes to be ready after power-up.
+ *
+ * The board is left powered so that the tests can run afterwards.
+ */
+static void power_up_bench(void)
+{
+    static const struct power_up_ops ops = {
+        power_up_set_power,
+        power_up_write,
+        power_up_read,
+        us_ticker_read,
+        power_up_wait_us
+    };
+    static const struct power_up_config config = {
+        POWER_UP_BENCH_CYCLES,
+        POWER_UP_BENCH_OFF_TIME_US,
+        POWER_UP_BENCH_POLL_INTERVAL_US,
+        POWER_UP_BENCH_TIMEOUT_US,
+        POWER_UP_BENCH_BUCKET_WIDTH_US
+    };
+    static struct power_up_result result;
+
+    printf("power-up benchmark: %d cycles\n", POWER_UP_BENCH_CYCLES);
+    power_up_run(&ops, &config, &result);
+    power_up_print(&result);
+}
+#endif
+
+#if LOCKSTEP_TEST
+/**
+ * @brief Write and read values to register 1-4 on all lockstep buses.
+ *
+ * This is test 1 run on all boards at the same time. A board is considered
+ * failed as soon as one of its i2c operations fails or if it returns a value
+ * different from the one written.
+ *
+ * @param[in] bus lockstep buses
+ * @return Mask of the boards that passed the test
+ */
+static uint32_t lockstep_test_write_read_reg_1_4(LockstepI2C &bus)
+{
+    uint32_t passed = bus.all();
+
+    for (int i = 0; i < LOCKSTEP_TEST_COUNT && passed; ++i) {
+        char reg_address = (rand() % 4) + 1;
+        char value = rand();
+        char data[2] = {reg_address, value};
+        uint32_t planes[8];
+
+        passed &= bus.write(SLAVE_ADDRESS, data, sizeof(data));
+        passed &= bus.write(SLAVE_ADDRESS, &reg_address, 1);
+        passed &= bus.read(SLAVE_ADDRESS, planes, 1);
+
+        /* Compare all boards at once, one bit plane at a time */
+        for (int b = 0; b < 8; ++b)
+            passed &= ~(planes[b] ^ ((value & (1 << b)) ? bus.all() : 0));
+    }
+
+    return passed;
+}
+
+static void lockstep_test(void)
+{
+    LockstepI2C bus(LOCKSTEP_TEST_PORT, LOCKSTEP_TEST_SCL_MASK, LOCKSTEP_TEST_SDA_MASK);
+    bus.frequency(LOCKSTEP_TEST_FREQUENCY);
+
+    uint32_t passed = lockstep_test_write_read_reg_1_4(bus);
+    for (int i = 0; i < bus.count(); ++i)
+        printf("lockstep board %d: %s\n", i, (passed & (1UL << i)) ? "PASS" : "FAIL");
+}
+#endif
+
+/**
+ * @brief Write and read back register 1 many times with one driver.
+ *
+ * Each iteration performs 3 transactions: a register write, a register
+ * address write and a 1-byte read.
+ *
+ * @param[in] bus I2C driver
+ * @return Elapsed time in microseconds, 0 if one of the transactions failed
+ */
+template <class Bus>
+static uint32_t i2c_driver_bench_run(Bus &bus)
+{
+    uint32_t start = us_ticker_read();
+
+    for (int i = 0; i < I2C_DRIVER_BENCH_COUNT; ++i) {
+        char data[2] = {1, (char)i};
+        char value;
+
+        if (bus.write(SLAVE_ADDRESS, data, sizeof(data)) != 0
+        ||  bus.write(SLAVE_ADDRESS, data, 1) != 0
+        ||  bus.read(SLAVE_ADDRESS, &value, 1) != 0)
+            return 0;
+    }
+
+    return us_ticker_read() - start;
+}
+
+#if I2C_DRIVER_BENCH
+static void i2c_driver_bench_print(const char *name, uint32_t elapsed)
+{
+    /* 7 bytes of 9 bits and a start and stop condition per transaction */
+    const uint32_t wire_ns = (7 * 9 + 3 * 2) * (1000000000 / I2C_DRIVER_BENCH_FREQUENCY);
+    const uint32_t transactions = I2C_DRIVER_BENCH_COUNT * 3;
+
+    if (elapsed == 0) {
+        printf("%s: transaction failed\n", name);
+        return;
+    }
+
+    uint32_t per_transaction_ns = (uint32_t)((uint64_t)elapsed * 1000 / transactions);
+    printf("%s: %lu ns per transaction, %lu ns overhead\n", name,
+           (unsigned long)per_transaction_ns,
+           (unsigned long)(per_transaction_ns - wire_ns / 3));
+}
+
+/**
+ * @brief Compare the time per transaction of mbed::I2C and FastI2C.
+ *
+ * The overhead is the time per transaction minus the time needed to clock
+ * the bits on the bus. The global driver is used for its own type, so that
+ * there is only one FastI2C object for I2C1.
+ */
+static void i2c_driver_bench(void)
+{
+    uint32_t mbed_elapsed, fast_elapsed;
+
+#if FAST_I2C
+    {
+        I2C bus(p9, p10);
+        bus.frequency(I2C_DRIVER_BENCH_FREQUENCY);
+        mbed_elapsed = i2c_driver_bench_run(bus);
+    }
+    i2c.frequency(I2C_DRIVER_BENCH_FREQUENCY);
+    fast_elapsed = i2c_driver_bench_run(i2c);
+#else
+    i2c.frequency(I2C_DRIVER_BENCH_FREQUENCY);
+    mbed_elapsed = i2c_driver_bench_run(i2c);
+    {
+        FastI2C<1, p9, p10> bus;
+        bus.frequency(I2C_DRIVER_BENCH_FREQUENCY);
+        fast_elapsed = i2c_driver_bench_run(bus);
+    }
+#endif
+    i2c.frequency(I2C_FREQUENCY);
+
+    i2c_driver_bench_print("mbed::I2C", mbed_elapsed);
+    i2c_driver_bench_print("FastI2C", fast_elapsed);
+}
+#endif
+
+#if MULTI_MASTER_BENCH
+/** One of the masters of the multi-master benchmark */
+struct multi_master {
+    int id;                         /* 1 or 2 */
+    char data[2];
+    int length;
+    bool read;
+    bool active;
+    bool lost;                      /* the transaction lost the arbitration at least once */
+    uint32_t started_us;
+    uint32_t lost_us;
+    uint32_t backlog;               /* transactions offered while busy */
+
+    uint32_t offered;
+    uint32_t completed;
+    uint32_t bytes;
+    uint32_t losses;
+    uint32_t dropped;               /* offered with a full backlog */
+    uint32_t mismatches;            /* reads differing from the golden model */
+    uint32_t errors;                /* NACK'ed or timed out */
+};
+
+/**
+ * @brief Prepare the next transaction of a master.
+ *
+ * The traffic of both masters is chosen so that two colliding transactions
+ * always differ, and one master loses the arbitration:
+ *  - master 1 writes even values and reads 1 byte,
+ *  - master 2 writes odd values and reads 2 bytes, winning the arbitration
+ *    on the acknowledge bit master 1 leaves high after its only byte.
+ * Writes go to registers 0-5, 5 being invalid.
+ */
+static void multi_master_next(struct multi_master *m)
+{
+    m->read = rand() & 1;
+    if (m->read) {
+        m->length = m->id;
+    } else {
+        m->data[0] = rand() % 6;
+        m->data[1] = m->id == 1 ? rand() & 0xFE : rand() | 0x01;
+        m->length = 2;
+    }
+}
+
+/**
+ * @brief Advance the transaction of a master.
+ *
+ * A transaction which lost the arbitration is started again at once: the
+ * peripheral sends its start condition as soon as the winner releases the
+ * bus. The transactions that complete are applied to the golden model in the
+ * order they end on the bus, and reads are compared with it.
+ */
+template <class Bus>
+static void multi_master_step(Bus &bus, struct multi_master *m, struct slave_model *golden,
+                              struct histogram *recovery)
+{
+    uint32_t now = us_ticker_read();
+
+    if (!m->active) {
+        if (m->backlog == 0)
+            return;
+        --m->backlog;
+        multi_master_next(m);
+        m->active = true;
+        m->started_us = now;
+        bus.start_transfer(SLAVE_ADDRESS, m->data, m->length, m->read);
+        return;
+    }
+
+    int status = bus.poll();
+    if (status == FAST_I2C_PENDING) {
+        if (now - m->started_us > MULTI_MASTER_BENCH_TIMEOUT_US) {
+            ++m->errors;
+            m->active = false;
+            m->lost = false;
+            bus.stop();
+        }
+        return;
+    }
+
+    if (status == FAST_I2C_ARBITRATION_LOST) {
+        ++m->losses;
+        if (!m->lost) {
+            m->lost = true;
+            m->lost_us = now;
+        }
+        bus.start_transfer(SLAVE_ADDRESS, m->data, m->length, m->read);
+        return;
+    }
+
+    m->active = false;
+    if (status != 0) {
+        ++m->errors;
+        m->lost = false;
+        return;
+    }
+
+    if (m->read) {
+        char expected[2];
+        slave_model_read(golden, expected, m->length, 0);
+        if (memcmp(expected, m->data, m->length) != 0)
+            ++m->mismatches;
+    } else {
+        slave_model_write(golden, m->data, m->length, 0);
+    }
+    ++m->completed;
+    m->bytes += m->length;
+    if (m->lost) {
+        histogram_add(recovery, now - m->lost_us);
+        m->lost = false;
+    }
+}
+
+/**
+ * @brief Offer a transaction to a master, queued if it is busy.
+ */
+static void multi_master_offer(struct multi_master *m)
+{
+    ++m->offered;
+    if (m->backlog < MULTI_MASTER_BENCH_BACKLOG)
+        ++m->backlog;
+    else
+        ++m->dropped;
+}
+
+/**
+ * @brief Measure arbitration losses, recovery time and goodput with two
+ * masters on the bus.
+ *
+ * Time is divided in slots of the duration of a register write. At each slot
+ * each master is offered a transaction with a probability of half the
+ * offered load, both masters starting theirs in the same loop iteration so
+ * that their start conditions collide. Registers 0-4 are cleared first so
+ * that the golden model starts from a known state.
+ */
+static void multi_master_bench(void)
+{
+    static const int loads[] = {10, 25, 50, 75, 100, 150, 200};
+    /* 3 bytes of 9 bits and a start and stop condition */
+    const uint32_t slot_us = (3 * 9 + 2) * 1000000 / MULTI_MASTER_BENCH_FREQUENCY;
+#if FAST_I2C
+    FastI2C<1, p9, p10> &master1 = i2c;
+#else
+    FastI2C<1, p9, p10> master1;
+#endif
+    FastI2C<2, p28, p27> master2;
+    static struct histogram recovery;
+    struct slave_model golden;
+
+    master1.frequency(MULTI_MASTER_BENCH_FREQUENCY);
+    master2.frequency(MULTI_MASTER_BENCH_FREQUENCY);
+
+    printf("multi-master benchmark: %d slots of %lu us per load\n", MULTI_MASTER_BENCH_SLOTS,
+           (unsigned long)slot_us);
+    for (unsigned int l = 0; l < sizeof(loads) / sizeof(loads[0]); ++l) {
+        const char clear[1 + SLAVE_MODEL_REGISTER_COUNT] = {0};
+        struct multi_master m[2];
+
+        if (master1.write(SLAVE_ADDRESS, clear, sizeof(clear)) != 0) {
+            printf("multi-master benchmark: board not responding\n");
+            break;
+        }
+        slave_model_init(&golden, 0, 0);
+        slave_model_write(&golden, clear, sizeof(clear), 0);
+        histogram_init(&recovery, MULTI_MASTER_BENCH_BUCKET_WIDTH_US);
+        memset(m, 0, sizeof(m));
+        m[0].id = 1;
+        m[1].id = 2;
+
+        uint32_t start = us_ticker_read();
+        uint32_t next_slot = start;
+        int slots = 0;
+        while (slots < MULTI_MASTER_BENCH_SLOTS || m[0].active || m[1].active
+           ||  m[0].backlog || m[1].backlog) {
+            if (slots < MULTI_MASTER_BENCH_SLOTS && (int32_t)(us_ticker_read() - next_slot) >= 0) {
+                next_slot += slot_us;
+                ++slots;
+                for (int i = 0; i < 2; ++i)
+                    if (rand() % 200 < loads[l])
+                        multi_master_offer(&m[i]);
+            }
+            multi_master_step(master1, &m[0], &golden, &recovery);
+            multi_master_step(master2, &m[1], &golden, &recovery);
+        }
+        uint32_t elapsed = us_ticker_read() - start;
+
+        uint32_t completed = m[0].completed + m[1].completed;
+        uint32_t attempts = completed + m[0].losses + m[1].losses + m[0].errors + m[1].errors;
+        uint32_t losses = m[0].losses + m[1].losses;
+        printf("load %3d%%: %lu/%lu transactions, %lu arbitration losses (%lu.%lu%% of attempts), "
+               "recovery p50 %lu us p99 %lu us max %lu us\n",
+               loads[l], (unsigned long)completed, (unsigned long)(m[0].offered + m[1].offered),
+               (unsigned long)losses, (unsigned long)(losses * 100 / attempts),
+               (unsigned long)(losses * 1000 / attempts % 10),
+               (unsigned long)histogram_percentile(&recovery, 50),
+               (unsigned long)histogram_percentile(&recovery, 99),
+               (unsigned long)(recovery.count ? recovery.max : 0));
+        printf("          goodput %lu B/s (%lu%% of the offered transactions), %lu dropped, "
+               "%lu mismatches, %lu errors\n",
+               (unsigned long)((uint64_t)(m[0].bytes + m[1].bytes) * 1000000 / elapsed),
+               (unsigned long)((uint64_t)completed * 100 / (m[0].offered + m[1].offered)),
+               (unsigned long)(m[0].dropped + m[1].dropped),
+               (unsigned long)(m[0].mismatches + m[1].mismatches),
+               (unsigned long)(m[0].errors + m[1].errors));
+    }
+
+    /* Leave the bus to I2C1 */
+    master2.regs()->I2CONCLR = FAST_I2C_I2EN;
+    master1.frequency(I2C_FREQUENCY);
+}
+#endif
+
+#if SCHEDULER_BENCH
+static volatile uint32_t scheduler_bench_units;
+static volatile uint32_t scheduler_bench_sink;
+
+/**
+ * @brief One unit of background work: a checksum of a small buffer.
+ */
+static void scheduler_bench_task(void)
+{
+    static uint8_t buf[64];
+    uint32_t sum = 0;
+
+    for (unsigned int i = 0; i < sizeof(buf); ++i)
+        sum = sum * 31 + buf[i]++;
+    scheduler_bench_sink = sum;
+    ++scheduler_bench_units;
+}
+
+/**
+ * @brief Measure the CPU time given back by yielding while FastI2C waits.
+ *
+ * The work rate of the background task is first measured alone, which also
+ * gives the duration of one turn. The same transactions are then run
+ * busy-waiting and yielding to the task: the work done while yielding,
+ * converted to time, is the CPU time reclaimed.
+ */
+static void scheduler_bench(void)
+{
+    uint32_t start = us_ticker_read();
+
+    scheduler_bench_units = 0;
+    while (us_ticker_read() - start < SCHEDULER_BENCH_CALIBRATION_US)
+        scheduler_bench_task();
+    uint32_t units_alone = scheduler_bench_units;
+
+#if FAST_I2C
+    FastI2C<1, p9, p10> &bus = i2c;
+#else
+    FastI2C<1, p9, p10> bus;
+#endif
+    fast_i2c_idle idle = bus.idle();
+    bus.on_idle(NULL);
+    bus.frequency(SCHEDULER_BENCH_FREQUENCY);
+    uint32_t busy_waiting = i2c_driver_bench_run(bus);
+
+    scheduler_clear();
+    if (units_alone)
+        scheduler_add(scheduler_bench_task, SCHEDULER_BENCH_CALIBRATION_US / units_alone + 1);
+    bus.on_idle(scheduler_yield);
+    scheduler_bench_units = 0;
+    uint32_t yielding = i2c_driver_bench_run(bus);
+    uint32_t units = scheduler_bench_units;
+    bus.on_idle(idle);
+    bus.frequency(I2C_FREQUENCY);
+    scheduler_clear();
+
+    if (busy_waiting == 0 || yielding == 0 || units_alone == 0) {
+        printf("scheduler: transaction failed\n");
+        return;
+    }
+
+    uint32_t reclaimed_us = (uint64_t)units * SCHEDULER_BENCH_CALIBRATION_US / units_alone;
+    printf("scheduler: %lu us busy-waiting, %lu us yielding\n",
+           (unsigned long)busy_waiting, (unsigned long)yielding);
+    printf("scheduler: %lu tasks run, %lu us of CPU time reclaimed (%lu%%)\n",
+           (unsigned long)units, (unsigned long)reclaimed_us,
+           (unsigned long)((uint64_t)reclaimed_us * 100 / yielding));
+}
+#endif
+
+#if REPLAY
+static int replay_write(uint8_t address, const char *data, int length, uint32_t at_us)
+{
+    return i2c.write(address, data, length);
+}
+
+static int replay_read(uint8_t address, char *data, int length, uint32_t at_us)
+{
+    return i2c.read(address, data, length);
+}
+
+static void replay_mismatch(uint32_t index, const struct replay_transaction *t, int ret,
+                            const char *data)
+{
+    static int printed;
+
+    if (printed++ >= REPLAY_MAX_PRINTED)
+        return;
+
+    printf("replay: #%lu %c %02X%s, got%s", (unsigned long)index,
+           (t->flags & TRACE_READ) ? 'R' : 'W', t->address,
+           (t->flags & TRACE_NACK) ? " NACK" : "", ret ? " NACK" : "");
+    /* The log has no data for a read it recorded as not acknowledged */
+    if (data && ret == 0)
+        for (int i = 0; i < t->length; ++i) {
+            printf(" %02X", (unsigned char)data[i]);
+            if (t->data)
+                printf(" (%02X)", t->data[i]);
+        }
+    printf("\n");
+}
+
+/**
+ * @brief Replay the transaction log REPLAY_FILE against the board.
+ *
+ * The whole log is loaded in the heap first so that reading the file does not
+ * disturb the timing of the transactions.
+ */
+static void replay(void)
+{
+    static const struct replay_ops ops = {
+        replay_write,
+        replay_read,
+        us_ticker_read,
+        replay_mismatch
+    };
+
+    FILE *file = fopen(REPLAY_FILE, "rb");
+    if (file == NULL) {
+        printf("replay: %s not found\n", REPLAY_FILE);
+        return;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *log = (uint8_t *)malloc(size);
+    if (log == NULL || fread(log, 1, size, file) != (size_t)size) {
+        printf("replay: cannot load %ld bytes\n", size);
+        fclose(file);
+        free(log);
+        return;
+    }
+    fclose(file);
+
+    struct replay_stats stats;
+    uint32_t start = us_ticker_read();
+    bool valid = replay_run(log, size, &ops, REPLAY_TIMED, &stats);
+    uint32_t elapsed = us_ticker_read() - start;
+    free(log);
+
+    if (!valid)
+        printf("replay: invalid log after %lu transactions\n", (unsigned long)stats.transactions);
+    printf("replay: %lu transactions in %lu us (%lu us recorded), %lu mismatches\n",
+           (unsigned long)stats.transactions, (unsigned long)elapsed,
+           (unsigned long)stats.recorded_us, (unsigned long)stats.mismatches);
+    if (REPLAY_TIMED)
+        printf("replay: up to %lu us late\n", (unsigned long)stats.max_late_us);
+}
+#endif
+
+#if FLASH_LOG
+static void flash_transfer(const uint8_t *cmd, int cmd_length, const uint8_t *tx, int tx_length,
+                           uint8_t *rx, int rx_length)
+{
+    flash_cs = 0;
+    for (int i = 0; i < cmd_length; ++i)
+        flash_spi.write(cmd[i]);
+    for (int i = 0; i < tx_length; ++i)
+        flash_spi.write(tx[i]);
+    for (int i = 0; i < rx_length; ++i)
+        rx[i] = flash_spi.write(0xFF);
+    flash_cs = 1;
+}
+
+static const struct flash_log_ops flash_ops = {
+    flash_transfer
+};
+#endif
+
+#if TRACE_DUMP
+/**
+ * @brief Print the blocks of the packed history in hex, to be decoded by
+ * host/trace_unpack from the console log.
+ */
+static void trace_dump(void)
+{
+    int bytes = 0;
+
+    for (int n = 0; n < trace_history_blocks(); ++n) {
+        int size;
+        const uint8_t *block = trace_history_block(n, &size);
+
+        printf("trace:");
+        for (int i = 0; i < size; ++i)
+            printf("%02x", block[i]);
+        printf("\n");
+        bytes += size;
+    }
+
+    printf("trace dump: %d blocks, %d bytes, %lu transactions since boot\n",
+           trace_history_blocks(), bytes, (unsigned long)trace_count());
+}
+#endif
+
+#if REPRO_BUNDLE
+#define REPRO_SETTING(name)     {#name, (uint32_t)(name)}
+
+/** Configuration recorded in the bundle, what changes the traffic of the tests */
+static const struct repro_setting repro_settings[] = {
+    REPRO_SETTING(SLAVE_ADDRESS),
+    REPRO_SETTING(FAST_I2C),
+    REPRO_SETTING(TEST_SEED),
+    REPRO_SETTING(TEST_WRITE_READ_REG_1_4_COUNT),
+    REPRO_SETTING(TEST_WRITE_READ_REG_1_4_RANDOM),
+    REPRO_SETTING(TEST_WRITE_READ_REG_0_COUNT),
+    REPRO_SETTING(TEST_WRITE_READ_REG_0_RANDOM),
+    REPRO_SETTING(TEST_WRITE_REG_READ_ALL_COUNT),
+    REPRO_SETTING(TEST_WRITE_INVALID_REG_READ_ALL_RANDOM),
+    REPRO_SETTING(TEST_WRITE_INVALID_REG_READ_ALL_COUNT),
+    REPRO_SETTING(TEST_WRITE_INVALID_REG_READ_ZERO_COUNT),
+    REPRO_SETTING(TEST_WRITE_INVALID_REG_READ_ZERO_RANDOM),
+    REPRO_SETTING(TEST_WRITE_REG_MULTIPLE_READ_RANDOM),
+    REPRO_SETTING(TEST_WRITE_MULTIPLE_REG_READ_RANDOM),
+    REPRO_SETTING(TEST_COMBINATORIAL_STRENGTH),
+    REPRO_SETTING(TEST_COMBINATORIAL_MAX_BURST),
+    REPRO_SETTING(TEST_COMBINATORIAL_MAX_ROWS),
+    REPRO_SETTING(TEST_VERIFY_POLICY),
+    REPRO_SETTING(TEST_VERIFY_SWEEP_PERIOD),
+    REPRO_SETTING(TEST_VERIFY_GROUP_SIZE),
+    REPRO_SETTING(SCHEDULER),
+    REPRO_SETTING(REG_WATCH),
+};
+
+static void repro_print(const uint8_t *data, int length)
+{
+    printf("repro:");
+    for (int i = 0; i < length; ++i)
+        printf("%02x", data[i]);
+    printf("\n");
+}
+
+/**
+ * @brief Print the reproduction bundle of a failure, one "repro:" line for
+ * the header, each setting and each block of the history.
+ *
+ * @param[in] test failing test (starting from 1)
+ */
+static void repro_dump(int test)
+{
+    const int setting_count = sizeof(repro_settings) / sizeof(repro_settings[0]);
+    int blocks = trace_history_blocks();
+    int first = blocks > REPRO_BUNDLE_BLOCKS ? blocks - REPRO_BUNDLE_BLOCKS : 0;
+    struct repro_info info;
+    uint8_t buf[REPRO_HEADER_SIZE + REPRO_MAX_SETTING_SIZE];
+
+    info.seed = test_seed;
+    info.test = test;
+    info.iteration = counter_values[COUNTER_TEST_ITERATION];
+    info.bus_frequency = counter_values[COUNTER_BUS_FREQUENCY];
+    info.transactions = trace_count();
+    info.setting_count = setting_count;
+    info.history_blocks = blocks - first;
+    repro_print(buf, repro_encode_header(buf, &info));
+
+    for (int i = 0; i < setting_count; ++i)
+        repro_print(buf, repro_encode_setting(buf, &repro_settings[i]));
+
+    for (int n = first; n < blocks; ++n) {
+        int size;
+        const uint8_t *block = trace_history_block(n, &size);
+        repro_print(block, size);
+    }
+
+    printf("repro bundle: test %d iteration %lu seed %lu, %d blocks\n", test,
+           (unsigned long)info.iteration, (unsigned long)test_seed, blocks - first);
+}
+#endif
+
+/**
+ * @brief Called at the end of each test.
+ *
+ * @param[in] test test number (starting from 1)
+ * @param[in] passed true if the test passed
+ * @param[in] elapsed_us duration of the test
+ */
+static void on_test_result(int test, bool passed, uint32_t elapsed_us)
+{
+#if ETH_STREAM
+    uint8_t record[RECORD_MAX_SIZE];
+
+    eth_stream_write(record, record_encode_result(record, test, passed, elapsed_us));
+    eth_stream_flush();
+#endif
+
+#if CAN_REPORT
+    can_report_result(test, passed, elapsed_us, test_transactions, test_nacks);
+#endif
+
+#if FLASH_LOG
+    uint8_t result[RECORD_MAX_SIZE];
+
+    flash_log_write(result, record_encode_result(result, test, passed, elapsed_us));
+    flash_log_sync();
+#endif
+}
+
+/**
+ * @brief Run all tests.
+ *
+ * @return 0 if all tests are successful, otherwise return the first test number
+ * (greater or equal to 1) that failed.
+ */
+static int run_tests(struct test *tests)
+{
+    int n = 0;
+
+    if (tests == NULL)
+        return 0;
+
+    while (tests[n].name != NULL && tests[n].f != NULL) {
+        printf("test %d: %s: ", n + 1, tests[n].name);
+        current_test = n + 1;
+        counter_set(COUNTER_TEST, current_test);
+        test_transactions = 0;
+        test_nacks = 0;
+        uint32_t start = us_ticker_read();
+        bus_owned = true;
+        bool passed = tests[n].f();
+        bus_owned = false;
+        counter_set(COUNTER_TEST, 0);
+        on_test_result(n + 1, passed, us_ticker_read() - start);
+        if (!passed) {
+            printf("FAIL\n");
+            return n+1;
+        }
+
+        printf("PASS\n");
+        ++n;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Flash all LED's present on the board.
+ *
+ * This function is used to indicate that all tests were successfull without
+ * having to look at the UART output.
+ */
+static void flash_all_leds(void)
+{
+    while (1) {
+        led1 = led2 = led3 = led4 = !led1;
+        wait_ms(100);
+    }
+}
+
+/** Buffers placed in the AHB SRAM banks, whether their feature is enabled or not */
+#define TRACE_BUFFER_SIZE           (TRACE_DEPTH * sizeof(struct trace_entry) \
+                                     + TRACE_HISTORY_BLOCKS * TRACE_HISTORY_BLOCK_SIZE)
+#define COVERING_BUFFER_SIZE        (TEST_COMBINATORIAL_MAX_ROWS * COMBINATORIAL_FACTORS \
+                                     + COVERING_MAX_COMBINATIONS / 8)
+#define FLASH_LOG_BUFFER_SIZE       (2 * FLASH_LOG_STAGING_PAGES * FLASH_LOG_PAGE_SIZE)
+#define ETH_STREAM_BUFFER_SIZE      (sizeof(struct stream_frame))
+#define REG_WATCH_BUFFER_SIZE       (REG_WATCH_LOG_DEPTH * sizeof(struct reg_watch_event))
+
+AHB_SRAM_CHECK(bank0, TRACE_BUFFER_SIZE + COVERING_BUFFER_SIZE + FLASH_LOG_BUFFER_SIZE,
+               AHB_SRAM0_SIZE);
+AHB_SRAM_CHECK(bank1, ETH_STREAM_BUFFER_SIZE + REG_WATCH_BUFFER_SIZE,
+               AHB_SRAM1_SIZE - AHB_SRAM1_ETHERNET_SIZE);
+
+#if MEMORY_REPORT
+/**
+ * @brief Register the large static buffers of the enabled features.
+ */
+static void memory_inventory(void)
+{
+    mem_report_buffer("flight recorder", TRACE_BUFFER_SIZE, MEM_REPORT_AHB_SRAM0);
+    mem_report_buffer("covering array", COVERING_BUFFER_SIZE, MEM_REPORT_AHB_SRAM0);
+#if FLASH_LOG
+    mem_report_buffer("flash log staging", FLASH_LOG_BUFFER_SIZE, MEM_REPORT_AHB_SRAM0);
+#endif
+#if ETH_STREAM
+    mem_report_buffer("ethernet driver", AHB_SRAM1_ETHERNET_SIZE, MEM_REPORT_AHB_SRAM1);
+    mem_report_buffer("ethernet frame", ETH_STREAM_BUFFER_SIZE, MEM_REPORT_AHB_SRAM1);
+#endif
+#if REG_WATCH
+    mem_report_buffer("register watch log", REG_WATCH_BUFFER_SIZE, MEM_REPORT_AHB_SRAM1);
+#endif
+}
+#endif
+
+int main()
+{
+#if MEMORY_REPORT
+    mem_report_paint();
+    memory_inventory();
+    mem_report_banks();
+#endif
+
+    test_seed = TEST_SEED ? TEST_SEED : time(NULL);
+    srand(test_seed);
+    counters_init();
+    i2c.frequency(I2C_FREQUENCY);
+    counter_set(COUNTER_BUS_FREQUENCY, I2C_FREQUENCY);
+
+    led1 = 0;
+    led2 = 0;
+    led3 = 0;
+    led4 = 0;
+
+#if ETH_STREAM
+    eth_stream_init(FIXTURE_ID);
+#endif
+
+#if CAN_REPORT
+    can_report_init(FIXTURE_ID, CAN_REPORT_FREQUENCY);
+#endif
+
+#if FLASH_LOG
+    flash_spi.frequency(FLASH_LOG_SPI_FREQUENCY);
+    if (!flash_log_init(&flash_ops, FLASH_LOG_SIZE))
+        printf("flash log: no flash found\n");
+#endif
+
+#if POWER_UP_BENCH
+    power_up_bench();
+#endif
+
+#if LOCKSTEP_TEST
+    lockstep_test();
+#endif
+
+#if I2C_DRIVER_BENCH
+    i2c_driver_bench();
+#endif
+
+#if MULTI_MASTER_BENCH
+    multi_master_bench();
+#endif
+
+#if SCHEDULER_BENCH
+    scheduler_bench();
+#endif
+
+#if REPLAY
+    replay();
+#endif
+
+#if SCHEDULER
+#if FLASH_LOG
+    scheduler_add(flash_log_step, SCHEDULER_FLASH_LOG_TURN_US);
+#endif
+    i2c.on_idle(scheduler_yield);
+#endif
+
+    struct test tests[] = {
+        {"write/read registers 1-4", test_write_read_reg_1_4},
+        {"write/read register 0", test_write_read_reg_0},
+        {"write reg/read all", test_write_reg_read_all},
         {"write invalid reg/read all", test_write_invalid_reg_read_all},
         {"write invalid reg/read zero", test_write_invalid_reg_read_zero},
         {"write reg/multiple read", test_write_reg_multiple_read},
         {"write multiple reg/read", test_write_multiple_reg_read},
+        {"combinatorial registers", test_combinatorial},
         {NULL, NULL}
     };
 
+#if REG_WATCH
+    reg_watch_start();
+#endif
+
+#if COUNTERS
+    counters_ticker.attach_us(&counters_tick, COUNTERS_PERIOD_US);
+#endif
+
     int ret = run_tests(tests);
+
+#if COUNTERS
+    counters_ticker.detach();
+    counters_pending = false;
+    counters_tick();
+    counters_poll();
+#endif
+
+#if REG_WATCH
+    reg_watch_ticker.detach();
+    reg_watch_print();
+#endif
+
+#if CAN_REPORT
+    const int test_count = sizeof(tests) / sizeof(tests[0]) - 1;
+    can_report_done(ret, ret ? ret : test_count);
+    printf("CAN report: %lu messages dropped\n", (unsigned long)can_report_dropped());
+#endif
+
+#if ETH_STREAM
+    printf("ethernet stream: %lu transactions lost, %lu frames not sent\n",
+           (unsigned long)eth_stream_lost(), (unsigned long)eth_stream_send_errors());
+#endif
+
+#if FLASH_LOG
+    printf("flash log: %lu records dropped\n", (unsigned long)flash_log_dropped());
+#endif
+
+#if SCHEDULER
+    printf("scheduler: %lu task turns\n", (unsigned long)scheduler_runs());
+#endif
+
+#if TRACE_DUMP
+    if (ret)
+        trace_dump();
+#endif
+
+#if REPRO_BUNDLE
+    if (ret)
+        repro_dump(ret);
+#endif
+
+#if TEST_VERIFY_GROUP_SIZE
+    printf("test 3: %lu groups verified, %lu replays\n", write_reg_read_all_group.groups,
+           write_reg_read_all_group.probes);
+    printf("test 4: %lu groups verified, %lu replays\n", write_invalid_reg_read_all_group.groups,
+           write_invalid_reg_read_all_group.probes);
+#elif TEST_VERIFY_POLICY != VERIFY_POLICY_EVERY_WRITE
+    printf("test 3:\n");
+    verify_policy_print(&write_reg_read_all_policy, 5);
+    printf("test 4:\n");
+    verify_policy_print(&write_invalid_reg_read_all_policy, 5);
+#endif
+
+#if MEMORY_REPORT
+    mem_report_print();
+#endif
+
     if (ret == 0) {
         printf("All tests passed.\n");
         flash_all_leds();
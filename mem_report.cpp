@@ -0,0 +1,132 @@
+#include "mem_report.h"
+#include "ahb_sram.h"
+#include "mbed.h"
+#include <malloc.h>
+#include <stdio.h>
+
+/* Defined by the linker script */
+extern "C" uint32_t __data_start__, __data_end__;
+extern "C" uint32_t __bss_start__, __bss_end__;
+extern "C" uint32_t __end__;
+extern "C" uint32_t __StackTop;
+extern "C" uint32_t __AHBSRAM0_start__, __AHBSRAM0_end__;
+extern "C" uint32_t __AHBSRAM1_start__, __AHBSRAM1_end__;
+
+extern "C" void *_sbrk(int incr);
+
+struct buffer {
+    const char *name;
+    uint32_t size;
+    int region;
+};
+
+static struct buffer buffers[MEM_REPORT_MAX_BUFFERS];
+static int buffer_count;
+static uint32_t *painted_bottom;
+
+static uint32_t *heap_end(void)
+{
+    uintptr_t end = (uintptr_t)_sbrk(0);
+
+    return (uint32_t *)((end + 3) & ~(uintptr_t)3);
+}
+
+void mem_report_paint(void)
+{
+    uint32_t *bottom = heap_end();
+    volatile uint32_t *p = bottom;
+    uint32_t *top = (uint32_t *)(uintptr_t)__get_MSP() - MEM_REPORT_GUARD_WORDS;
+
+    /* volatile: the loop must not be turned into a call to memset(), whose
+     * frame would land on the words being painted */
+    while (p < top)
+        *p++ = MEM_REPORT_PATTERN;
+
+    painted_bottom = bottom;
+}
+
+void mem_report_buffer(const char *name, uint32_t size, int region)
+{
+    if (buffer_count == MEM_REPORT_MAX_BUFFERS)
+        return;
+
+    buffers[buffer_count].name = name;
+    buffers[buffer_count].size = size;
+    buffers[buffer_count].region = region;
+    ++buffer_count;
+}
+
+uint32_t mem_report_stack_used(void)
+{
+    /* The heap may have grown over the painted words since */
+    uint32_t *p = heap_end();
+    if (p < painted_bottom)
+        p = painted_bottom;
+
+    while (p < &__StackTop && *p == MEM_REPORT_PATTERN)
+        ++p;
+
+    return (uintptr_t)&__StackTop - (uintptr_t)p;
+}
+
+/**
+ * @brief Print the buffers of a region and return their total size.
+ */
+static uint32_t print_buffers(int region)
+{
+    uint32_t listed = 0;
+
+    for (int i = 0; i < buffer_count; ++i) {
+        if (buffers[i].region != region)
+            continue;
+
+        printf("    %-20s %6lu\n", buffers[i].name, (unsigned long)buffers[i].size);
+        listed += buffers[i].size;
+    }
+
+    return listed;
+}
+
+static void print_bank(const char *name, const uint32_t *start, const uint32_t *end,
+                       uint32_t size, int region)
+{
+    uint32_t used = (uintptr_t)end - (uintptr_t)start;
+
+    printf("  %-12s %6lu of %lu\n", name, (unsigned long)used, (unsigned long)size);
+    uint32_t listed = print_buffers(region);
+    if (listed && used > listed)
+        printf("    %-20s %6lu\n", "other", (unsigned long)(used - listed));
+}
+
+void mem_report_banks(void)
+{
+    printf("memory: AHB SRAM\n");
+    print_bank("AHBSRAM0", &__AHBSRAM0_start__, &__AHBSRAM0_end__, AHB_SRAM0_SIZE,
+               MEM_REPORT_AHB_SRAM0);
+    print_bank("AHBSRAM1", &__AHBSRAM1_start__, &__AHBSRAM1_end__, AHB_SRAM1_SIZE,
+               MEM_REPORT_AHB_SRAM1);
+}
+
+void mem_report_print(void)
+{
+    uint32_t data = (uintptr_t)&__data_end__ - (uintptr_t)&__data_start__;
+    uint32_t bss = (uintptr_t)&__bss_end__ - (uintptr_t)&__bss_start__;
+    uint32_t heap = (uintptr_t)heap_end() - (uintptr_t)&__end__;
+    uint32_t stack = mem_report_stack_used();
+    uint32_t total = (uintptr_t)&__StackTop - (uintptr_t)&__data_start__;
+    struct mallinfo info = mallinfo();
+
+    printf("memory: %lu bytes of local RAM\n", (unsigned long)total);
+    printf("  .data        %6lu\n", (unsigned long)data);
+    printf("  .bss         %6lu\n", (unsigned long)bss);
+
+    uint32_t listed = print_buffers(MEM_REPORT_MAIN);
+    if (listed)
+        printf("    %-20s %6lu\n", "other", (unsigned long)(data + bss - listed));
+
+    printf("  heap         %6lu (%lu in use)\n", (unsigned long)heap,
+           (unsigned long)info.uordblks);
+    printf("  stack        %6lu (high-water mark)\n", (unsigned long)stack);
+    printf("  free         %6lu\n",
+           (unsigned long)((uintptr_t)&__StackTop - stack - (uintptr_t)heap_end()));
+}
@@ -0,0 +1,65 @@
+/**
+ * Report of the RAM used by the test software.
+ *
+ * At the start of main(), the RAM between the end of the heap and the stack
+ * pointer is painted with a known pattern. At the end of the run, the stack
+ * high-water mark is the lowest word which does not hold the pattern anymore.
+ * Interrupt handlers run on the same stack, so their usage is included.
+ *
+ * The heap is reported from the break of _sbrk() (peak) and mallinfo() (in
+ * use). The sizes of .data and .bss come from the linker script, and the
+ * large static buffers registered with mem_report_buffer() are listed so that
+ * the remaining space can be checked before adding a feature. Buffers placed
+ * in the AHB SRAM banks (see ahb_sram.h) are listed under their bank.
+ */
+
+#ifndef MEM_REPORT_H
+#define MEM_REPORT_H
+
+#include <stdint.h>
+
+#define MEM_REPORT_MAX_BUFFERS      (16)
+
+/* Regions of the buffers */
+#define MEM_REPORT_MAIN             (0)     /* .data or .bss */
+#define MEM_REPORT_AHB_SRAM0        (1)
+#define MEM_REPORT_AHB_SRAM1        (2)
+
+/** Pattern painted on the unused RAM */
+#define MEM_REPORT_PATTERN          (0xDEADBEEF)
+
+/** Words left unpainted below the stack pointer of the caller */
+#define MEM_REPORT_GUARD_WORDS      (16)
+
+/**
+ * @brief Paint the RAM between the end of the heap and the stack.
+ *
+ * Must be called first in main(), before deep calls.
+ */
+void mem_report_paint(void);
+
+/**
+ * @brief Add a static buffer to the inventory.
+ *
+ * @param[in] name name of the buffer, must stay valid
+ * @param[in] size size of the buffer in bytes
+ * @param[in] region MEM_REPORT_MAIN, MEM_REPORT_AHB_SRAM0, MEM_REPORT_AHB_SRAM1
+ */
+void mem_report_buffer(const char *name, uint32_t size, int region);
+
+/**
+ * @brief Bytes of stack used since mem_report_paint().
+ */
+uint32_t mem_report_stack_used(void);
+
+/**
+ * @brief Print the usage of the AHB SRAM banks, at boot.
+ */
+void mem_report_banks(void);
+
+/**
+ * @brief Print the RAM usage.
+ */
+void mem_report_print(void);
+
+#endif
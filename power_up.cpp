@@ -0,0 +1,96 @@
+#include "power_up.h"
+#include <stdio.h>
+
+/* Value written to register 1 to check that the firmware services registers */
+#define POWER_UP_PATTERN        (0xA5)
+
+/**
+ * @brief Poll the board until it is acknowledged.
+ *
+ * @return True if the address was acknowledged before the timeout
+ */
+static bool wait_first_ack(const struct power_up_ops *ops,
+                           const struct power_up_config *config,
+                           uint32_t start, uint32_t *elapsed)
+{
+    while (1) {
+        *elapsed = ops->time_us() - start;
+        if (ops->write(NULL, 0) == 0)
+            return true;
+        if (*elapsed >= config->timeout_us)
+            return false;
+
+        ops->wait_us(config->poll_interval_us);
+    }
+}
+
+/**
+ * @brief Poll the board until register 1 reads back the value written.
+ *
+ * @return True if the register was read back before the timeout
+ */
+static bool wait_first_read(const struct power_up_ops *ops,
+                            const struct power_up_config *config,
+                            uint32_t start, uint32_t *elapsed)
+{
+    while (1) {
+        char data[2] = {1, (char)POWER_UP_PATTERN};
+        char value = 0;
+
+        *elapsed = ops->time_us() - start;
+        if (ops->write(data, sizeof(data)) == 0
+        &&  ops->write(data, 1) == 0
+        &&  ops->read(&value, 1) == 0
+        &&  value == (char)POWER_UP_PATTERN)
+            return true;
+        if (*elapsed >= config->timeout_us)
+            return false;
+
+        ops->wait_us(config->poll_interval_us);
+    }
+}
+
+bool power_up_run(const struct power_up_ops *ops,
+                  const struct power_up_config *config,
+                  struct power_up_result *result)
+{
+    histogram_init(&result->first_ack, config->bucket_width_us);
+    histogram_init(&result->first_read, config->bucket_width_us);
+    result->ack_timeouts = 0;
+    result->read_timeouts = 0;
+
+    for (unsigned int i = 0; i < config->cycles; ++i) {
+        uint32_t elapsed;
+
+        ops->power(false);
+        ops->wait_us(config->off_time_us);
+        ops->power(true);
+        uint32_t start = ops->time_us();
+
+        if (!wait_first_ack(ops, config, start, &elapsed)) {
+            ++result->ack_timeouts;
+            continue;
+        }
+        histogram_add(&result->first_ack, elapsed);
+
+        if (!wait_first_read(ops, config, start, &elapsed)) {
+            ++result->read_timeouts;
+            continue;
+        }
+        histogram_add(&result->first_read, elapsed);
+    }
+
+    return result->ack_timeouts == 0 && result->read_timeouts == 0;
+}
+
+void power_up_print(const struct power_up_result *result)
+{
+    histogram_print(&result->first_ack, "time to first ack", "us");
+    histogram_print(&result->first_read, "time to first correct read", "us");
+    printf("timeouts: %u before ack, %u before correct read\n",
+           result->ack_timeouts, result->read_timeouts);
+
+    if (result->first_read.count > 0)
+        printf("minimum safe settle time: %lu us\n",
+               (unsigned long)result->first_read.max);
+}
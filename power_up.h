@@ -0,0 +1,73 @@
+/**
+ * Power-up to ready latency benchmark.
+ *
+ * The board under test is power-cycled through a load switch. After each
+ * power-up, the slave address is polled with address-only probes until it is
+ * acknowledged, then register 1 is written and read back until the expected
+ * value is returned. Both delays are recorded in histograms so that the
+ * minimum safe settle time after power-up can be derived.
+ *
+ * The benchmark only talks to the board through power_up_ops so that the same
+ * sequence runs against the real board and against the slave model.
+ */
+
+#ifndef POWER_UP_H
+#define POWER_UP_H
+
+#include <stdint.h>
+#include "histogram.h"
+
+struct power_up_ops {
+    /** Switch the power of the board under test */
+    void (*power)(bool on);
+
+    /** Write to the slave, length 0 is an address-only probe (0 on ack) */
+    int (*write)(const char *data, int length);
+
+    /** Read from the slave (0 on ack) */
+    int (*read)(char *data, int length);
+
+    /** Free running microsecond counter */
+    uint32_t (*time_us)(void);
+
+    /** Busy wait */
+    void (*wait_us)(uint32_t us);
+};
+
+struct power_up_config {
+    unsigned int cycles;
+    uint32_t off_time_us;           /* time with power off before each cycle */
+    uint32_t poll_interval_us;      /* delay between two probes */
+    uint32_t timeout_us;            /* give up on a cycle after this delay */
+    uint32_t bucket_width_us;
+};
+
+struct power_up_result {
+    struct histogram first_ack;
+    struct histogram first_read;
+    unsigned int ack_timeouts;
+    unsigned int read_timeouts;
+};
+
+/**
+ * @brief Run the power-up benchmark.
+ *
+ * The board is left powered when this function returns.
+ *
+ * @param[in] ops access to the board under test
+ * @param[in] config benchmark parameters
+ * @param[out] result latency distributions
+ * @return True if the board became ready in every cycle, false otherwise
+ */
+bool power_up_run(const struct power_up_ops *ops,
+                  const struct power_up_config *config,
+                  struct power_up_result *result);
+
+/**
+ * @brief Print the latency distributions and the minimum safe settle time.
+ *
+ * @param[in] result result of power_up_run
+ */
+void power_up_print(const struct power_up_result *result);
+
+#endif
@@ -0,0 +1,101 @@
+#include "record.h"
+#include <string.h>
+
+#define TRACE_FIXED_SIZE        (11)
+
+int record_encode_result(uint8_t *buf, int test, bool passed, uint32_t elapsed_us)
+{
+    buf[0] = RECORD_RESULT;
+    buf[1] = 6;
+    buf[2] = test;
+    buf[3] = passed;
+    record_put_u32(&buf[4], elapsed_us);
+
+    return RECORD_HEADER_SIZE + 6;
+}
+
+int record_encode_trace(uint8_t *buf, uint32_t index, const struct trace_entry *entry)
+{
+    int length = entry->length < TRACE_DATA_MAX ? entry->length : TRACE_DATA_MAX;
+
+    buf[0] = RECORD_TRACE;
+    buf[1] = TRACE_FIXED_SIZE + length;
+    record_put_u32(&buf[2], index);
+    record_put_u32(&buf[6], entry->timestamp_us);
+    buf[10] = entry->address;
+    buf[11] = entry->flags;
+    buf[12] = entry->length;
+    memcpy(&buf[13], entry->data, length);
+
+    return RECORD_HEADER_SIZE + TRACE_FIXED_SIZE + length;
+}
+
+int record_encode_iteration(uint8_t *buf, int test, uint32_t iteration)
+{
+    buf[0] = RECORD_ITERATION;
+    buf[1] = 5;
+    buf[2] = test;
+    record_put_u32(&buf[3], iteration);
+
+    return RECORD_HEADER_SIZE + 5;
+}
+
+int record_encode_counters(uint8_t *buf, uint32_t timestamp_us, const uint32_t *values,
+                           int count)
+{
+    buf[0] = RECORD_COUNTERS;
+    buf[1] = 4 + 4 * count;
+    record_put_u32(&buf[2], timestamp_us);
+    for (int i = 0; i < count; ++i)
+        record_put_u32(&buf[6 + 4 * i], values[i]);
+
+    return RECORD_HEADER_SIZE + 4 + 4 * count;
+}
+
+int record_decode(const uint8_t *buf, int size, struct record *r)
+{
+    if (size < RECORD_HEADER_SIZE || size < RECORD_HEADER_SIZE + buf[1])
+        return 0;
+
+    r->type = buf[0];
+    r->length = buf[1];
+    r->payload = &buf[RECORD_HEADER_SIZE];
+
+    const uint8_t *p = r->payload;
+    switch (r->type) {
+    case RECORD_RESULT:
+        if (r->length < 6)
+            return 0;
+        r->result.test = p[0];
+        r->result.passed = p[1];
+        r->result.elapsed_us = record_get_u32(&p[2]);
+        break;
+    case RECORD_TRACE:
+        if (r->length < TRACE_FIXED_SIZE || r->length > TRACE_FIXED_SIZE + TRACE_DATA_MAX)
+            return 0;
+        r->trace.index = record_get_u32(&p[0]);
+        r->trace.entry.timestamp_us = record_get_u32(&p[4]);
+        r->trace.entry.address = p[8];
+        r->trace.entry.flags = p[9];
+        r->trace.entry.length = p[10];
+        memcpy(r->trace.entry.data, &p[11], r->length - TRACE_FIXED_SIZE);
+        break;
+    case RECORD_ITERATION:
+        if (r->length < 5)
+            return 0;
+        r->iteration.test = p[0];
+        r->iteration.iteration = record_get_u32(&p[1]);
+        break;
+    case RECORD_COUNTERS:
+        if (r->length < 4)
+            return 0;
+        r->counters.timestamp_us = record_get_u32(&p[0]);
+        r->counters.count = (r->length - 4) / 4;
+        r->counters.values = &p[4];
+        break;
+    default:
+        break;
+    }
+
+    return RECORD_HEADER_SIZE + r->length;
+}
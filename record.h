@@ -0,0 +1,153 @@
+/**
+ * Binary records of the test results and traces.
+ *
+ * Records are streamed out of the board and decoded on the host. Each record
+ * starts with its type and the length of its payload so that a decoder can
+ * skip records it does not know:
+ *
+ *   | type (1) | length (1) | payload (length) |
+ *
+ * All multi-byte fields are little-endian.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+#include "trace.h"
+
+#define RECORD_HEADER_SIZE      (2)
+#define RECORD_MAX_SIZE         (RECORD_HEADER_SIZE + 255)
+
+enum record_type {
+    /* test (1), passed (1), elapsed_us (4) */
+    RECORD_RESULT = 1,
+
+    /*
+     * index (4), timestamp_us (4), address (1), flags (1), length (1),
+     * data (first TRACE_DATA_MAX bytes)
+     */
+    RECORD_TRACE = 2,
+
+    /* test (1), iteration (4) */
+    RECORD_ITERATION = 3,
+
+    /* timestamp_us (4), values (4 each, in the order of enum counter_id) */
+    RECORD_COUNTERS = 4,
+};
+
+struct record_result {
+    uint8_t test;
+    uint8_t passed;
+    uint32_t elapsed_us;
+};
+
+struct record_trace {
+    uint32_t index;
+    struct trace_entry entry;
+};
+
+struct record_iteration {
+    uint8_t test;
+    uint32_t iteration;
+};
+
+struct record_counters {
+    uint32_t timestamp_us;
+    int count;                      /* number of values */
+    const uint8_t *values;          /* use record_get_u32() */
+};
+
+struct record {
+    uint8_t type;
+    uint8_t length;
+    const uint8_t *payload;
+    union {
+        struct record_result result;
+        struct record_trace trace;
+        struct record_iteration iteration;
+        struct record_counters counters;
+    };
+};
+
+static inline void record_put_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+}
+
+static inline void record_put_u32(uint8_t *p, uint32_t value)
+{
+    p[0] = value;
+    p[1] = value >> 8;
+    p[2] = value >> 16;
+    p[3] = value >> 24;
+}
+
+static inline uint16_t record_get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static inline uint32_t record_get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/**
+ * @brief Encode the result of a test.
+ *
+ * @param[out] buf buffer of at least RECORD_MAX_SIZE bytes
+ * @param[in] test test number (starting from 1)
+ * @param[in] passed true if the test passed
+ * @param[in] elapsed_us duration of the test
+ * @return Size of the record in bytes
+ */
+int record_encode_result(uint8_t *buf, int test, bool passed, uint32_t elapsed_us);
+
+/**
+ * @brief Encode a transaction of the flight recorder.
+ *
+ * @param[out] buf buffer of at least RECORD_MAX_SIZE bytes
+ * @param[in] index number of the transaction in the flight recorder
+ * @param[in] entry transaction
+ * @return Size of the record in bytes
+ */
+int record_encode_trace(uint8_t *buf, uint32_t index, const struct trace_entry *entry);
+
+/**
+ * @brief Encode the start of an iteration of a test.
+ *
+ * @param[out] buf buffer of at least RECORD_MAX_SIZE bytes
+ * @param[in] test test number (starting from 1)
+ * @param[in] iteration iteration of the test
+ * @return Size of the record in bytes
+ */
+int record_encode_iteration(uint8_t *buf, int test, uint32_t iteration);
+
+/**
+ * @brief Encode a snapshot of the live counters (see counters.h).
+ *
+ * @param[out] buf buffer of at least RECORD_MAX_SIZE bytes
+ * @param[in] timestamp_us time of the snapshot
+ * @param[in] values values of the counters
+ * @param[in] count number of values (at most 63)
+ * @return Size of the record in bytes
+ */
+int record_encode_counters(uint8_t *buf, uint32_t timestamp_us, const uint32_t *values,
+                           int count);
+
+/**
+ * @brief Decode one record.
+ *
+ * Unknown record types are not an error: only type, length and payload are
+ * set.
+ *
+ * @param[in] buf encoded record
+ * @param[in] size number of bytes available in buf
+ * @param[out] r decoded record
+ * @return Size of the record in bytes, 0 if the record is truncated or invalid
+ */
+int record_decode(const uint8_t *buf, int size, struct record *r);
+
+#endif
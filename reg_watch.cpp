@@ -0,0 +1,141 @@
+#include "reg_watch.h"
+#include "ahb_sram.h"
+#include "slave_model.h"
+#include <stddef.h>
+#include <stdio.h>
+
+static struct slave_model shadow;
+static uint8_t known;                   /* mask of registers with a known value */
+static char reported[REG_WATCH_REGISTER_COUNT];
+static uint8_t mismatching;             /* mask of registers already reported */
+
+static uint32_t min_period;
+static uint32_t max_period;
+static uint32_t samples;
+
+static struct reg_watch_event events[REG_WATCH_LOG_DEPTH] AHB_SRAM1;
+static uint32_t event_count;
+
+static void log_event(uint32_t now_us, uint8_t reg, uint8_t expected, uint8_t actual)
+{
+    struct reg_watch_event *e = &events[event_count & (REG_WATCH_LOG_DEPTH - 1)];
+
+    e->timestamp_us = now_us;
+    e->reg = reg;
+    e->expected = expected;
+    e->actual = actual;
+    ++event_count;
+}
+
+uint32_t reg_watch_init(uint32_t min_period_us, uint32_t max_period_us)
+{
+    slave_model_init(&shadow, 0, 0);
+    known = 0;
+    mismatching = 0;
+    min_period = min_period_us;
+    max_period = max_period_us;
+    samples = 0;
+    event_count = 0;
+
+    return max_period;
+}
+
+void reg_watch_write(const char *data, int length)
+{
+    if (length < 2)
+        return;
+
+    slave_model_write(&shadow, data, length, 0);
+    for (int i = 0; i < length - 1; ++i) {
+        unsigned int reg = (unsigned char)data[0] + i;
+        if (reg >= REG_WATCH_REGISTER_COUNT)
+            break;
+        known |= 1 << reg;
+        mismatching &= ~(1 << reg);
+    }
+}
+
+int reg_watch_check(uint32_t now_us, const char *regs)
+{
+    if (regs == NULL) {
+        log_event(now_us, REG_WATCH_NACK, 0, 0);
+        return REG_WATCH_REGISTER_COUNT;
+    }
+
+    int count = 0;
+    ++samples;
+    for (int i = 0; i < REG_WATCH_REGISTER_COUNT; ++i) {
+        uint8_t mask = i == 0 ? 0x0F : 0xFF;
+
+        if (!(known & (1 << i))) {
+            shadow.regs[i] = regs[i];
+            known |= 1 << i;
+            continue;
+        }
+
+        if ((regs[i] & mask) == (shadow.regs[i] & mask)) {
+            mismatching &= ~(1 << i);
+            continue;
+        }
+
+        ++count;
+        if (!(mismatching & (1 << i)) || reported[i] != regs[i])
+            log_event(now_us, i, shadow.regs[i] & mask, regs[i] & mask);
+        mismatching |= 1 << i;
+        reported[i] = regs[i];
+    }
+
+    return count;
+}
+
+uint32_t reg_watch_adapt(uint32_t elapsed_us, uint32_t busy_us, uint32_t sample_us)
+{
+    if (busy_us >= elapsed_us)
+        return max_period;
+
+    /* sample_us must be REG_WATCH_SHARE_PERCENT of the idle time of a period */
+    uint64_t period = (uint64_t)sample_us * 100 * elapsed_us
+                    / (REG_WATCH_SHARE_PERCENT * (uint64_t)(elapsed_us - busy_us));
+
+    if (period < min_period)
+        return min_period;
+    if (period > max_period)
+        return max_period;
+
+    return period;
+}
+
+uint32_t reg_watch_samples(void)
+{
+    return samples;
+}
+
+uint32_t reg_watch_event_count(void)
+{
+    return event_count;
+}
+
+const struct reg_watch_event *reg_watch_event(uint32_t index)
+{
+    if (event_count - index - 1 >= REG_WATCH_LOG_DEPTH)
+        return NULL;
+
+    return &events[index & (REG_WATCH_LOG_DEPTH - 1)];
+}
+
+void reg_watch_print(void)
+{
+    printf("register watch: %lu samples, %lu events\n",
+           (unsigned long)samples, (unsigned long)event_count);
+
+    uint32_t first = event_count > REG_WATCH_LOG_DEPTH ? event_count - REG_WATCH_LOG_DEPTH : 0;
+    for (uint32_t i = first; i < event_count; ++i) {
+        const struct reg_watch_event *e = reg_watch_event(i);
+
+        if (e->reg == REG_WATCH_NACK)
+            printf("  %10lu us: read-back not acknowledged\n", (unsigned long)e->timestamp_us);
+        else
+            printf("  %10lu us: register %u is %02X, expected %02X\n",
+                   (unsigned long)e->timestamp_us, e->reg, e->actual, e->expected);
+    }
+}
@@ -0,0 +1,99 @@
+/**
+ * Background watch of the registers of the slave.
+ *
+ * The watch keeps a shadow of the values the tests expect in registers 0-4,
+ * updated with every acknowledged write. Registers are periodically read back
+ * in one burst and compared to the shadow, so that a register changing on its
+ * own (brown-out, firmware bug) is detected even if no test reads it.
+ *
+ * Registers never written are learnt from the first read-back. Only the lower
+ * half of register 0 is compared. A mismatch is logged once until the value
+ * read back changes again.
+ *
+ * The sampling period adapts to the load of the bus: the watch uses at most
+ * REG_WATCH_SHARE_PERCENT of the time the bus is idle.
+ */
+
+#ifndef REG_WATCH_H
+#define REG_WATCH_H
+
+#include <stdint.h>
+
+#define REG_WATCH_REGISTER_COUNT    (5)
+
+/** Number of events kept, must be a power of 2 */
+#define REG_WATCH_LOG_DEPTH         (32)
+
+/** Share of the idle bus time used by the watch */
+#define REG_WATCH_SHARE_PERCENT     (10)
+
+/** Register of the events logged when a read-back is not acknowledged */
+#define REG_WATCH_NACK              (0xFF)
+
+struct reg_watch_event {
+    uint32_t timestamp_us;
+    uint8_t reg;
+    uint8_t expected;
+    uint8_t actual;
+};
+
+/**
+ * @brief Forget the shadow and the logged events.
+ *
+ * @param[in] min_period_us shortest sampling period
+ * @param[in] max_period_us longest sampling period
+ * @return Initial sampling period
+ */
+uint32_t reg_watch_init(uint32_t min_period_us, uint32_t max_period_us);
+
+/**
+ * @brief Update the shadow with an acknowledged write.
+ *
+ * @param[in] data bytes written, data[0] is the register address
+ * @param[in] length number of bytes written
+ */
+void reg_watch_write(const char *data, int length);
+
+/**
+ * @brief Compare registers read back with the shadow.
+ *
+ * @param[in] now_us time of the read-back
+ * @param[in] regs registers 0-4, NULL if the read-back was not acknowledged
+ * @return Number of registers that do not match
+ */
+int reg_watch_check(uint32_t now_us, const char *regs);
+
+/**
+ * @brief Compute the next sampling period.
+ *
+ * @param[in] elapsed_us time since the last period was computed
+ * @param[in] busy_us time the bus was used by the tests during elapsed_us
+ * @param[in] sample_us duration of one read-back
+ * @return Sampling period in microseconds
+ */
+uint32_t reg_watch_adapt(uint32_t elapsed_us, uint32_t busy_us, uint32_t sample_us);
+
+/**
+ * @return Number of read-backs compared
+ */
+uint32_t reg_watch_samples(void);
+
+/**
+ * @return Number of events logged since reg_watch_init()
+ */
+uint32_t reg_watch_event_count(void);
+
+/**
+ * @brief Get a logged event.
+ *
+ * @param[in] index number of the event
+ * @return Event, or NULL if it was overwritten or not logged yet
+ */
+const struct reg_watch_event *reg_watch_event(uint32_t index);
+
+/**
+ * @brief Print the number of samples and the events still in the log.
+ */
+void reg_watch_print(void);
+
+#endif
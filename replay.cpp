@@ -0,0 +1,150 @@
+#include "replay.h"
+#include <stddef.h>
+#include <string.h>
+
+int replay_encode_header(uint8_t *buf, struct replay_writer *w)
+{
+    buf[0] = 'R';
+    buf[1] = 'A';
+    buf[2] = 'T';
+    buf[3] = 'R';
+    buf[4] = REPLAY_VERSION;
+    buf[5] = buf[6] = buf[7] = 0;
+
+    w->last_us = 0;
+    w->started = false;
+
+    return REPLAY_HEADER_SIZE;
+}
+
+int replay_encode(uint8_t *buf, struct replay_writer *w, uint32_t timestamp_us,
+                  uint8_t address, uint8_t flags, const uint8_t *data, int length)
+{
+    uint32_t delta = w->started ? timestamp_us - w->last_us : 0;
+    int n = 3;
+
+    w->last_us = timestamp_us;
+    w->started = true;
+
+    buf[0] = flags & (TRACE_READ | TRACE_NACK);
+    buf[1] = address;
+    buf[2] = length;
+    do {
+        buf[n++] = (delta & 0x7F) | (delta > 0x7F ? 0x80 : 0);
+        delta >>= 7;
+    } while (delta);
+
+    if ((flags & (TRACE_READ | TRACE_NACK)) != (TRACE_READ | TRACE_NACK)) {
+        memcpy(&buf[n], data, length);
+        n += length;
+    }
+
+    return n;
+}
+
+int replay_encode_trace(uint8_t *buf, struct replay_writer *w, const struct trace_entry *e)
+{
+    int length = e->length < TRACE_DATA_MAX ? e->length : TRACE_DATA_MAX;
+
+    return replay_encode(buf, w, e->timestamp_us, e->address, e->flags, e->data, length);
+}
+
+bool replay_check_header(const uint8_t *buf, uint32_t size)
+{
+    return size >= REPLAY_HEADER_SIZE && memcmp(buf, "RATR", 4) == 0
+           && buf[4] == REPLAY_VERSION;
+}
+
+int replay_decode(const uint8_t *buf, uint32_t size, struct replay_transaction *t)
+{
+    if (size < 4)
+        return 0;
+
+    t->flags = buf[0];
+    t->address = buf[1];
+    t->length = buf[2];
+
+    uint32_t n = 3;
+    uint32_t delta = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (n == size || shift > 28)
+            return 0;
+        uint8_t b = buf[n++];
+        delta |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            break;
+    }
+    t->delta_us = delta;
+
+    if ((t->flags & (TRACE_READ | TRACE_NACK)) == (TRACE_READ | TRACE_NACK)) {
+        t->data = NULL;
+        return n;
+    }
+
+    if (size - n < t->length)
+        return 0;
+    t->data = &buf[n];
+
+    return n + t->length;
+}
+
+bool replay_run(const uint8_t *log, uint32_t size, const struct replay_ops *ops, bool timed,
+                struct replay_stats *stats)
+{
+    char data[255];
+    uint32_t start = timed ? ops->time_us() : 0;
+    uint32_t at_us = 0;
+
+    stats->transactions = 0;
+    stats->mismatches = 0;
+    stats->recorded_us = 0;
+    stats->max_late_us = 0;
+
+    if (!replay_check_header(log, size))
+        return false;
+
+    for (uint32_t offset = REPLAY_HEADER_SIZE; offset < size; ) {
+        struct replay_transaction t;
+        int n = replay_decode(&log[offset], size - offset, &t);
+        if (n == 0)
+            return false;
+        offset += n;
+        at_us += t.delta_us;
+
+        if (timed) {
+            /* The log holds the end of each transaction: starting each one
+             * at that time shifts the whole run by about one transaction but
+             * keeps the gaps between transactions */
+            uint32_t late = ops->time_us() - start - at_us;
+            if ((int32_t)late > 0) {
+                if (late > stats->max_late_us)
+                    stats->max_late_us = late;
+            } else {
+                while ((int32_t)(ops->time_us() - start - at_us) < 0)
+                    ;
+            }
+        }
+
+        bool expect_ack = !(t.flags & TRACE_NACK);
+        bool match;
+        int ret;
+        if (t.flags & TRACE_READ) {
+            ret = ops->read(t.address, data, t.length, at_us);
+            match = (ret == 0) == expect_ack
+                    && (ret != 0 || memcmp(data, t.data, t.length) == 0);
+        } else {
+            ret = ops->write(t.address, (const char *)t.data, t.length, at_us);
+            match = (ret == 0) == expect_ack;
+        }
+
+        if (!match) {
+            ++stats->mismatches;
+            if (ops->mismatch)
+                ops->mismatch(stats->transactions, &t, ret, (t.flags & TRACE_READ) ? data : NULL);
+        }
+        ++stats->transactions;
+    }
+
+    stats->recorded_us = at_us;
+    return true;
+}
@@ -0,0 +1,140 @@
+/**
+ * Transaction logs that can be replayed against a board or the slave model.
+ *
+ * A log is the exact traffic of a run: each transaction with its address,
+ * direction, payload, expected response and the time elapsed since the
+ * previous transaction. It is produced from the flight recorder of a fixture
+ * (see host/flash_dump) or by the host simulator, and replayed either as fast
+ * as possible or with the original timing.
+ *
+ * File layout, after an 8-byte header ("RATR", version, 3 reserved bytes):
+ *
+ *   | flags (1) | address (1) | length (1) | delta_us (varint) | payload |
+ *
+ * flags are the TRACE_READ and TRACE_NACK flags of trace.h: TRACE_NACK means
+ * that the transaction is expected not to be acknowledged. The payload holds
+ * the bytes written, or the bytes expected from a read; an expected NACK'ed
+ * read has no payload. delta_us is the time between the end of the previous
+ * transaction and the end of this one, as an unsigned LEB128 number (7 bits
+ * per byte, least significant first), so a record of a 2-byte write is
+ * usually 6 bytes.
+ */
+
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <stdint.h>
+#include "trace.h"
+
+#define REPLAY_VERSION              (1)
+#define REPLAY_HEADER_SIZE          (8)
+#define REPLAY_MAX_RECORD_SIZE      (3 + 5 + 255)
+
+struct replay_transaction {
+    uint32_t delta_us;
+    uint8_t address;                /* 8-bit I2C slave address */
+    uint8_t flags;                  /* TRACE_READ, TRACE_NACK */
+    uint8_t length;                 /* bytes transferred */
+    const uint8_t *data;            /* written or expected bytes, NULL if none */
+};
+
+/** State of a log being written */
+struct replay_writer {
+    uint32_t last_us;
+    bool started;
+};
+
+struct replay_ops {
+    /**
+     * Write to a slave (0 on ack). at_us is the time of the transaction in
+     * the log since its start, for models which depend on time.
+     */
+    int (*write)(uint8_t address, const char *data, int length, uint32_t at_us);
+
+    /** Read from a slave (0 on ack) */
+    int (*read)(uint8_t address, char *data, int length, uint32_t at_us);
+
+    /** Free running microsecond counter, only used by timed replays */
+    uint32_t (*time_us)(void);
+
+    /**
+     * Called for each transaction whose response differs from the log, may
+     * be NULL. data holds the bytes read (NULL for writes).
+     */
+    void (*mismatch)(uint32_t index, const struct replay_transaction *t, int ret,
+                     const char *data);
+};
+
+struct replay_stats {
+    uint32_t transactions;
+    uint32_t mismatches;
+    uint32_t recorded_us;           /* duration of the log */
+    uint32_t max_late_us;           /* timed replay: worst delay on the log */
+};
+
+/**
+ * @brief Write the header of a log and reset the writer.
+ *
+ * @param[out] buf buffer of at least REPLAY_HEADER_SIZE bytes
+ * @param[out] w writer
+ * @return Size of the header in bytes
+ */
+int replay_encode_header(uint8_t *buf, struct replay_writer *w);
+
+/**
+ * @brief Encode one transaction.
+ *
+ * The first transaction of a log has a delta of 0.
+ *
+ * @param[out] buf buffer of at least REPLAY_MAX_RECORD_SIZE bytes
+ * @param[in,out] w writer
+ * @param[in] timestamp_us time of the end of the transaction
+ * @param[in] address 8-bit I2C slave address
+ * @param[in] flags TRACE_READ, TRACE_NACK
+ * @param[in] data bytes written or read
+ * @param[in] length number of bytes transferred
+ * @return Size of the record in bytes
+ */
+int replay_encode(uint8_t *buf, struct replay_writer *w, uint32_t timestamp_us,
+                  uint8_t address, uint8_t flags, const uint8_t *data, int length);
+
+/**
+ * @brief Encode a transaction of the flight recorder.
+ *
+ * Only the first TRACE_DATA_MAX bytes of a transaction are recorded, longer
+ * transactions are shortened.
+ */
+int replay_encode_trace(uint8_t *buf, struct replay_writer *w, const struct trace_entry *e);
+
+/**
+ * @brief Check the header of a log.
+ *
+ * @return True if the header is valid and the version supported
+ */
+bool replay_check_header(const uint8_t *buf, uint32_t size);
+
+/**
+ * @brief Decode one transaction.
+ *
+ * @param[in] buf encoded record
+ * @param[in] size bytes available in buf
+ * @param[out] t transaction, t->data points into buf
+ * @return Size of the record, 0 if it is truncated or invalid
+ */
+int replay_decode(const uint8_t *buf, uint32_t size, struct replay_transaction *t);
+
+/**
+ * @brief Replay a log.
+ *
+ * @param[in] log whole log including its header
+ * @param[in] size size of the log
+ * @param[in] ops access to the board or the model
+ * @param[in] timed true to keep the original timing, false to run as fast as
+ * possible
+ * @param[out] stats statistics of the replay
+ * @return False if the log is invalid or truncated
+ */
+bool replay_run(const uint8_t *log, uint32_t size, const struct replay_ops *ops, bool timed,
+                struct replay_stats *stats);
+
+#endif
@@ -0,0 +1,79 @@
+#include "repro_bundle.h"
+#include <string.h>
+#include "record.h"
+
+static const uint8_t magic[4] = {'R', 'A', 'R', 'B'};
+
+int repro_encode_header(uint8_t *buf, const struct repro_info *info)
+{
+    memcpy(buf, magic, sizeof(magic));
+    buf[4] = REPRO_VERSION;
+    buf[5] = info->test;
+    buf[6] = info->setting_count;
+    buf[7] = info->history_blocks;
+    record_put_u32(&buf[8], info->seed);
+    record_put_u32(&buf[12], info->iteration);
+    record_put_u32(&buf[16], info->bus_frequency);
+    record_put_u32(&buf[20], info->transactions);
+
+    return REPRO_HEADER_SIZE;
+}
+
+int repro_encode_setting(uint8_t *buf, const struct repro_setting *s)
+{
+    int length = strlen(s->name);
+
+    if (length > REPRO_NAME_MAX)
+        length = REPRO_NAME_MAX;
+    buf[0] = length;
+    memcpy(&buf[1], s->name, length);
+    record_put_u32(&buf[1 + length], s->value);
+
+    return 1 + length + 4;
+}
+
+bool repro_decode(const uint8_t *buf, uint32_t size, struct repro_bundle *b)
+{
+    if (size < REPRO_HEADER_SIZE || memcmp(buf, magic, sizeof(magic)) != 0
+    ||  buf[4] != REPRO_VERSION)
+        return false;
+
+    b->info.test = buf[5];
+    b->info.setting_count = buf[6];
+    b->info.history_blocks = buf[7];
+    b->info.seed = record_get_u32(&buf[8]);
+    b->info.iteration = record_get_u32(&buf[12]);
+    b->info.bus_frequency = record_get_u32(&buf[16]);
+    b->info.transactions = record_get_u32(&buf[20]);
+    b->end = buf + size;
+
+    /* Skip the settings to find the history */
+    const uint8_t *p = buf + REPRO_HEADER_SIZE;
+    for (int i = 0; i < b->info.setting_count; ++i) {
+        if (p >= b->end || b->end - p < 1 + p[0] + 4 || p[0] > REPRO_NAME_MAX)
+            return false;
+        p += 1 + p[0] + 4;
+    }
+
+    b->next_setting = buf + REPRO_HEADER_SIZE;
+    b->settings_left = b->info.setting_count;
+    b->history = p;
+    b->history_size = b->end - p;
+
+    return true;
+}
+
+bool repro_next_setting(struct repro_bundle *b, char *name, uint32_t *value)
+{
+    if (b->settings_left == 0)
+        return false;
+
+    const uint8_t *p = b->next_setting;
+    memcpy(name, &p[1], p[0]);
+    name[p[0]] = '\0';
+    *value = record_get_u32(&p[1 + p[0]]);
+    b->next_setting = p + 1 + p[0] + 4;
+    --b->settings_left;
+
+    return true;
+}
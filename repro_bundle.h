@@ -0,0 +1,96 @@
+/**
+ * Reproduction bundle of a failure.
+ *
+ * When a test fails, the fixture prints everything needed to reproduce the
+ * failure: the seed of the tests, the failing test and iteration, the bus
+ * frequency, the configuration the firmware was built with and the packed
+ * history of the flight recorder (see trace_pack.h). host/repro replays it
+ * against the slave model or turns it into a replay log for a fresh board.
+ *
+ *   | "RARB" | version (1) | test (1) | settings (1) | history blocks (1) |
+ *   | seed (4) | iteration (4) | bus_frequency (4) | transactions (4) |
+ *   | settings | history blocks |
+ *
+ * Each setting is a name and a value, named after the macros of main.cpp:
+ *
+ *   | name length (1) | name | value (4) |
+ *
+ * All multi-byte fields are little-endian.
+ */
+
+#ifndef REPRO_BUNDLE_H
+#define REPRO_BUNDLE_H
+
+#include <stdint.h>
+
+#define REPRO_VERSION               (1)
+#define REPRO_HEADER_SIZE           (24)
+#define REPRO_NAME_MAX              (40)
+#define REPRO_MAX_SETTING_SIZE      (1 + REPRO_NAME_MAX + 4)
+
+struct repro_info {
+    uint32_t seed;                  /* argument of srand() */
+    uint8_t test;                   /* failing test, from 1 */
+    uint32_t iteration;             /* iteration of the failing test */
+    uint32_t bus_frequency;         /* Hz */
+    uint32_t transactions;          /* recorded since boot */
+    uint8_t setting_count;
+    uint8_t history_blocks;
+};
+
+struct repro_setting {
+    const char *name;
+    uint32_t value;
+};
+
+/** Bundle being decoded */
+struct repro_bundle {
+    struct repro_info info;
+    const uint8_t *next_setting;
+    int settings_left;
+    const uint8_t *history;         /* packed history blocks, oldest first */
+    uint32_t history_size;
+    const uint8_t *end;
+};
+
+/**
+ * @brief Encode the header of a bundle.
+ *
+ * @param[out] buf buffer of at least REPRO_HEADER_SIZE bytes
+ * @param[in] info failure
+ * @return Size of the header in bytes
+ */
+int repro_encode_header(uint8_t *buf, const struct repro_info *info);
+
+/**
+ * @brief Encode a setting, following the header.
+ *
+ * Names longer than REPRO_NAME_MAX are shortened.
+ *
+ * @param[out] buf buffer of at least REPRO_MAX_SETTING_SIZE bytes
+ * @param[in] s setting
+ * @return Size of the setting in bytes
+ */
+int repro_encode_setting(uint8_t *buf, const struct repro_setting *s);
+
+/**
+ * @brief Decode the header of a bundle and locate its settings and history.
+ *
+ * @param[in] buf whole bundle
+ * @param[in] size size of the bundle
+ * @param[out] b bundle, pointing into buf
+ * @return False if the bundle is truncated or of an unknown version
+ */
+bool repro_decode(const uint8_t *buf, uint32_t size, struct repro_bundle *b);
+
+/**
+ * @brief Get the next setting of a decoded bundle.
+ *
+ * @param[in,out] b bundle
+ * @param[out] name buffer of at least REPRO_NAME_MAX + 1 bytes
+ * @param[out] value value of the setting
+ * @return False when there are no more settings
+ */
+bool repro_next_setting(struct repro_bundle *b, char *name, uint32_t *value);
+
+#endif
@@ -0,0 +1,52 @@
+#include "scheduler.h"
+#include <stddef.h>
+
+static struct {
+    void (*run)(void);
+    uint32_t max_us;
+} tasks[SCHEDULER_MAX_TASKS];
+static int task_count;
+static int next_task;
+static bool running;
+static uint32_t runs;
+
+bool scheduler_add(void (*task)(void), uint32_t max_us)
+{
+    if (task_count == SCHEDULER_MAX_TASKS)
+        return false;
+
+    tasks[task_count].run = task;
+    tasks[task_count].max_us = max_us;
+    ++task_count;
+    return true;
+}
+
+void scheduler_clear(void)
+{
+    task_count = 0;
+    next_task = 0;
+}
+
+void scheduler_yield(uint32_t available_us)
+{
+    if (running)
+        return;
+
+    for (int i = 0; i < task_count; ++i) {
+        int n = (next_task + i) % task_count;
+        if (tasks[n].max_us > available_us)
+            continue;
+
+        running = true;
+        next_task = n + 1;
+        tasks[n].run();
+        ++runs;
+        running = false;
+        return;
+    }
+}
+
+uint32_t scheduler_runs(void)
+{
+    return runs;
+}
@@ -0,0 +1,55 @@
+/**
+ * Cooperative scheduler running background tasks while the bus is busy.
+ *
+ * Tasks are short functions run to completion, one at a time, in round-robin
+ * order. The I2C driver calls scheduler_yield() while it waits for the end of
+ * a bus operation, so the CPU time otherwise lost in polling loops is given to
+ * the tasks. Tasks must not use the I2C bus.
+ *
+ * Each task declares the longest time one of its turns takes, and only runs
+ * when the bus operation in progress is expected to last longer: when the
+ * operation ends before the task returns, the bus is stalled (SCL held low)
+ * until it does.
+ *
+ * Only tasks which do not use the bus can run this way, such as the log
+ * drainer. The tests are not split into concurrent streams since they share
+ * the single register pointer of the slave, and the register watch, which
+ * uses the bus, stays on its ticker between two iterations.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+#define SCHEDULER_MAX_TASKS     (4)
+
+/**
+ * @brief Add a background task.
+ *
+ * @param[in] task function called on each turn of the task
+ * @param[in] max_us longest duration of a turn
+ * @return False if there are already SCHEDULER_MAX_TASKS tasks
+ */
+bool scheduler_add(void (*task)(void), uint32_t max_us);
+
+/**
+ * @brief Remove all tasks.
+ */
+void scheduler_clear(void);
+
+/**
+ * @brief Run one turn of the next task which fits in the time available.
+ *
+ * Calls from a task are ignored, tasks never nest.
+ *
+ * @param[in] available_us time until the bus needs the CPU again
+ */
+void scheduler_yield(uint32_t available_us);
+
+/**
+ * @return Number of task turns run since boot
+ */
+uint32_t scheduler_runs(void);
+
+#endif
@@ -0,0 +1,78 @@
+#include "slave_model.h"
+#include <string.h>
+
+static void reset_registers(struct slave_model *m)
+{
+    memset(m->regs, 0, sizeof(m->regs));
+    m->current_reg = 0;
+}
+
+static bool acks_address(const struct slave_model *m, unsigned int now_us)
+{
+    return m->powered && now_us - m->powered_at_us >= m->boot_delay_us;
+}
+
+static bool services_registers(const struct slave_model *m, unsigned int now_us)
+{
+    return now_us - m->powered_at_us >= m->init_delay_us;
+}
+
+void slave_model_init(struct slave_model *m, unsigned int boot_delay_us,
+                      unsigned int init_delay_us)
+{
+    reset_registers(m);
+    m->powered = true;
+    m->powered_at_us = 0;
+    m->boot_delay_us = boot_delay_us;
+    m->init_delay_us = init_delay_us < boot_delay_us ? boot_delay_us : init_delay_us;
+}
+
+void slave_model_power(struct slave_model *m, bool on, unsigned int now_us)
+{
+    if (on && !m->powered) {
+        reset_registers(m);
+        m->powered_at_us = now_us;
+    }
+    m->powered = on;
+}
+
+int slave_model_write(struct slave_model *m, const char *data, int length,
+                      unsigned int now_us)
+{
+    if (!acks_address(m, now_us))
+        return 1;
+
+    /* The MSSP acknowledges bytes before the firmware handles them */
+    if (length == 0 || !services_registers(m, now_us))
+        return 0;
+
+    m->current_reg = (unsigned char)data[0];
+    for (int i = 1; i < length; ++i) {
+        if (m->current_reg == 0)
+            m->regs[0] = (m->regs[0] & 0xF0) | (data[i] & 0x0F);
+        else if (m->current_reg < SLAVE_MODEL_REGISTER_COUNT)
+            m->regs[m->current_reg] = data[i];
+
+        if (m->current_reg < SLAVE_MODEL_REGISTER_COUNT)
+            ++m->current_reg;
+    }
+
+    return 0;
+}
+
+int slave_model_read(struct slave_model *m, char *data, int length,
+                     unsigned int now_us)
+{
+    if (!acks_address(m, now_us))
+        return 1;
+
+    bool ready = services_registers(m, now_us);
+    for (int i = 0; i < length; ++i) {
+        if (ready && m->current_reg < SLAVE_MODEL_REGISTER_COUNT)
+            data[i] = m->regs[m->current_reg++];
+        else
+            data[i] = 0;
+    }
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/**
+ * Software model of the robotarmclick firmware running on the PIC12LF1552.
+ *
+ * The model implements the same register rules that the tests check on the
+ * real board:
+ *  - registers 0-4 are valid, only the lower half of register 0 is writable,
+ *  - a write sets the current register and auto-increments while writing,
+ *  - a read auto-increments as well and returns zeros past register 4,
+ *  - after a write to an invalid register (5-255), reads return zeros.
+ */
+
+#ifndef SLAVE_MODEL_H
+#define SLAVE_MODEL_H
+
+#define SLAVE_MODEL_REGISTER_COUNT      (5)
+
+struct slave_model {
+    char regs[SLAVE_MODEL_REGISTER_COUNT];
+    unsigned int current_reg;
+
+    /* Power-up behaviour */
+    bool powered;
+    unsigned int powered_at_us;
+    unsigned int boot_delay_us;     /* address NACK'ed until this delay */
+    unsigned int init_delay_us;     /* registers not serviced until this delay */
+};
+
+/**
+ * @brief Initialise a model in the powered and ready state.
+ *
+ * @param[out] m model to initialise
+ * @param[in] boot_delay_us time after power-up before the address is ACK'ed
+ * @param[in] init_delay_us time after power-up before registers are serviced
+ */
+void slave_model_init(struct slave_model *m, unsigned int boot_delay_us,
+                      unsigned int init_delay_us);
+
+/**
+ * @brief Switch the power of the simulated board.
+ *
+ * Powering the board resets all registers.
+ *
+ * @param[in] m model
+ * @param[in] on true to power the board, false to cut power
+ * @param[in] now_us current time in microseconds
+ */
+void slave_model_power(struct slave_model *m, bool on, unsigned int now_us);
+
+/**
+ * @brief Perform a write transaction on the model.
+ *
+ * A transaction with length 0 is an address-only probe.
+ *
+ * @param[in] m model
+ * @param[in] data bytes sent by the master, data[0] is the register address
+ * @param[in] length number of bytes sent
+ * @param[in] now_us current time in microseconds
+ * @return 0 on success (ack), non-0 on failure (nack)
+ */
+int slave_model_write(struct slave_model *m, const char *data, int length,
+                      unsigned int now_us);
+
+/**
+ * @brief Perform a read transaction on the model.
+ *
+ * @param[in] m model
+ * @param[out] data buffer receiving the bytes
+ * @param[in] length number of bytes to read
+ * @param[in] now_us current time in microseconds
+ * @return 0 on success (ack), non-0 on failure (nack)
+ */
+int slave_model_read(struct slave_model *m, char *data, int length,
+                     unsigned int now_us);
+
+#endif
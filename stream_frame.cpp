@@ -0,0 +1,76 @@
+#include "stream_frame.h"
+#include "record.h"
+#include <string.h>
+
+/* Offsets in the frame */
+#define OFFSET_DESTINATION      (0)
+#define OFFSET_SOURCE           (6)
+#define OFFSET_ETHERTYPE        (12)
+#define OFFSET_MAGIC            (14)
+#define OFFSET_VERSION          (16)
+#define OFFSET_FIXTURE          (17)
+#define OFFSET_SEQUENCE         (18)
+#define OFFSET_RECORDS_LENGTH   (22)
+
+void stream_frame_init(struct stream_frame *f, const uint8_t *source, uint8_t fixture)
+{
+    memset(&f->buf[OFFSET_DESTINATION], 0xFF, STREAM_FRAME_MAC_SIZE);
+    memcpy(&f->buf[OFFSET_SOURCE], source, STREAM_FRAME_MAC_SIZE);
+
+    /* EtherType is big-endian */
+    f->buf[OFFSET_ETHERTYPE] = STREAM_FRAME_ETHERTYPE >> 8;
+    f->buf[OFFSET_ETHERTYPE + 1] = STREAM_FRAME_ETHERTYPE & 0xFF;
+
+    f->buf[OFFSET_MAGIC] = 'R';
+    f->buf[OFFSET_MAGIC + 1] = 'A';
+    f->buf[OFFSET_VERSION] = STREAM_FRAME_VERSION;
+    f->buf[OFFSET_FIXTURE] = fixture;
+
+    f->sequence = 0;
+    record_put_u32(&f->buf[OFFSET_SEQUENCE], f->sequence);
+    record_put_u16(&f->buf[OFFSET_RECORDS_LENGTH], 0);
+    f->length = STREAM_FRAME_HEADER_SIZE;
+}
+
+bool stream_frame_append(struct stream_frame *f, const uint8_t *record, int length)
+{
+    if (f->length + length > STREAM_FRAME_MAX_SIZE)
+        return false;
+
+    memcpy(&f->buf[f->length], record, length);
+    f->length += length;
+    record_put_u16(&f->buf[OFFSET_RECORDS_LENGTH], f->length - STREAM_FRAME_HEADER_SIZE);
+
+    return true;
+}
+
+bool stream_frame_empty(const struct stream_frame *f)
+{
+    return f->length == STREAM_FRAME_HEADER_SIZE;
+}
+
+void stream_frame_next(struct stream_frame *f)
+{
+    ++f->sequence;
+    record_put_u32(&f->buf[OFFSET_SEQUENCE], f->sequence);
+    record_put_u16(&f->buf[OFFSET_RECORDS_LENGTH], 0);
+    f->length = STREAM_FRAME_HEADER_SIZE;
+}
+
+bool stream_frame_parse(const uint8_t *buf, int size, struct stream_frame_info *info)
+{
+    if (size < STREAM_FRAME_HEADER_SIZE
+    ||  buf[OFFSET_ETHERTYPE] != STREAM_FRAME_ETHERTYPE >> 8
+    ||  buf[OFFSET_ETHERTYPE + 1] != (STREAM_FRAME_ETHERTYPE & 0xFF)
+    ||  buf[OFFSET_MAGIC] != 'R' || buf[OFFSET_MAGIC + 1] != 'A'
+    ||  buf[OFFSET_VERSION] != STREAM_FRAME_VERSION)
+        return false;
+
+    memcpy(info->source, &buf[OFFSET_SOURCE], STREAM_FRAME_MAC_SIZE);
+    info->fixture = buf[OFFSET_FIXTURE];
+    info->sequence = record_get_u32(&buf[OFFSET_SEQUENCE]);
+    info->records = &buf[STREAM_FRAME_HEADER_SIZE];
+    info->records_length = record_get_u16(&buf[OFFSET_RECORDS_LENGTH]);
+
+    return info->records_length <= size - STREAM_FRAME_HEADER_SIZE;
+}
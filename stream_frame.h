@@ -0,0 +1,82 @@
+/**
+ * Ethernet frames carrying records.
+ *
+ * Records are packed in raw Ethernet frames with the local experimental
+ * EtherType 0x88B5. Each frame has a sequence number per fixture so that the
+ * receiver can detect lost frames:
+ *
+ *   | destination (6) | source (6) | EtherType (2) |
+ *   | magic 'R' 'A' (2) | version (1) | fixture (1) | sequence (4) |
+ *   | records length (2) | records |
+ *
+ * Frames are sent to the broadcast address. The records length is needed
+ * because short frames are padded.
+ */
+
+#ifndef STREAM_FRAME_H
+#define STREAM_FRAME_H
+
+#include <stdint.h>
+
+#define STREAM_FRAME_ETHERTYPE      (0x88B5)
+#define STREAM_FRAME_VERSION        (1)
+#define STREAM_FRAME_MAC_SIZE       (6)
+#define STREAM_FRAME_HEADER_SIZE    (14 + 10)
+#define STREAM_FRAME_MAX_SIZE       (1514)
+
+struct stream_frame {
+    uint8_t buf[STREAM_FRAME_MAX_SIZE];
+    int length;
+    uint32_t sequence;
+};
+
+struct stream_frame_info {
+    uint8_t source[STREAM_FRAME_MAC_SIZE];
+    uint8_t fixture;
+    uint32_t sequence;
+    const uint8_t *records;
+    int records_length;
+};
+
+/**
+ * @brief Prepare the first frame of a stream.
+ *
+ * @param[out] f frame
+ * @param[in] source MAC address of the fixture
+ * @param[in] fixture fixture identifier
+ */
+void stream_frame_init(struct stream_frame *f, const uint8_t *source, uint8_t fixture);
+
+/**
+ * @brief Append a record to the frame.
+ *
+ * @param[in] f frame
+ * @param[in] record encoded record
+ * @param[in] length size of the record
+ * @return True if the record was appended, false if the frame is full
+ */
+bool stream_frame_append(struct stream_frame *f, const uint8_t *record, int length);
+
+/**
+ * @return True if the frame holds no record
+ */
+bool stream_frame_empty(const struct stream_frame *f);
+
+/**
+ * @brief Start the next frame once the current one has been sent.
+ *
+ * @param[in] f frame
+ */
+void stream_frame_next(struct stream_frame *f);
+
+/**
+ * @brief Parse a received frame.
+ *
+ * @param[in] buf frame starting at the destination address
+ * @param[in] size size of the frame
+ * @param[out] info content of the frame
+ * @return True if the frame is a valid stream frame, false otherwise
+ */
+bool stream_frame_parse(const uint8_t *buf, int size, struct stream_frame_info *info);
+
+#endif
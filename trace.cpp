@@ -0,0 +1,64 @@
+#include "trace.h"
+#include "trace_pack.h"
+#include "ahb_sram.h"
+#include <stddef.h>
+#include <string.h>
+
+static struct trace_entry entries[TRACE_DEPTH] AHB_SRAM0;
+static uint32_t count;
+
+static uint8_t history[TRACE_HISTORY_BLOCKS][TRACE_HISTORY_BLOCK_SIZE] AHB_SRAM0;
+static struct trace_pack_encoder history_encoder;
+static uint32_t history_started;        /* blocks started since boot */
+
+void trace_record(uint32_t timestamp_us, uint8_t address, uint8_t flags,
+                  const char *data, int length)
+{
+    struct trace_entry *e = &entries[count & (TRACE_DEPTH - 1)];
+
+    e->timestamp_us = timestamp_us;
+    e->address = address;
+    e->flags = flags;
+    e->length = length;
+    if (length > 0)
+        memcpy(e->data, data, length < TRACE_DATA_MAX ? length : TRACE_DATA_MAX);
+
+    if (history_started == 0
+    ||  !trace_pack_append(&history_encoder, timestamp_us, address, flags, (const uint8_t *)data,
+                           length)) {
+        trace_pack_start(&history_encoder, history[history_started % TRACE_HISTORY_BLOCKS],
+                         TRACE_HISTORY_BLOCK_SIZE, count);
+        ++history_started;
+        trace_pack_append(&history_encoder, timestamp_us, address, flags, (const uint8_t *)data,
+                          length);
+    }
+
+    ++count;
+}
+
+uint32_t trace_count(void)
+{
+    return count;
+}
+
+const struct trace_entry *trace_get(uint32_t index)
+{
+    if (count - index - 1 >= TRACE_DEPTH)
+        return NULL;
+
+    return &entries[index & (TRACE_DEPTH - 1)];
+}
+
+int trace_history_blocks(void)
+{
+    return history_started < TRACE_HISTORY_BLOCKS ? history_started : TRACE_HISTORY_BLOCKS;
+}
+
+const uint8_t *trace_history_block(int n, int *size)
+{
+    uint32_t block = history_started - trace_history_blocks() + n;
+    const uint8_t *b = history[block % TRACE_HISTORY_BLOCKS];
+
+    *size = trace_pack_block_size(b, TRACE_HISTORY_BLOCK_SIZE);
+    return b;
+}
@@ -0,0 +1,84 @@
+/**
+ * Flight recorder of the I2C transactions.
+ *
+ * Every transaction is stored in a ring buffer holding the last TRACE_DEPTH
+ * transactions. Entries are numbered from 0 in the order they are recorded,
+ * so that consumers can keep their own position and detect when entries were
+ * overwritten before they read them.
+ *
+ * The ring only needs to hold the transactions not streamed or logged yet.
+ * A longer history is kept packed (see trace_pack.h) in TRACE_HISTORY_BLOCKS
+ * blocks: when the last block is full, the oldest one is reused. With the
+ * transactions of the tests, it holds about 1000 transactions in the memory
+ * of 200 entries of the ring.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+/** Number of transactions kept, must be a power of 2 */
+#define TRACE_DEPTH             (64)
+
+/** Packed history */
+#define TRACE_HISTORY_BLOCKS        (16)
+#define TRACE_HISTORY_BLOCK_SIZE    (256)
+
+/** Largest transaction of the tests (address and 10 bytes) */
+#define TRACE_DATA_MAX          (11)
+
+/* Transaction flags */
+#define TRACE_READ              (0x01)  /* read transaction, write otherwise */
+#define TRACE_NACK              (0x02)  /* transaction not acknowledged */
+
+struct trace_entry {
+    uint32_t timestamp_us;
+    uint8_t address;
+    uint8_t flags;
+    uint8_t length;                     /* bytes transferred */
+    uint8_t data[TRACE_DATA_MAX];       /* first TRACE_DATA_MAX bytes */
+};
+
+/**
+ * @brief Record one transaction.
+ *
+ * @param[in] timestamp_us time of the end of the transaction
+ * @param[in] address 8-bit I2C slave address
+ * @param[in] flags TRACE_READ, TRACE_NACK
+ * @param[in] data bytes written or read
+ * @param[in] length number of bytes written or read
+ */
+void trace_record(uint32_t timestamp_us, uint8_t address, uint8_t flags,
+                  const char *data, int length);
+
+/**
+ * @return Number of transactions recorded since boot
+ */
+uint32_t trace_count(void);
+
+/**
+ * @brief Get a recorded transaction.
+ *
+ * @param[in] index number of the transaction
+ * @return Transaction, or NULL if it was overwritten or not recorded yet
+ */
+const struct trace_entry *trace_get(uint32_t index);
+
+/**
+ * @return Number of blocks of the packed history
+ */
+int trace_history_blocks(void);
+
+/**
+ * @brief Get a block of the packed history.
+ *
+ * The last block is the one being filled.
+ *
+ * @param[in] n number of the block, from 0 (oldest)
+ * @param[out] size size of the block
+ * @return Block, see trace_pack_decoder_init()
+ */
+const uint8_t *trace_history_block(int n, int *size);
+
+#endif
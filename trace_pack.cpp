@@ -0,0 +1,225 @@
+#include "trace_pack.h"
+#include "record.h"
+#include <string.h>
+
+#define SHAPE_ADDRESS           (0)
+#define SHAPE_FLAGS             (1)
+#define SHAPE_LENGTH            (2)
+
+/**
+ * @brief Number of data bytes stored for a transaction.
+ */
+static int stored_length(uint8_t flags, int length)
+{
+    if ((flags & (TRACE_READ | TRACE_NACK)) == (TRACE_READ | TRACE_NACK))
+        return 0;
+
+    return length < TRACE_DATA_MAX ? length : TRACE_DATA_MAX;
+}
+
+static int varint_size(uint32_t value)
+{
+    int n = 1;
+
+    while (value > 0x7F) {
+        value >>= 7;
+        ++n;
+    }
+
+    return n;
+}
+
+static int put_varint(uint8_t *p, uint32_t value)
+{
+    int n = 0;
+
+    do {
+        p[n++] = (value & 0x7F) | (value > 0x7F ? 0x80 : 0);
+        value >>= 7;
+    } while (value);
+
+    return n;
+}
+
+static bool get_varint(struct trace_pack_decoder *d, uint32_t *value)
+{
+    *value = 0;
+    for (int shift = 0; ; shift += 7) {
+        if (d->p == d->end || shift > 28)
+            return false;
+        uint8_t b = *d->p++;
+        *value |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80))
+            return true;
+    }
+}
+
+void trace_pack_start(struct trace_pack_encoder *e, uint8_t *block, int size, uint32_t index)
+{
+    e->block = block;
+    e->size = size;
+    e->length = TRACE_PACK_BLOCK_HEADER_SIZE;
+    e->count = 0;
+    e->last_us = 0;
+    e->shape_count = 0;
+    e->next_slot = 0;
+    e->last_shape = -1;
+    e->run = 0;
+
+    record_put_u32(&block[0], index);
+    record_put_u32(&block[4], 0);
+    record_put_u16(&block[8], 0);
+}
+
+bool trace_pack_append(struct trace_pack_encoder *e, uint32_t timestamp_us, uint8_t address,
+                       uint8_t flags, const uint8_t *data, int length)
+{
+    int n = stored_length(flags, length);
+    int shape = -1;
+
+    for (int i = 0; i < e->shape_count; ++i) {
+        const uint8_t *s = e->shapes[i];
+        if (s[SHAPE_ADDRESS] == address && s[SHAPE_FLAGS] == flags && s[SHAPE_LENGTH] == length) {
+            shape = i;
+            break;
+        }
+    }
+
+    uint32_t delta = e->count ? timestamp_us - e->last_us : 0;
+    bool repeat = shape >= 0 && shape == e->last_shape && memcmp(data, e->last_data, n) == 0;
+    bool extend = repeat && e->run
+                  && (e->block[e->run] & ~TRACE_PACK_TAG_RUN) + 1 < TRACE_PACK_MAX_RUN;
+    int size = (extend ? 0 : 1) + (shape < 0 ? 3 : 0) + varint_size(delta) + (repeat ? 0 : n);
+
+    if (e->length + size > e->size)
+        return false;
+
+    uint8_t *p = &e->block[e->length];
+    if (extend) {
+        ++e->block[e->run];
+    } else if (repeat) {
+        e->run = e->length;
+        *p++ = TRACE_PACK_TAG_RUN;
+    } else if (shape >= 0) {
+        e->run = 0;
+        *p++ = shape;
+    } else {
+        e->run = 0;
+        shape = e->next_slot;
+        e->next_slot = (e->next_slot + 1) % TRACE_PACK_SHAPES;
+        if (e->shape_count < TRACE_PACK_SHAPES)
+            ++e->shape_count;
+        e->shapes[shape][SHAPE_ADDRESS] = address;
+        e->shapes[shape][SHAPE_FLAGS] = flags;
+        e->shapes[shape][SHAPE_LENGTH] = length;
+        *p++ = TRACE_PACK_TAG_NEW_SHAPE;
+        *p++ = address;
+        *p++ = flags;
+        *p++ = length;
+    }
+
+    p += put_varint(p, delta);
+    if (!repeat) {
+        memcpy(p, data, n);
+        memcpy(e->last_data, data, n);
+        p += n;
+    }
+
+    if (e->count == 0)
+        record_put_u32(&e->block[4], timestamp_us);
+    e->last_us = timestamp_us;
+    e->last_shape = shape;
+    e->length = p - e->block;
+    ++e->count;
+    record_put_u16(&e->block[8], e->length - TRACE_PACK_BLOCK_HEADER_SIZE);
+
+    return true;
+}
+
+int trace_pack_block_size(const uint8_t *block, int size)
+{
+    if (size < TRACE_PACK_BLOCK_HEADER_SIZE)
+        return 0;
+
+    int length = TRACE_PACK_BLOCK_HEADER_SIZE + record_get_u16(&block[8]);
+
+    return length <= size ? length : 0;
+}
+
+bool trace_pack_decoder_init(struct trace_pack_decoder *d, const uint8_t *block, int size)
+{
+    int length = trace_pack_block_size(block, size);
+
+    d->p = &block[TRACE_PACK_BLOCK_HEADER_SIZE];
+    d->end = &block[length];
+    d->index = length ? record_get_u32(&block[0]) : 0;
+    d->last_us = length ? record_get_u32(&block[4]) : 0;
+    d->shape_count = 0;
+    d->next_slot = 0;
+    d->last_shape = -1;
+    d->run_left = 0;
+    d->error = length == 0;
+
+    return !d->error;
+}
+
+bool trace_pack_next(struct trace_pack_decoder *d, uint32_t *index, struct trace_entry *entry)
+{
+    bool repeat = d->run_left > 0;
+    int shape = d->last_shape;
+
+    if (d->error || (!repeat && d->p == d->end))
+        return false;
+
+    if (repeat) {
+        --d->run_left;
+    } else {
+        uint8_t tag = *d->p++;
+        if (tag & TRACE_PACK_TAG_RUN) {
+            repeat = true;
+            d->run_left = tag & ~TRACE_PACK_TAG_RUN;
+            d->error = shape < 0;
+        } else if (tag == TRACE_PACK_TAG_NEW_SHAPE) {
+            d->error = d->end - d->p < 3;
+            if (!d->error) {
+                shape = d->next_slot;
+                d->next_slot = (d->next_slot + 1) % TRACE_PACK_SHAPES;
+                if (d->shape_count < TRACE_PACK_SHAPES)
+                    ++d->shape_count;
+                memcpy(d->shapes[shape], d->p, 3);
+                d->p += 3;
+            }
+        } else {
+            shape = tag;
+            d->error = tag >= d->shape_count;
+        }
+    }
+
+    uint32_t delta;
+    if (d->error || !get_varint(d, &delta)) {
+        d->error = true;
+        return false;
+    }
+
+    const uint8_t *s = d->shapes[shape];
+    int n = stored_length(s[SHAPE_FLAGS], s[SHAPE_LENGTH]);
+    if (!repeat) {
+        if (d->end - d->p < n) {
+            d->error = true;
+            return false;
+        }
+        memcpy(d->last_data, d->p, n);
+        d->p += n;
+    }
+
+    d->last_us += delta;
+    d->last_shape = shape;
+    *index = d->index++;
+    entry->timestamp_us = d->last_us;
+    entry->address = s[SHAPE_ADDRESS];
+    entry->flags = s[SHAPE_FLAGS];
+    entry->length = s[SHAPE_LENGTH];
+    memcpy(entry->data, d->last_data, n);
+
+    return true;
+}
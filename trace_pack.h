@@ -0,0 +1,126 @@
+/**
+ * Compact encoding of the transactions of the flight recorder.
+ *
+ * The transactions of a fixture are very redundant: the timestamps only grow
+ * by a few tens of microseconds, the slave address never changes and the
+ * tests use a handful of transaction shapes (address, direction, length).
+ * Transactions are packed into blocks which can be decoded on their own:
+ *
+ *   | first index (4) | first timestamp_us (4) | records length (2) | records |
+ *
+ * Each record starts with a tag:
+ *  - 0x00-0x1F: transaction whose shape is entry `tag` of the dictionary,
+ *    followed by delta_us and the data,
+ *  - 0x40: transaction of a new shape, followed by address, flags and length,
+ *    then delta_us and the data. The shape is added to the dictionary in the
+ *    next slot, round-robin,
+ *  - 0x80-0xFF: run of (tag & 0x7F) + 1 repeats of the previous transaction
+ *    (same shape and data), each followed by its delta_us only.
+ *
+ * delta_us is the time since the previous transaction of the block as an
+ * unsigned LEB128 number (0 for the first one). The data is the first
+ * TRACE_DATA_MAX bytes of the transaction, none for a NACK'ed read. The
+ * dictionary is empty at the start of each block.
+ *
+ * A 2-byte register write takes 4 bytes and a 1-byte read 3 bytes, against
+ * 20 bytes for a struct trace_entry.
+ */
+
+#ifndef TRACE_PACK_H
+#define TRACE_PACK_H
+
+#include <stdint.h>
+#include "trace.h"
+
+#define TRACE_PACK_SHAPES               (32)
+#define TRACE_PACK_BLOCK_HEADER_SIZE    (10)
+#define TRACE_PACK_MAX_RECORD_SIZE      (1 + 3 + 5 + TRACE_DATA_MAX)
+
+#define TRACE_PACK_TAG_NEW_SHAPE        (0x40)
+#define TRACE_PACK_TAG_RUN              (0x80)
+#define TRACE_PACK_MAX_RUN              (128)
+
+/** State of a block being filled */
+struct trace_pack_encoder {
+    uint8_t *block;
+    int size;                           /* size of the block buffer */
+    int length;                         /* bytes used, header included */
+    uint32_t count;                     /* transactions in the block */
+    uint32_t last_us;
+    uint8_t shapes[TRACE_PACK_SHAPES][3];
+    int shape_count;
+    int next_slot;
+    int last_shape;                     /* -1 at the start of the block */
+    uint8_t last_data[TRACE_DATA_MAX];
+    int run;                            /* offset of the tag of the current run, 0 if none */
+};
+
+/** State of a block being decoded */
+struct trace_pack_decoder {
+    const uint8_t *p;
+    const uint8_t *end;
+    uint32_t index;                     /* index of the next transaction */
+    uint32_t last_us;
+    uint8_t shapes[TRACE_PACK_SHAPES][3];
+    int shape_count;
+    int next_slot;
+    int last_shape;
+    uint8_t last_data[TRACE_DATA_MAX];
+    int run_left;                       /* repeats left in the current run */
+    bool error;                         /* the block is invalid or truncated */
+};
+
+/**
+ * @brief Start a block.
+ *
+ * @param[out] e encoder
+ * @param[out] block buffer of the block
+ * @param[in] size size of the buffer, at least TRACE_PACK_BLOCK_HEADER_SIZE
+ * @param[in] index index of the first transaction of the block
+ */
+void trace_pack_start(struct trace_pack_encoder *e, uint8_t *block, int size, uint32_t index);
+
+/**
+ * @brief Append a transaction to the block.
+ *
+ * @param[in,out] e encoder
+ * @param[in] timestamp_us time of the end of the transaction
+ * @param[in] address 8-bit I2C slave address
+ * @param[in] flags TRACE_READ, TRACE_NACK
+ * @param[in] data bytes written or read
+ * @param[in] length number of bytes transferred
+ * @return False if the block is full, the transaction must go to a new block
+ */
+bool trace_pack_append(struct trace_pack_encoder *e, uint32_t timestamp_us, uint8_t address,
+                       uint8_t flags, const uint8_t *data, int length);
+
+/**
+ * @brief Size of an encoded block.
+ *
+ * @param[in] block encoded block
+ * @param[in] size bytes available
+ * @return Size of the block, 0 if it is truncated or invalid
+ */
+int trace_pack_block_size(const uint8_t *block, int size);
+
+/**
+ * @brief Start decoding a block.
+ *
+ * @param[out] d decoder
+ * @param[in] block encoded block, see trace_pack_block_size()
+ * @param[in] size size of the block
+ * @return False if the block is truncated or invalid
+ */
+bool trace_pack_decoder_init(struct trace_pack_decoder *d, const uint8_t *block, int size);
+
+/**
+ * @brief Decode the next transaction of a block.
+ *
+ * @param[in,out] d decoder
+ * @param[out] index number of the transaction in the flight recorder
+ * @param[out] entry transaction
+ * @return False at the end of the block or if it is invalid (d->error set)
+ */
+bool trace_pack_next(struct trace_pack_decoder *d, uint32_t *index, struct trace_entry *entry);
+
+#endif
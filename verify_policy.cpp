@@ -0,0 +1,94 @@
+#include "verify_policy.h"
+#include <stdio.h>
+
+static uint32_t next_random(struct verify_policy *p)
+{
+    p->seed ^= p->seed << 13;
+    p->seed ^= p->seed >> 17;
+    p->seed ^= p->seed << 5;
+    return p->seed;
+}
+
+/**
+ * @brief Close the current gap: a corruption after its k-th write is caught
+ * gap - k + 1 writes later.
+ */
+static void sweep(struct verify_policy *p)
+{
+    p->latency_sum += (uint64_t)p->gap * (p->gap + 1) / 2;
+    if (p->gap > p->max_gap)
+        p->max_gap = p->gap;
+    p->last_gap = p->gap;
+    p->gap = 0;
+    ++p->sweeps;
+}
+
+void verify_policy_init(struct verify_policy *p, int mode, unsigned int period, uint32_t seed)
+{
+    p->mode = mode;
+    p->period = period > 0 ? period : 1;
+    p->seed = seed ? seed : 1;
+    p->gap = 0;
+    p->last_gap = 0;
+    p->writes = 0;
+    p->sweeps = 0;
+    p->spot_checks = 0;
+    p->max_gap = 0;
+    p->latency_sum = 0;
+}
+
+bool verify_policy_after_write(struct verify_policy *p)
+{
+    bool full;
+
+    ++p->writes;
+    ++p->gap;
+
+    switch (p->mode) {
+    case VERIFY_POLICY_PERIODIC:
+        full = p->gap >= p->period;
+        break;
+    case VERIFY_POLICY_RANDOM:
+        full = next_random(p) % p->period == 0;
+        break;
+    default:
+        full = true;
+        break;
+    }
+
+    if (full)
+        sweep(p);
+    else
+        ++p->spot_checks;
+
+    return full;
+}
+
+bool verify_policy_finish(struct verify_policy *p)
+{
+    if (p->gap == 0)
+        return false;
+
+    sweep(p);
+    return true;
+}
+
+unsigned int verify_policy_gap(const struct verify_policy *p)
+{
+    return p->last_gap;
+}
+
+void verify_policy_print(const struct verify_policy *p, int register_count)
+{
+    static const char *const names[] = {"every write", "periodic", "random"};
+    unsigned long reads = p->sweeps * register_count + p->spot_checks;
+
+    printf("  verify (%s, period %u): %lu writes, %lu full sweeps, %lu spot checks\n",
+           names[p->mode], p->period, p->writes, p->sweeps, p->spot_checks);
+    printf("  verify: %lu register reads instead of %lu\n",
+           reads, p->writes * register_count);
+    if (p->writes)
+        printf("  verify: other registers checked within %u writes (%lu.%02lu on average)\n",
+               p->max_gap, (unsigned long)(p->latency_sum / p->writes),
+               (unsigned long)(p->latency_sum * 100 / p->writes % 100));
+}
@@ -0,0 +1,84 @@
+/**
+ * Policy deciding when a test reads back the whole register file.
+ *
+ * Reading back registers 0-4 after every write costs 10 transactions for 1
+ * write. With a sampled policy, the test only checks the register it wrote
+ * (2 transactions) and reads back everything every N writes, or with a
+ * probability of 1/N after each write, and always once at the end. A write
+ * corrupting the register it targets is still caught at once; a write
+ * corrupting another register is caught at the next full sweep, so the
+ * failure is only localized to the writes since the previous sweep.
+ *
+ * The policy keeps the gaps between sweeps to report this trade-off: for a
+ * corruption equally likely after any write, the detection latency is the
+ * number of writes until the next sweep.
+ */
+
+#ifndef VERIFY_POLICY_H
+#define VERIFY_POLICY_H
+
+#include <stdint.h>
+
+/* Modes, usable in preprocessor conditions */
+#define VERIFY_POLICY_EVERY_WRITE   (0)     /* full sweep after each write */
+#define VERIFY_POLICY_PERIODIC      (1)     /* full sweep every period writes */
+#define VERIFY_POLICY_RANDOM        (2)     /* full sweep with a probability of 1/period */
+
+struct verify_policy {
+    int mode;
+    unsigned int period;
+    uint32_t seed;                  /* xorshift32 state of the random schedule */
+    unsigned int gap;               /* writes since the last full sweep */
+    unsigned int last_gap;          /* writes covered by the last full sweep */
+
+    /* Statistics */
+    unsigned long writes;
+    unsigned long sweeps;
+    unsigned long spot_checks;
+    unsigned int max_gap;
+    uint64_t latency_sum;           /* sum over the writes of the writes until the next sweep */
+};
+
+/**
+ * @brief Initialise a policy.
+ *
+ * @param[out] p policy
+ * @param[in] mode VERIFY_POLICY_EVERY_WRITE, VERIFY_POLICY_PERIODIC or
+ * VERIFY_POLICY_RANDOM
+ * @param[in] period writes between two full sweeps (on average if random)
+ * @param[in] seed seed of the random schedule, must not be 0
+ */
+void verify_policy_init(struct verify_policy *p, int mode, unsigned int period, uint32_t seed);
+
+/**
+ * @brief Decide how to verify a write which just happened.
+ *
+ * @param[in] p policy
+ * @return True if the whole register file must be read back, false if only
+ * the register written must be checked
+ */
+bool verify_policy_after_write(struct verify_policy *p);
+
+/**
+ * @brief End of the test.
+ *
+ * @param[in] p policy
+ * @return True if a final full sweep is needed (writes since the last one)
+ */
+bool verify_policy_finish(struct verify_policy *p);
+
+/**
+ * @brief Writes covered by the last full sweep, to localize a failure found
+ * by this sweep.
+ */
+unsigned int verify_policy_gap(const struct verify_policy *p);
+
+/**
+ * @brief Print the reads saved and the detection latency.
+ *
+ * @param[in] p policy
+ * @param[in] register_count registers read by a full sweep
+ */
+void verify_policy_print(const struct verify_policy *p, int register_count);
+
+#endif